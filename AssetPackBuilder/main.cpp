@@ -0,0 +1,103 @@
+
+#include "PrimitiveTypes.hpp"
+
+#include "AssetPack.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	bundles files into one asset pack for AudioEngine::mountPack.
+	usage: AssetPackBuilder [--extensions .flac,.mp3,...] output.pack file-or-folder...
+	folders are walked recursively. every entry is named by its path exactly as given here plus the walk, so build it from
+	the same folder paths the game or player's config uses and its loads will find them. --extensions keeps only those
+	(lowercase, with the dot), otherwise every file goes in
+*/
+
+namespace {
+	auto splitExtensions(std::string_view list) -> std::vector<std::string> {
+		std::vector<std::string> extensions;
+		while (!list.empty()) {
+			const size_t comma = list.find(',');
+			const auto extension = list.substr(0, comma);
+			if (!extension.empty())
+				extensions.emplace_back(extension);
+			list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+		}
+		return extensions;
+	}
+
+	auto wanted(const std::filesystem::path& path, const std::vector<std::string>& extensions) -> bool {
+		if (extensions.empty())
+			return true;
+		auto extension = path.extension().string();
+		std::ranges::transform(extension, extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return std::ranges::find(extensions, extension) != extensions.end();
+	}
+};
+
+auto main(int argc, char** argv) -> int {
+	std::vector<std::string> extensions;
+	i32 arg = 1;
+	if (arg + 1 < argc && std::string_view(argv[arg]) == "--extensions") {
+		extensions = splitExtensions(argv[arg + 1]);
+		arg += 2;
+	}
+	if (argc - arg < 2) {
+		std::cerr << "usage: AssetPackBuilder [--extensions .flac,.mp3,...] output.pack file-or-folder...\n";
+		return 1;
+	}
+	const std::string packPath = argv[arg++];
+
+	std::vector<std::string> files;
+	u32 skipped = 0;
+	for (; arg < argc; arg++) {
+		const std::filesystem::path input = argv[arg];
+		std::error_code error;
+		if (!std::filesystem::exists(input, error)) {
+			std::cerr << std::format("{} doesn't exist\n", input.string());
+			return 1;
+		}
+		if (std::filesystem::is_directory(input, error)) {
+			for (std::filesystem::recursive_directory_iterator iter(input, error), end; !error && iter != end; iter.increment(error)) {
+				if (!iter->is_regular_file(error))
+					continue;
+				if (wanted(iter->path(), extensions))
+					files.push_back(iter->path().string());
+				else
+					skipped++;
+			}
+		}
+		else if (std::filesystem::is_regular_file(input, error))
+			files.push_back(input.string()); // named explicitly, so no extension check
+		if (error) {
+			std::cerr << std::format("Couldn't read {}: {}\n", input.string(), error.message());
+			return 1;
+		}
+	}
+	std::sort(files.begin(), files.end()); // same inputs, same pack
+
+	const auto start = std::chrono::steady_clock::now();
+	if (!Audio::AssetPack::write(packPath, files)) {
+		std::cerr << std::format("Couldn't write {}, a file may have changed or become unreadable while packing\n", packPath);
+		return 1;
+	}
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+	Audio::AssetPack pack;
+	if (!pack.open(packPath)) {
+		std::cerr << std::format("Wrote {} but couldn't open it again\n", packPath);
+		return 1;
+	}
+	std::cout << std::format(
+		"{}: {} entries, {:.1f}MB in {}ms. skipped {} by extension, {} duplicates\n",
+		packPath, pack.entryCount(), pack.sizeBytes() / (1024.0 * 1024.0), elapsed.count(), skipped, files.size() - pack.entryCount()
+	);
+	return 0;
+}
@@ -0,0 +1,200 @@
+
+#include "pch.h"
+
+#include "AssetPack.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <unordered_set>
+#include <utility>
+
+namespace {
+	auto sameName(std::string_view a, std::string_view b) -> bool {
+		if (a.size() != b.size())
+			return false;
+		for (size_t i = 0; i < a.size(); i++) {
+			char x = a[i] == '\\' ? '/' : a[i];
+			char y = b[i] == '\\' ? '/' : b[i];
+			if (x != y)
+				return false;
+		}
+		return true;
+	}
+
+	auto alignUp(u64 value, u64 alignment) -> u64 {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+};
+
+namespace Audio {
+	AssetPack::AssetPack() :
+		header{nullptr},
+		slots{nullptr},
+		names{nullptr}
+	{}
+
+	AssetPack::AssetPack(AssetPack&& other) noexcept :
+		file{std::move(other.file)},
+		header{other.header},
+		slots{other.slots},
+		names{other.names}
+	{
+		other.header = nullptr;
+		other.slots = nullptr;
+		other.names = nullptr;
+	}
+
+	auto AssetPack::operator=(AssetPack&& other) noexcept -> AssetPack& {
+		if (this != &other) {
+			this->file = std::move(other.file);
+			this->header = std::exchange(other.header, nullptr);
+			this->slots = std::exchange(other.slots, nullptr);
+			this->names = std::exchange(other.names, nullptr);
+		}
+		return *this;
+	}
+
+	auto AssetPack::open(const std::string& path) -> bool {
+		this->close();
+		if (!this->file.open(path))
+			return false;
+		const u8* base = this->file.data();
+		const u64 size = this->file.size();
+		if (size < sizeof(Header)) {
+			this->close();
+			return false;
+		}
+		const Header* header = reinterpret_cast<const Header*>(base);
+		const bool valid = header->magic == magic && header->version == version
+			&& std::has_single_bit(header->slotCount) && header->slotCount >= header->entryCount
+			&& header->slotsOffset % alignof(Slot) == 0 && header->slotsOffset <= size
+			&& (size - header->slotsOffset) / sizeof(Slot) >= header->slotCount
+			&& header->namesOffset <= size;
+		if (!valid) {
+			this->close();
+			return false;
+		}
+		// names and data get bounds checked per entry in find, so a damaged entry only loses itself
+		this->header = header;
+		this->slots = reinterpret_cast<const Slot*>(base + header->slotsOffset);
+		this->names = reinterpret_cast<const char*>(base + header->namesOffset);
+		return true;
+	}
+
+	auto AssetPack::close() -> void {
+		this->file.close();
+		this->header = nullptr;
+		this->slots = nullptr;
+		this->names = nullptr;
+	}
+
+	auto AssetPack::isOpen() const -> bool {
+		return this->header != nullptr;
+	}
+
+	auto AssetPack::find(std::string_view name) const -> std::span<const u8> {
+		if (!this->header || name.empty())
+			return {};
+		const u64 size = this->file.size();
+		const u64 hash = hashName(name);
+		const u32 mask = this->header->slotCount - 1;
+		// linear probing, the table is at most half full so an empty slot always turns up
+		for (u32 i = static_cast<u32>(hash) & mask, probes = 0; probes <= mask; i = (i + 1) & mask, probes++) {
+			const Slot& slot = this->slots[i];
+			if (slot.nameLength == 0)
+				return {};
+			if (slot.hash != hash)
+				continue;
+			const u64 nameEnd = this->header->namesOffset + slot.nameOffset + slot.nameLength;
+			if (nameEnd > size || slot.offset > size || slot.size > size - slot.offset)
+				return {};
+			if (sameName(std::string_view(this->names + slot.nameOffset, slot.nameLength), name))
+				return std::span<const u8>(this->file.data() + slot.offset, static_cast<size_t>(slot.size));
+		}
+		return {};
+	}
+
+	auto AssetPack::entryCount() const -> u32 {
+		return this->header ? this->header->entryCount : 0;
+	}
+
+	auto AssetPack::sizeBytes() const -> u64 {
+		return this->file.size();
+	}
+
+	auto AssetPack::write(const std::string& packPath, const std::vector<std::string>& files) -> bool {
+		struct Pending {
+			const std::string* path;
+			u64 size;
+		};
+		std::vector<Pending> entries;
+		entries.reserve(files.size());
+		std::unordered_set<std::string> seen; // normalized names, the first of any duplicates wins
+		u64 namesBytes = 0;
+		for (const auto& path : files) {
+			std::string normalized = path;
+			std::ranges::replace(normalized, '\\', '/');
+			if (path.empty() || !seen.insert(std::move(normalized)).second)
+				continue;
+			std::error_code error;
+			const u64 size = std::filesystem::file_size(path, error);
+			if (error)
+				return false;
+			entries.push_back(Pending{ &path, size });
+			namesBytes += path.size();
+		}
+		if (namesBytes > std::numeric_limits<u32>::max() || entries.size() > std::numeric_limits<u32>::max() / 2)
+			return false;
+
+		Header header{};
+		header.magic = magic;
+		header.version = version;
+		header.entryCount = static_cast<u32>(entries.size());
+		header.slotCount = std::bit_ceil(std::max<u32>(header.entryCount * 2, 2));
+		header.slotsOffset = sizeof(Header);
+		header.namesOffset = header.slotsOffset + static_cast<u64>(header.slotCount) * sizeof(Slot);
+
+		std::vector<Slot> slots(header.slotCount, Slot{});
+		std::string nameBlob;
+		nameBlob.reserve(static_cast<size_t>(namesBytes));
+		u64 offset = alignUp(header.namesOffset + namesBytes, dataAlignment);
+		for (const auto& entry : entries) {
+			const u64 hash = hashName(*entry.path);
+			u32 i = static_cast<u32>(hash) & (header.slotCount - 1);
+			while (slots[i].nameLength != 0)
+				i = (i + 1) & (header.slotCount - 1);
+			slots[i] = Slot{ hash, offset, entry.size, static_cast<u32>(nameBlob.size()), static_cast<u32>(entry.path->size()) };
+			nameBlob += *entry.path;
+			offset = alignUp(offset + entry.size, dataAlignment);
+		}
+
+		std::ofstream out(packPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(slots.data()), static_cast<std::streamsize>(slots.size() * sizeof(Slot)));
+		out.write(nameBlob.data(), static_cast<std::streamsize>(nameBlob.size()));
+
+		std::vector<char> buffer(1 << 20);
+		const char padding[dataAlignment]{};
+		u64 written = header.namesOffset + nameBlob.size();
+		for (const auto& entry : entries) {
+			const u64 start = alignUp(written, dataAlignment);
+			out.write(padding, static_cast<std::streamsize>(start - written));
+			std::ifstream in(*entry.path, std::ios::binary);
+			u64 remaining = entry.size;
+			while (in && remaining > 0) {
+				in.read(buffer.data(), static_cast<std::streamsize>(std::min<u64>(remaining, buffer.size())));
+				out.write(buffer.data(), in.gcount());
+				remaining -= static_cast<u64>(in.gcount());
+			}
+			if (remaining != 0) // changed size or vanished since we measured it, and the table's already written
+				return false;
+			written = start + entry.size;
+		}
+		return static_cast<bool>(out.flush());
+	}
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "MappedFile.hpp"
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef _WIN32
+#define AUDIOENGINE_API
+#elif defined(AUDIOENGINE_EXPORTS)
+#define AUDIOENGINE_API __declspec(dllexport)
+#else
+#define AUDIOENGINE_API __declspec(dllimport)
+#endif
+
+namespace Audio {
+	/*
+		a whole library or sound set in one file: a header, an open addressing table keyed on a hash of each entry's
+		name, the names, then every file's bytes back to back. opening one maps it and reads nothing else, and find()
+		hands back a view straight into the mapping, so the engine can give those bytes to the decoder without copying.
+		entries are named by the path they were packed from, with / and \ treated the same,
+		so a pack built from the folders a player lists answers the same paths its library produces.
+		little endian, written by write() or the AssetPackBuilder tool
+	*/
+	class AssetPack {
+	public:
+		static constexpr const u32 magic = 0x4B415041; // "APAK"
+		static constexpr const u32 version = 1;
+		static constexpr const u64 dataAlignment = 16; // every file starts on this
+
+		struct Header {
+			u32 magic;
+			u32 version;
+			u32 entryCount;
+			u32 slotCount; // power of 2, at least twice entryCount so probes stay short
+			u64 slotsOffset; // slotCount Slots
+			u64 namesOffset;
+		};
+		struct Slot {
+			u64 hash; // hashName of the entry's name
+			u64 offset; // from the start of the pack
+			u64 size;
+			u32 nameOffset; // from namesOffset
+			u32 nameLength; // 0 for an empty slot
+		};
+
+		// fnv-1a over the name with \ read as /
+		static constexpr auto hashName(std::string_view name) -> u64 {
+			u64 hash = 0xCBF29CE484222325ull;
+			for (char c : name) {
+				hash ^= static_cast<u8>(c == '\\' ? '/' : c);
+				hash *= 0x100000001B3ull;
+			}
+			return hash;
+		}
+
+		AUDIOENGINE_API AssetPack();
+		AUDIOENGINE_API AssetPack(AssetPack&& other) noexcept;
+		AUDIOENGINE_API auto operator=(AssetPack&& other) noexcept -> AssetPack&;
+		AssetPack(const AssetPack&) = delete;
+		void operator=(const AssetPack&) = delete;
+
+		// false (and closed) if it isn't a pack this version can read or its table points outside the file
+		AUDIOENGINE_API auto open(const std::string& path) -> bool;
+		AUDIOENGINE_API auto close() -> void;
+		AUDIOENGINE_API auto isOpen() const -> bool;
+		// the entry's bytes, valid until the pack is closed. empty if there's no such entry
+		AUDIOENGINE_API auto find(std::string_view name) const -> std::span<const u8>;
+		AUDIOENGINE_API auto entryCount() const -> u32;
+		AUDIOENGINE_API auto sizeBytes() const -> u64; // the whole mapping
+
+		// packs files into packPath, each entry named by the path it was read from. false if any of them can't be read
+		// or packPath can't be written, in which case packPath is left incomplete
+		AUDIOENGINE_API static auto write(const std::string& packPath, const std::vector<std::string>& files) -> bool;
+
+	private:
+		MappedFile file;
+		const Header* header;
+		const Slot* slots;
+		const char* names;
+	};
+};
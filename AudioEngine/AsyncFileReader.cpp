@@ -0,0 +1,338 @@
+
+#include "pch.h"
+
+#include "AsyncFileReader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	// positional reads, so workers never fight over a file pointer. -1 if the os read failed, short only at the end
+#ifdef _WIN32
+	auto openFile(const char* path, void*& handle, u64& size) -> bool {
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			CloseHandle(file);
+			return false;
+		}
+		handle = file;
+		size = static_cast<u64>(fileSize.QuadPart);
+		return true;
+	}
+
+	auto closeFile(void* handle) -> void {
+		CloseHandle(handle);
+	}
+
+	auto readAt(void* handle, u64 offset, u8* buffer, u64 size) -> i64 {
+		u64 done = 0;
+		while (done < size) {
+			OVERLAPPED position{};
+			position.Offset = static_cast<DWORD>(offset + done);
+			position.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+			DWORD got = 0;
+			if (!ReadFile(handle, buffer + done, static_cast<DWORD>(std::min<u64>(size - done, 1u << 30)), &got, &position))
+				return GetLastError() == ERROR_HANDLE_EOF ? static_cast<i64>(done) : -1;
+			if (got == 0)
+				break;
+			done += got;
+		}
+		return static_cast<i64>(done);
+	}
+#else
+	auto openFile(const char* path, void*& handle, u64& size) -> bool {
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0) {
+			::close(fd);
+			return false;
+		}
+		handle = reinterpret_cast<void*>(static_cast<intptr_t>(fd));
+		size = static_cast<u64>(info.st_size);
+		return true;
+	}
+
+	auto closeFile(void* handle) -> void {
+		::close(static_cast<int>(reinterpret_cast<intptr_t>(handle)));
+	}
+
+	auto readAt(void* handle, u64 offset, u8* buffer, u64 size) -> i64 {
+		const int fd = static_cast<int>(reinterpret_cast<intptr_t>(handle));
+		u64 done = 0;
+		while (done < size) {
+			ssize_t got = ::pread(fd, buffer + done, size - done, static_cast<off_t>(offset + done));
+			if (got < 0)
+				return -1;
+			if (got == 0)
+				break;
+			done += static_cast<u64>(got);
+		}
+		return static_cast<i64>(done);
+	}
+#endif
+};
+
+AsyncFileReader::AsyncFileReader(u32 threadCount, u32 readAheadBytes) :
+	readAheadBytes{readAheadBytes},
+	queue{},
+	running{},
+	stopping{false},
+	totalsByPath{},
+	latency{},
+	readAheadHits{0},
+	diskBytes{0},
+	workers{}
+{
+	for (u32 i = 0; i < std::max(threadCount, 1u); i++) {
+		this->workers.emplace_back([this]() -> void {
+			this->runWorker();
+		});
+	}
+}
+
+AsyncFileReader::~AsyncFileReader() {
+	{
+		std::lock_guard<std::mutex> lock(this->queueLock);
+		this->stopping = true;
+	}
+	this->queueSignal.notify_all();
+	this->workers.clear(); // joins
+}
+
+auto AsyncFileReader::attach(FMOD_CREATESOUNDEXINFO& info) -> void {
+	info.fileuseropen = open;
+	info.fileuserclose = close;
+	info.fileuserasyncread = read; // with these two set fmod never calls the blocking read and seek
+	info.fileuserasynccancel = cancel;
+	info.fileuserdata = this;
+}
+
+auto AsyncFileReader::addStats(Audio::EngineStats& snapshot) -> void {
+	std::lock_guard<std::mutex> lock(this->statsLock);
+	snapshot.fileRead = this->latency;
+	snapshot.fileReadAheadHits = this->readAheadHits;
+	snapshot.fileDiskBytes = this->diskBytes;
+}
+
+auto AsyncFileReader::getFileStats() -> std::vector<Audio::FileStats> {
+	std::lock_guard<std::mutex> lock(this->statsLock);
+	std::vector<Audio::FileStats> files;
+	files.reserve(this->totalsByPath.size());
+	for (const auto& [path, totals] : this->totalsByPath) {
+		Audio::FileStats& file = files.emplace_back(totals.file);
+		file.meanLatencyNs = file.reads ? totals.latencyTotalNs / file.reads : 0;
+	}
+	return files;
+}
+
+auto F_CALL AsyncFileReader::open(const char* name, unsigned int* fileSize, void** handle, void* userData) -> FMOD_RESULT {
+	auto* reader = static_cast<AsyncFileReader*>(userData);
+	void* osHandle = nullptr;
+	u64 size = 0;
+	if (!openFile(name, osHandle, size))
+		return FMOD_ERR_FILE_NOTFOUND;
+	if (size > std::numeric_limits<unsigned int>::max()) { // fmod's file offsets are 32 bit
+		closeFile(osHandle);
+		return FMOD_ERR_FILE_BAD;
+	}
+	auto* file = new OpenFile{};
+	file->handle = osHandle;
+	file->size = size;
+	{
+		std::lock_guard<std::mutex> lock(reader->statsLock);
+		Totals& totals = reader->totalsByPath[name];
+		totals.file.path = name;
+		totals.file.opens++;
+		file->totals = &totals;
+	}
+	*fileSize = static_cast<unsigned int>(size);
+	*handle = file;
+	return FMOD_OK;
+}
+
+// fmod cancels its own reads first, so only our refills can still be around
+auto F_CALL AsyncFileReader::close(void* handle, void* userData) -> FMOD_RESULT {
+	auto* reader = static_cast<AsyncFileReader*>(userData);
+	auto* file = static_cast<OpenFile*>(handle);
+	{
+		std::unique_lock<std::mutex> lock(file->lock);
+		file->closing = true; // a refill finishing from here on doesn't queue another
+	}
+	u32 dropped = 0;
+	{
+		std::lock_guard<std::mutex> lock(reader->queueLock);
+		dropped = static_cast<u32>(std::erase_if(reader->queue, [file](const Job& job) { return job.file == file; }));
+	}
+	{
+		std::unique_lock<std::mutex> lock(file->lock);
+		file->pendingJobs -= dropped;
+		file->refilled.wait(lock, [file]() { return file->pendingJobs == 0; });
+	}
+	closeFile(file->handle);
+	delete file;
+	return FMOD_OK;
+}
+
+auto F_CALL AsyncFileReader::read(FMOD_ASYNCREADINFO* info, void* userData) -> FMOD_RESULT {
+	auto* reader = static_cast<AsyncFileReader*>(userData);
+	reader->push(Job{ info, static_cast<OpenFile*>(info->handle), Clock::now(), info->priority });
+	return FMOD_OK;
+}
+
+// fmod wants the read either finished or done with an error by the time this returns
+auto F_CALL AsyncFileReader::cancel(FMOD_ASYNCREADINFO* info, void* userData) -> FMOD_RESULT {
+	auto* reader = static_cast<AsyncFileReader*>(userData);
+	std::unique_lock<std::mutex> lock(reader->queueLock);
+	auto queued = std::ranges::find(reader->queue, info, &Job::info);
+	if (queued != reader->queue.end()) {
+		reader->queue.erase(queued);
+		lock.unlock();
+		info->done(info, FMOD_ERR_FILE_DISKEJECTED);
+		return FMOD_OK;
+	}
+	reader->jobDone.wait(lock, [reader, info]() { return std::ranges::find(reader->running, info) == reader->running.end(); });
+	return FMOD_OK;
+}
+
+auto AsyncFileReader::push(Job job) -> void {
+	{
+		std::lock_guard<std::mutex> lock(this->queueLock);
+		// behind everything of the same priority or higher, so equal ones stay first come first served
+		auto position = std::ranges::find_if(this->queue, [&job](const Job& queued) { return queued.priority < job.priority; });
+		this->queue.insert(position, job);
+	}
+	this->queueSignal.notify_one();
+}
+
+auto AsyncFileReader::runWorker() -> void {
+	std::unique_lock<std::mutex> lock(this->queueLock);
+	while (true) {
+		this->queueSignal.wait(lock, [this]() { return this->stopping || !this->queue.empty(); });
+		if (this->stopping)
+			return;
+		Job job = this->queue.front();
+		this->queue.pop_front();
+		if (job.info)
+			this->running.push_back(job.info);
+		lock.unlock();
+		if (job.info)
+			this->serve(job);
+		else
+			this->refill(*job.file);
+		lock.lock();
+		if (job.info) {
+			std::erase(this->running, job.info);
+			this->jobDone.notify_all();
+		}
+	}
+}
+
+auto AsyncFileReader::serve(const Job& job) -> void {
+	FMOD_ASYNCREADINFO* info = job.info;
+	OpenFile& file = *job.file;
+	const u64 offset = info->offset;
+	const u64 wanted = offset < file.size ? std::min<u64>(info->sizebytes, file.size - offset) : 0;
+	u8* buffer = static_cast<u8*>(info->buffer);
+	std::unique_lock<std::mutex> lock(file.lock);
+	file.lastPriority = job.priority;
+	while (true) {
+		const u64 windowEnd = file.windowStart + file.window.size();
+		if (offset >= file.windowStart && offset + wanted <= windowEnd) {
+			std::memcpy(buffer, file.window.data() + (offset - file.windowStart), wanted);
+			file.windowRead = std::max(file.windowRead, offset + wanted - file.windowStart);
+			this->queueRefill(file);
+			lock.unlock();
+			info->bytesread = static_cast<unsigned int>(wanted);
+			this->record(file, job, true, 0, false);
+			info->done(info, wanted < info->sizebytes ? FMOD_ERR_FILE_EOF : FMOD_OK);
+			return;
+		}
+		if (!file.refillRunning || offset != windowEnd)
+			break;
+		file.refilled.wait(lock, [&file]() { return !file.refillRunning; }); // it's fetching exactly these bytes, no point reading them twice
+	}
+	// a seek, or the disk didn't keep up. the window starts over right after this read, and gets filled alongside it
+	file.generation++;
+	file.window.clear();
+	file.windowStart = offset + wanted;
+	file.windowRead = 0;
+	this->queueRefill(file);
+	lock.unlock();
+	const i64 got = readAt(file.handle, offset, buffer, wanted);
+	info->bytesread = got < 0 ? 0 : static_cast<unsigned int>(got);
+	this->record(file, job, false, got < 0 ? 0 : static_cast<u64>(got), got < 0);
+	if (got < 0)
+		info->done(info, FMOD_ERR_FILE_BAD);
+	else
+		info->done(info, static_cast<u64>(got) < info->sizebytes ? FMOD_ERR_FILE_EOF : FMOD_OK);
+}
+
+auto AsyncFileReader::refill(OpenFile& file) -> void {
+	std::unique_lock<std::mutex> lock(file.lock);
+	file.refillQueued = false;
+	file.refillRunning = true;
+	const u64 generation = file.generation;
+	const u64 start = file.windowStart + file.window.size();
+	const u64 amount = std::min<u64>(this->readAheadBytes, file.size - start);
+	lock.unlock();
+	std::vector<u8> bytes(amount);
+	const i64 got = readAt(file.handle, start, bytes.data(), amount);
+	if (got > 0) {
+		std::lock_guard<std::mutex> statsGuard(this->statsLock);
+		file.totals->file.diskBytes += static_cast<u64>(got);
+		this->diskBytes += static_cast<u64>(got);
+	}
+	lock.lock();
+	file.refillRunning = false;
+	file.pendingJobs--;
+	if (got > 0 && generation == file.generation) {
+		// what fmod has already read goes, the rest stays in front of the new bytes
+		file.window.erase(file.window.begin(), file.window.begin() + static_cast<std::ptrdiff_t>(file.windowRead));
+		file.windowStart += file.windowRead;
+		file.windowRead = 0;
+		file.window.insert(file.window.end(), bytes.begin(), bytes.begin() + got);
+	}
+	if (got >= 0)
+		this->queueRefill(file); // the window was thrown away meanwhile, or fmod's already through half of this one
+	file.refilled.notify_all();
+}
+
+auto AsyncFileReader::queueRefill(OpenFile& file) -> void {
+	if (file.refillQueued || file.refillRunning || file.closing)
+		return;
+	const u64 windowEnd = file.windowStart + file.window.size();
+	const u64 unread = file.window.size() - file.windowRead;
+	if (windowEnd >= file.size || unread * 2 >= this->readAheadBytes)
+		return;
+	file.refillQueued = true;
+	file.pendingJobs++;
+	this->push(Job{ nullptr, &file, Clock::now(), file.lastPriority });
+}
+
+auto AsyncFileReader::record(OpenFile& file, const Job& job, bool hit, u64 diskBytes, bool failed) -> void {
+	const u64 ns = static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - job.queued).count());
+	std::lock_guard<std::mutex> lock(this->statsLock);
+	Totals& totals = *file.totals;
+	totals.file.reads++;
+	totals.file.readAheadHits += hit ? 1 : 0;
+	totals.file.bytesServed += job.info->bytesread;
+	totals.file.diskBytes += diskBytes;
+	totals.file.failedReads += failed ? 1 : 0;
+	totals.file.maxLatencyNs = std::max(totals.file.maxLatencyNs, ns);
+	totals.latencyTotalNs += ns;
+	this->latency.record(ns);
+	this->readAheadHits += hit ? 1 : 0;
+	this->diskBytes += diskBytes;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "EngineStats.hpp"
+#include "FileStats.hpp"
+
+#include "fmod.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+	fmod's file i/o, done on our own worker threads instead of fmod's blocking reads. fmod hands each read over
+	through the async callbacks and carries on, a worker fills it and calls done. reads go highest fmod priority
+	first, which puts streams ahead of loads.
+	every open file keeps a read-ahead window: once a read leaves less than half of it unread, a worker tops it up
+	with the next readAheadBytes in the background. a stream reading front to back then finds its next block already
+	in memory, and a slow disk only has to keep up on average instead of on every read.
+	plain positional reads on the workers rather than overlapped i/o or io_uring, it's a handful of streams at a time.
+	attach() a createSound's exinfo to it, everything else is called by fmod from its own threads
+*/
+class AsyncFileReader {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	AsyncFileReader(u32 threadCount, u32 readAheadBytes);
+	~AsyncFileReader(); // fmod has to have closed every file by now, i.e. the system is released
+	AsyncFileReader(const AsyncFileReader&) = delete;
+	void operator=(const AsyncFileReader&) = delete;
+
+	auto attach(FMOD_CREATESOUNDEXINFO& info) -> void;
+	auto addStats(Audio::EngineStats& snapshot) -> void; // the totals, fileRead and friends
+	auto getFileStats() -> std::vector<Audio::FileStats>;
+
+private:
+	struct Totals {
+		Audio::FileStats file;
+		u64 latencyTotalNs = 0;
+	};
+	struct OpenFile {
+		void* handle; // HANDLE on windows, fd stuffed in a pointer elsewhere
+		u64 size;
+		Totals* totals; // node in totalsByPath, lives as long as the reader. statsLock
+		// everything below is lock's
+		std::mutex lock;
+		std::condition_variable refilled;
+		std::vector<u8> window; // read-ahead bytes, file offsets [windowStart, windowStart + window.size())
+		u64 windowStart = 0;
+		u64 windowRead = 0; // how far into the window fmod has read, the rest is still ahead of it
+		u64 generation = 0; // bumped whenever the window is thrown away, so a refill that was reading for the old one drops its bytes
+		i32 lastPriority = 0; // of fmod's latest read, refills go in at the same priority
+		bool refillQueued = false;
+		bool refillRunning = false;
+		bool closing = false;
+		u32 pendingJobs = 0; // refills queued or running, close waits them out
+	};
+	struct Job {
+		FMOD_ASYNCREADINFO* info; // null for a refill
+		OpenFile* file;
+		Clock::time_point queued;
+		i32 priority;
+	};
+
+	static auto F_CALL open(const char* name, unsigned int* fileSize, void** handle, void* userData) -> FMOD_RESULT;
+	static auto F_CALL close(void* handle, void* userData) -> FMOD_RESULT;
+	static auto F_CALL read(FMOD_ASYNCREADINFO* info, void* userData) -> FMOD_RESULT;
+	static auto F_CALL cancel(FMOD_ASYNCREADINFO* info, void* userData) -> FMOD_RESULT;
+
+	auto push(Job job) -> void;
+	auto runWorker() -> void;
+	auto serve(const Job& job) -> void;
+	auto refill(OpenFile& file) -> void;
+	auto queueRefill(OpenFile& file) -> void; // file.lock held. no-op if one's already on its way or the window reaches the end
+	auto record(OpenFile& file, const Job& job, bool hit, u64 diskBytes, bool failed) -> void;
+
+	u64 readAheadBytes;
+
+	std::mutex queueLock;
+	std::condition_variable queueSignal; // a job came in, or stopping
+	std::condition_variable jobDone; // for cancel and close waiting on a running job
+	std::deque<Job> queue;
+	std::vector<FMOD_ASYNCREADINFO*> running; // fmod reads a worker is on right now
+	bool stopping;
+
+	std::mutex statsLock;
+	std::unordered_map<std::string, Totals> totalsByPath;
+	Audio::LatencyHistogram latency;
+	u64 readAheadHits;
+	u64 diskBytes;
+
+	std::vector<std::jthread> workers; // last, so they're stopped before anything they touch goes
+};
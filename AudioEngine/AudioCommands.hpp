@@ -0,0 +1,116 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "Vec.hpp"
+#include "SlotMap.hpp"
+#include "DspUnit.hpp"
+#include "AudioEngineConfig.hpp"
+
+#include <string>
+#include <memory>
+#include <variant>
+#include <functional>
+
+/*
+	everything a caller can ask the engine to do in commandQueue mode. each one is
+	built on the caller's thread and run later by the update thread, so they carry copies
+	of everything they need. channel ids and sound keys are handed out up front so callers still get one back.
+*/
+namespace AudioCommands {
+	struct LoadSound {
+		SlotKey key;
+		std::string path;
+		std::string soundName;
+		bool space3d;
+		bool looping;
+		Audio::LoadMode mode;
+		u64 fileBytes; // AudioEngineCore::fileBytesForPolicy, worked out on the caller's thread
+	};
+	struct LoadSoundAsync {
+		SlotKey key;
+		std::string path;
+		std::string soundName;
+		bool space3d;
+		bool looping;
+		Audio::LoadMode mode;
+		u64 fileBytes;
+		std::function<void(bool)> onLoaded;
+	};
+	struct AwaitLoad {
+		SlotKey key;
+		std::function<void(bool)> onLoaded;
+	};
+	struct UnloadSound {
+		SlotKey key;
+	};
+	struct SetListener {
+		Audio::Vec3<f32> pos;
+		Audio::Vec3<f32> look;
+		Audio::Vec3<f32> up;
+	};
+	struct PlaySound {
+		i32 channelId;
+		SlotKey key;
+		Audio::Vec3<f32> pos;
+		f32 volumedB;
+	};
+	struct PlayWhenReady {
+		i32 channelId;
+		SlotKey key;
+		Audio::Vec3<f32> pos;
+		f32 volumedB;
+	};
+	struct Crossfade {
+		i32 channelId;
+		SlotKey key;
+		i32 fromChannelId;
+		u32 fadeMs;
+		f32 volumedB;
+	};
+	struct StopChannel {
+		i32 channelId;
+	};
+	struct StopAllChannels {};
+	struct SetChannel3dPosition {
+		i32 channelId;
+		Audio::Vec3<f32> pos;
+		u32 sequence; // nextWriteSequence when it was called, the batches go by the same count
+	};
+	struct SetChannelVolume {
+		i32 channelId;
+		f32 volumedB;
+		u32 sequence;
+	};
+	struct SetSoundPriority {
+		SlotKey key;
+		i32 priority;
+	};
+	struct AddEffect {
+		i32 effectId;
+		std::shared_ptr<Audio::DspUnit> unit;
+		i32 channelId;
+	};
+	struct RemoveEffect {
+		i32 effectId;
+	};
+};
+
+using AudioCommand = std::variant<
+	std::monostate, // empty slot
+	AudioCommands::LoadSound,
+	AudioCommands::LoadSoundAsync,
+	AudioCommands::AwaitLoad,
+	AudioCommands::UnloadSound,
+	AudioCommands::SetListener,
+	AudioCommands::PlaySound,
+	AudioCommands::PlayWhenReady,
+	AudioCommands::Crossfade,
+	AudioCommands::StopChannel,
+	AudioCommands::StopAllChannels,
+	AudioCommands::SetChannel3dPosition,
+	AudioCommands::SetChannelVolume,
+	AudioCommands::SetSoundPriority,
+	AudioCommands::AddEffect,
+	AudioCommands::RemoveEffect
+>;
@@ -3,17 +3,31 @@
 
 #include "AudioEngine.hpp"
 
+#ifndef AUDIOENGINE_NATIVE_ONLY
 #include "AudioEngineFMODImpl.hpp"
+#endif
+#include "AudioEngineNativeImpl.hpp"
 
 namespace Audio {
-	AudioEngineFMODImpl* impl = nullptr;
-	
-	auto Vec3ToFMODVec(const Vec3<f32>& in) -> FMOD_VECTOR {
-		return FMOD_VECTOR{ in.x, in.y, in.z };
+	AudioEngineCore* impl = nullptr;
+
+	auto toKey(SoundHandle handle) -> SlotKey {
+		return SlotKey{ handle.index, handle.generation };
+	}
+
+	auto toHandle(SlotKey key) -> SoundHandle {
+		return SoundHandle{ key.index, key.generation };
 	}
 
-	auto AudioEngine::init() -> void {
-		impl = new AudioEngineFMODImpl();
+	auto AudioEngine::init(const AudioEngineConfig& config) -> void {
+#ifndef AUDIOENGINE_NATIVE_ONLY
+		if (config.backend == Backend::native)
+			impl = new AudioEngineNativeImpl(config);
+		else
+			impl = new AudioEngineFMODImpl(config);
+#else
+		impl = new AudioEngineNativeImpl(config); // the only one built
+#endif
 	}
 
 	auto AudioEngine::update() -> void {
@@ -22,129 +36,213 @@ namespace Audio {
 
 	auto AudioEngine::shutdown() -> void {
 		delete impl;
+		impl = nullptr;
 	}
 
-	auto AudioEngine::loadSound(const std::string& path, const std::string& soundName, bool space3d, bool looping, bool stream) -> int {
-		auto foundIter = impl->sounds.find(soundName);
-		if (foundIter != impl->sounds.end()) return 0; // sound by that name already exists
+	auto AudioEngine::waitForWork(std::chrono::milliseconds timeout) -> void {
+		impl->waitForWork(timeout);
+	}
 
-		FMOD_MODE mode = FMOD_DEFAULT;
-		mode |= space3d ? FMOD_3D : FMOD_2D;
-		mode |= looping ? FMOD_LOOP_NORMAL : FMOD_LOOP_OFF;
-		mode |= stream ? FMOD_CREATESTREAM : FMOD_CREATECOMPRESSEDSAMPLE;
-		FMOD::Sound* sound = nullptr;
-		impl->system->createSound(path.c_str(), mode, nullptr, &sound);
-		if (sound) {
-			impl->sounds[soundName] = sound;
-			return 1; // success in creating new sound
+	auto AudioEngine::wake() -> void {
+		impl->wake();
+	}
+
+	auto AudioEngine::loadSound(const std::string& path, const std::string& soundName, bool space3d, bool looping, LoadMode mode) -> SoundHandle {
+		auto [key, isNew] = impl->registerSound(soundName);
+		if (!isNew)
+			return toHandle(key);
+		const u64 fileBytes = impl->fileBytesForPolicy(path, mode);
+		if (impl->isQueued()) {
+			if (!impl->submit(AudioCommands::LoadSound{ key, path, soundName, space3d, looping, mode, fileBytes })) {
+				impl->forgetSound(soundName, key);
+				impl->soundKeys.release(key);
+				return SoundHandle{};
+			}
+			return toHandle(key);
 		}
-		return -1; // failed to create new sound
+		if (!impl->loadSound(key, path, soundName, space3d, looping, mode, fileBytes))
+			return SoundHandle{};
+		return toHandle(key);
+	}
+
+	auto AudioEngine::loadSound(const std::string& soundName, bool space3d, bool looping, LoadMode mode) -> SoundHandle {
+		return this->loadSound(soundName, soundName, space3d, looping, mode);
+	}
+
+	auto AudioEngine::loadSoundAsync(const std::string& path, const std::string& soundName, bool space3d, bool looping, LoadMode mode, std::function<void(bool)> onLoaded) -> SoundHandle {
+		auto [key, isNew] = impl->registerSound(soundName);
+		if (!isNew) { // loaded or already on its way. wait with everyone else
+			if (onLoaded)
+				impl->submit(AudioCommands::AwaitLoad{ key, std::move(onLoaded) });
+			return toHandle(key);
+		}
+		const u64 fileBytes = impl->fileBytesForPolicy(path, mode);
+		if (!impl->submit(AudioCommands::LoadSoundAsync{ key, path, soundName, space3d, looping, mode, fileBytes, std::move(onLoaded) })) {
+			impl->forgetSound(soundName, key);
+			impl->soundKeys.release(key);
+			return SoundHandle{};
+		}
+		return toHandle(key);
+	}
+
+	auto AudioEngine::findSound(const std::string& soundName) const -> SoundHandle {
+		return toHandle(impl->findSound(soundName));
+	}
+
+	auto AudioEngine::mountPack(const std::string& packPath) -> bool {
+		return impl->mountPack(packPath);
 	}
 
-	auto AudioEngine::loadSound(const std::string& soundName, bool space3d, bool looping, bool stream) -> void {
-		this->loadSound(soundName, soundName, space3d, looping, stream);
+	auto AudioEngine::unloadSound(SoundHandle sound) -> void {
+		impl->submit(AudioCommands::UnloadSound{ toKey(sound) });
 	}
 
 	auto AudioEngine::unloadSound(const std::string& soundName) -> void {
-		auto foundIter = impl->sounds.find(soundName);
-		if (foundIter == impl->sounds.end()) return;
-		foundIter->second->release();
-		impl->sounds.erase(foundIter);
+		SlotKey key = impl->findSound(soundName);
+		if (key.generation == 0) return;
+		impl->forgetSound(soundName, key); // now, so a load right after this gets a fresh sound
+		impl->submit(AudioCommands::UnloadSound{ key });
 	}
 
 	auto AudioEngine::set3dListenerAndOrientation(const Vec3<f32>& pos, const Vec3<f32>& look, const Vec3<f32>& up) -> void {
-		FMOD_VECTOR position = Vec3ToFMODVec(pos);
-		FMOD_VECTOR looking = Vec3ToFMODVec(look);
-		FMOD_VECTOR upward = Vec3ToFMODVec(up);
-		impl->system->set3DListenerAttributes(0, &position, nullptr, &looking, &upward);
+		impl->submit(AudioCommands::SetListener{ pos, look, up });
 	}
 
-	auto AudioEngine::playSound(const std::string& soundName, const Vec3<f32>& pos, f32 volumedB) -> i32 {
-		i32 channelId = impl->nextChannelId++;
-		auto foundIter = impl->sounds.find(soundName);
-		if (foundIter == impl->sounds.end()) {
-			this->loadSound(soundName);
-			foundIter = impl->sounds.find(soundName);
-			if (foundIter == impl->sounds.end()) {
-				return channelId; // this is a failure case, but return valid channel id anyway
-			}
-		}
-		FMOD::Channel* channel = nullptr;
-		impl->system->playSound(foundIter->second, impl->channelGroup, true, &channel);
-		if (channel) { // don't want to play sound automatically because still need to set some values on the channel
-			FMOD_VECTOR position = Vec3ToFMODVec(pos);
-			channel->set3DAttributes(&position, nullptr);
-			channel->setVolume(dBToVolume(volumedB));
-			channel->setPaused(false);
-			impl->channels[channelId] = channel;
+	auto AudioEngine::playSound(SoundHandle sound, const Vec3<f32>& pos, f32 volumedB) -> i32 {
+		i32 channelId = impl->channels.acquireId();
+		if (channelId == 0)
+			return 0; // every channel handle is in use
+		if (!impl->submit(AudioCommands::PlaySound{ channelId, toKey(sound), pos, volumedB })) {
+			impl->channels.abandonId(channelId);
+			return 0;
 		}
-		return channelId;
+		return channelId; // returned even if the sound turns out to be missing, same as before
+	}
+
+	auto AudioEngine::playSound(const std::string& soundName, const Vec3<f32>& pos, f32 volumedB) -> i32 {
+		return this->playSound(this->findSound(soundName), pos, volumedB);
 	}
 
 	auto AudioEngine::loadAndPlaySound(const std::string& path, const std::string& soundName, const Vec3<f32>& pos, f32 volumedB) -> i32 {
-		i32 channelId = impl->nextChannelId++;
-		if (this->loadSound(path, soundName) < 0) {
-			return channelId; // failed to load
-		}
-		auto foundIter = impl->sounds.find(soundName);
-		if (foundIter == impl->sounds.end()) {
-			return channelId; // error case. shouldn't happen unless multiple threads involved
+		return this->playSound(this->loadSound(path, soundName), pos, volumedB);
+	}
+
+	auto AudioEngine::playWhenReady(SoundHandle sound, const Vec3<f32>& pos, f32 volumedB) -> i32 {
+		i32 channelId = impl->channels.acquireId();
+		if (channelId == 0)
+			return 0;
+		if (!impl->submit(AudioCommands::PlayWhenReady{ channelId, toKey(sound), pos, volumedB })) {
+			impl->channels.abandonId(channelId);
+			return 0;
 		}
-		
-		FMOD::Channel* channel = nullptr;
-		impl->system->playSound(foundIter->second, impl->channelGroup, true, &channel);
-		if (channel) { // don't want to play sound automatically because still need to set some values on the channel
-			FMOD_VECTOR position = Vec3ToFMODVec(pos);
-			channel->set3DAttributes(&position, nullptr);
-			channel->setVolume(dBToVolume(volumedB));
-			channel->setPaused(false);
-			impl->channels[channelId] = channel;
+		return channelId;
+	}
+
+	auto AudioEngine::playWhenReady(const std::string& soundName, const Vec3<f32>& pos, f32 volumedB) -> i32 {
+		return this->playWhenReady(this->findSound(soundName), pos, volumedB);
+	}
+
+	auto AudioEngine::crossfade(i32 fromChannelId, SoundHandle next, std::chrono::milliseconds fade, f32 volumedB) -> i32 {
+		i32 channelId = impl->channels.acquireId();
+		if (channelId == 0)
+			return 0;
+		u32 fadeMs = static_cast<u32>(std::max<i64>(fade.count(), 0));
+		if (!impl->submit(AudioCommands::Crossfade{ channelId, toKey(next), fromChannelId, fadeMs, volumedB })) {
+			impl->channels.abandonId(channelId);
+			return 0;
 		}
 		return channelId;
 	}
 
 	auto AudioEngine::stopChannel(i32 channelId) -> void {
-		auto foundIter = impl->channels.find(channelId);
-		if (foundIter == impl->channels.end()) return;
-		foundIter->second->stop();
+		impl->submit(AudioCommands::StopChannel{ channelId });
 	}
 
 	auto AudioEngine::stopAllChannels() -> void {
-		for (auto& channel : impl->channels) {
-			channel.second->stop();
-		}
+		impl->submit(AudioCommands::StopAllChannels{});
 	}
 
 	auto AudioEngine::setChannel3dPosition(i32 channelId, const Vec3<f32>& pos) -> void {
-		auto foundIter = impl->channels.find(channelId);
-		if (foundIter == impl->channels.end()) return;
-		FMOD_VECTOR position = Vec3ToFMODVec(pos);
-		foundIter->second->set3DAttributes(&position, nullptr);
+		impl->submit(AudioCommands::SetChannel3dPosition{ channelId, pos, impl->nextWriteSequence() });
+	}
+
+	auto AudioEngine::setChannel3dPositions(std::span<const i32> channelIds, std::span<const Vec3<f32>> positions, std::span<const Vec3<f32>> velocities) -> void {
+		impl->positionBatch.append(channelIds, positions, velocities, impl->nextWriteSequence());
 	}
 
 	auto AudioEngine::setChannelVolume(i32 channelId, f32 volumedB) -> void {
-		auto foundIter = impl->channels.find(channelId);
-		if (foundIter == impl->channels.end()) return;
-		foundIter->second->setVolume(dBToVolume(volumedB));
+		impl->submit(AudioCommands::SetChannelVolume{ channelId, volumedB, impl->nextWriteSequence() });
+	}
+
+	auto AudioEngine::setChannelVolumes(std::span<const i32> channelIds, std::span<const f32> volumesdB) -> void {
+		impl->volumeBatch.append(channelIds, volumesdB, impl->nextWriteSequence());
+	}
+
+	auto AudioEngine::setSoundPriority(SoundHandle sound, i32 priority) -> void {
+		impl->submit(AudioCommands::SetSoundPriority{ toKey(sound), priority });
+	}
+
+	auto AudioEngine::addEffect(std::shared_ptr<DspUnit> unit, i32 channelId) -> i32 {
+		if (!unit) return 0;
+		i32 effectId = impl->nextEffectId.fetch_add(1, std::memory_order_relaxed);
+		if (!impl->submit(AudioCommands::AddEffect{ effectId, std::move(unit), channelId }))
+			return 0;
+		return effectId;
+	}
+
+	auto AudioEngine::removeEffect(i32 effectId) -> void {
+		impl->submit(AudioCommands::RemoveEffect{ effectId });
+	}
+
+	auto AudioEngine::isVirtual(i32 channelId) const -> bool {
+		return impl->isVirtual(channelId);
 	}
 
 	auto AudioEngine::isPlaying(i32 channelId) const -> bool {
-		auto foundIter = impl->channels.find(channelId);
-		if (foundIter == impl->channels.end())
-			return false;
-		bool playing;
-		foundIter->second->isPlaying(&playing);
-		return playing;
+		// waiting on a load counts too. channels that ended drop out of the table on the next update()
+		return impl->channels.find(channelId) != nullptr;
 	}
 	auto AudioEngine::getPlayingSound(i32 channelId) const -> std::optional<SoundInfo> {
-		auto foundIter = impl->channels.find(channelId);
-		if (foundIter != impl->channels.end()) {
-			FMOD::Sound* sound;
-			foundIter->second->getCurrentSound(&sound);
-			if (sound) {
-				return std::optional<SoundInfo>(std::in_place, sound, foundIter->second);
-			}
-		}
-		 return std::optional<SoundInfo>{};
+		return impl->getPlayingSound(channelId);
+	}
+
+	auto AudioEngine::getPlaybackPosition(i32 channelId) const -> std::optional<PlaybackPosition> {
+		return impl->getPlaybackPosition(channelId);
+	}
+
+	auto AudioEngine::getSoundInfo(SoundHandle sound) const -> const SoundInfo* {
+		return impl->getSoundInfo(toKey(sound));
+	}
+
+	auto AudioEngine::getLoadState(SoundHandle sound) const -> LoadState {
+		return impl->getLoadState(toKey(sound));
+	}
+
+	auto AudioEngine::getLoadState(const std::string& soundName) const -> LoadState {
+		return this->getLoadState(this->findSound(soundName));
+	}
+
+	auto AudioEngine::getSoundMemoryUsage(SoundHandle sound) const -> u64 {
+		return impl->getSoundMemoryUsage(toKey(sound));
+	}
+
+	auto AudioEngine::getSoundMemoryUsage(const std::string& soundName) const -> u64 {
+		return this->getSoundMemoryUsage(this->findSound(soundName));
+	}
+
+	auto AudioEngine::getStats() const -> EngineStats {
+		return impl->getStats();
+	}
+
+	auto AudioEngine::getFileStats() const -> std::vector<FileStats> {
+		return impl->getFileStats();
+	}
+
+	auto AudioEngine::getRenderedTime() const -> std::chrono::microseconds {
+		return impl->getRenderedTime();
+	}
+
+	auto AudioEngine::pollEvent(PlaybackEvent& out) -> bool {
+		return impl->pollEvent(out);
 	}
 };
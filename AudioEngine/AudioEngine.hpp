@@ -4,12 +4,26 @@
 
 #include "Vec.hpp"
 
+#include "AudioEngineConfig.hpp"
+#include "SoundHandle.hpp"
+
 #include "SoundInfo.hpp"
+#include "EngineStats.hpp"
+#include "FileStats.hpp"
+#include "PlaybackEvent.hpp"
+#include "DspUnit.hpp"
 
 #include <string>
+#include <chrono>
+#include <span>
+#include <memory>
 #include <optional>
+#include <functional>
+#include <vector>
 
-#ifdef AUDIOENGINE_EXPORTS
+#ifndef _WIN32
+#define AUDIOENGINE_API
+#elif defined(AUDIOENGINE_EXPORTS)
 #define AUDIOENGINE_API __declspec(dllexport)
 #else
 #define AUDIOENGINE_API __declspec(dllimport)
@@ -25,24 +39,104 @@
 // with a un-exported implementation. kinda clever
 
 namespace Audio {
+	enum struct LoadState : i32 {
+		notLoaded = 0, // never asked for, unloaded, or the load failed
+		loading = 1,
+		loaded = 2
+	};
+
+	// everything a now-playing line needs, without building a SoundInfo
+	struct PlaybackPosition {
+		SoundHandle sound;
+		std::chrono::milliseconds position;
+		std::chrono::milliseconds duration; // zero until the sound is loaded
+	};
+
+	// with ThreadingMode::commandQueue, the thread calling update() owns the engine.
+	// control calls (load/unload/play/stop/set*) can come from any thread and just queue a command.
+	// with an nrt OutputMode, each update() mixes one block instead of fmod mixing in realtime on its own thread.
+	// queries (isPlaying, getPlayingSound, getPlaybackPosition, getSoundInfo, getStats, pollEvent) read engine state directly so keep them on the update thread.
 	class AUDIOENGINE_API AudioEngine {
 	public:
-		static auto init() -> void;
+		static auto init(const AudioEngineConfig& config = AudioEngineConfig{}) -> void;
 		static auto update() -> void;
 		static auto shutdown() -> void;
+		// for the update thread, between update()s. sleeps until another thread queues a command or calls wake(), or
+		// timeout runs out, so an idle host isn't spinning. returns straight away if there are unpolled events
+		static auto waitForWork(std::chrono::milliseconds timeout) -> void;
+		static auto wake() -> void; // any thread. for when something other than a command should get update()'s caller going
 
-		auto loadSound(const std::string& soundName, bool space3d = true, bool looping = false, bool stream = false) -> void;
-		auto loadSound(const std::string& path, const std::string& soundName, bool space3d = true, bool looping = false, bool stream = false) -> int;
+		// loading under a name that's already registered just hands back the existing handle.
+		// in commandQueue mode the load itself happens later, and a failed load leaves the handle dead.
+		// mode is how the sound is held in memory, automatic leaves it to AudioEngineConfig::loadPolicy
+		auto loadSound(const std::string& soundName, bool space3d = true, bool looping = false, LoadMode mode = LoadMode::automatic) -> SoundHandle;
+		auto loadSound(const std::string& path, const std::string& soundName, bool space3d = true, bool looping = false, LoadMode mode = LoadMode::automatic) -> SoundHandle;
+		// opens on fmod's loader thread and returns right away. onLoaded(success) runs inside a later update(), never from
+		// in here, even when the load fails up front or the sound was already loaded
+		auto loadSoundAsync(const std::string& path, const std::string& soundName, bool space3d = true, bool looping = false, LoadMode mode = LoadMode::automatic, std::function<void(bool)> onLoaded = {}) -> SoundHandle;
+		auto findSound(const std::string& soundName) const -> SoundHandle; // invalid handle if no sound has that name
+		// maps an asset pack (see AssetPack.hpp) for the rest of the engine's life. from then on any load whose path is
+		// an entry in it opens straight out of the mapping instead of the file. later mounts win when packs overlap.
+		// safe from any thread, loads queued after it returns see the pack. false if it isn't a readable pack
+		auto mountPack(const std::string& packPath) -> bool;
+		auto unloadSound(SoundHandle sound) -> void;
 		auto unloadSound(const std::string& soundName) -> void;
 		auto set3dListenerAndOrientation(const Vec3<f32>& pos, const Vec3<f32>& look, const Vec3<f32>& up) -> void;
-		auto playSound(const std::string& soundName, const Vec3<f32>& pos = Vec3<f32>{ 0, 0, 0 }, f32 volumedB = 0) -> i32;
+		// channel ids are never 0, 0 means the play couldn't even be queued (out of channel handles or queue space)
+		auto playSound(SoundHandle sound, const Vec3<f32>& pos = Vec3<f32>{ 0, 0, 0 }, f32 volumedB = 0) -> i32;
+		auto playSound(const std::string& soundName, const Vec3<f32>& pos = Vec3<f32>{ 0, 0, 0 }, f32 volumedB = 0) -> i32; // findSound + playSound, never loads
 		auto loadAndPlaySound(const std::string& path, const std::string& soundName, const Vec3<f32>& pos = Vec3<f32>{ 0, 0, 0 }, f32 volumedB = 0) -> i32;
+		// starts as soon as the sound finishes an async load (or now if loaded). never loads on its own.
+		// the channel counts as playing while it waits so isPlaying loops don't skip past it
+		auto playWhenReady(SoundHandle sound, const Vec3<f32>& pos = Vec3<f32>{ 0, 0, 0 }, f32 volumedB = 0) -> i32;
+		auto playWhenReady(const std::string& soundName, const Vec3<f32>& pos = Vec3<f32>{ 0, 0, 0 }, f32 volumedB = 0) -> i32;
+		// plays next fading in over `fade` while fromChannelId fades out, lined up so fromChannelId goes silent on the last
+		// sample of its sound (or `fade` from now if it loops). the start, both curves and the stop are all handed to the
+		// mixer ahead of time on its own clock, so they're sample accurate whenever update() gets around to running.
+		// call it at least `fade` before the end for the full overlap. waits for next to load like playWhenReady,
+		// and is just playWhenReady if fromChannelId isn't playing. 0 the same way playSound returns it
+		auto crossfade(i32 fromChannelId, SoundHandle next, std::chrono::milliseconds fade, f32 volumedB = 0) -> i32;
 		auto stopChannel(i32 channelId) -> void;
 		auto stopAllChannels() -> void;
 		auto setChannel3dPosition(i32 channelId, const Vec3<f32>& pos) -> void;
+		// for moving lots of emitters every frame. positions[i] (and velocities[i], if there's one per channel) go to
+		// channelIds[i]. the spans are copied straight away and applied in one pass on the next update(), so channels
+		// started in the same update get moved too. whichever was called last wins, a batch entry or setChannel3dPosition.
+		// safe from any thread in either threading mode
+		auto setChannel3dPositions(std::span<const i32> channelIds, std::span<const Vec3<f32>> positions, std::span<const Vec3<f32>> velocities = {}) -> void;
 		auto setChannelVolume(i32 channelId, f32 volumedB) -> void;
+		// batch version for volume ramps over many channels, works like setChannel3dPositions. the dB to linear
+		// conversion for the whole batch happens in one vectorized pass on the next update()
+		auto setChannelVolumes(std::span<const i32> channelIds, std::span<const f32> volumesdB) -> void;
+		// 0 is most important, 256 least, 128 by default. when real voices run out, lower priority channels go virtual
+		// (or get stolen) first, audibility breaks ties. applies to channels already playing the sound too
+		auto setSoundPriority(SoundHandle sound, i32 priority) -> void;
+		// runs unit inside fmod's mixer. channelId 0 is the main group every channel mixes into, otherwise it goes on that
+		// channel (once it starts, if it's waiting on a load) and is dropped when the channel ends. effects in the same
+		// place run in the order they were added. returns an id for removeEffect, 0 if it couldn't be queued.
+		// keep the shared_ptr to change parameters later, setParameter is safe from any thread
+		auto addEffect(std::shared_ptr<DspUnit> unit, i32 channelId = 0) -> i32;
+		auto removeEffect(i32 effectId) -> void;
+		auto isVirtual(i32 channelId) const -> bool; // playing but not being mixed right now. false if not playing
 		auto isPlaying(i32 channelId) const -> bool;
-		auto getPlayingSound(i32 channelId) const -> std::optional<SoundInfo>;
+		auto getPlayingSound(i32 channelId) const -> std::optional<SoundInfo>; // rereads everything incl. tags, prefer the two below for polling
+		auto getPlaybackPosition(i32 channelId) const -> std::optional<PlaybackPosition>; // no allocations, fine to call every frame
+		// built once when the sound finishes loading. valid until the sound is unloaded, nullptr if it isn't loaded
+		auto getSoundInfo(SoundHandle sound) const -> const SoundInfo*;
+		auto getLoadState(SoundHandle sound) const -> LoadState;
+		auto getLoadState(const std::string& soundName) const -> LoadState;
+		// the estimate AudioEngineConfig::soundMemoryBudget is enforced against. idle sounds past the budget get unloaded
+		// by update() (soundEvicted event) and their handles go dead, so check getLoadState before replaying an old one
+		auto getSoundMemoryUsage(SoundHandle sound) const -> u64; // 0 if not loaded
+		auto getSoundMemoryUsage(const std::string& soundName) const -> u64;
+		// audio the mixer has produced since init. in the nrt output modes this only moves when update() is called
+		auto getRenderedTime() const -> std::chrono::microseconds;
+		auto getStats() const -> EngineStats; // cheap enough to call every frame, counters run for the engine's whole life
+		// one entry per file fmod has read through the engine's i/o workers, empty unless AudioEngineConfig::ioThreads is set
+		auto getFileStats() const -> std::vector<FileStats>;
+		// channel ends and load results from the update()s so far, oldest first. false once there are none left.
+		// an ended channel id never comes back, so unlike an isPlaying check this can't mistake a queued play for a finished one
+		auto pollEvent(PlaybackEvent& out) -> bool;
 	};
 };
 
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+namespace Audio {
+	enum struct ThreadingMode : i32 {
+		callerThread = 0, // every call goes straight to fmod on whatever thread made it (not thread safe)
+		commandQueue = 1 // control calls are queued and run by whichever thread calls update()
+	};
+
+	enum struct OutputMode : i32 {
+		realtime = 0, // default output device, fmod mixes on its own thread in realtime
+		noSoundNRT = 1, // no device. every update() mixes one block, as fast as update() gets called
+		wavWriterNRT = 2 // like noSoundNRT, but the mix is written to wavWriterPath
+	};
+
+	enum struct Backend : i32 {
+		fmod = 0,
+		// our own decoders and mixer (wav and flac only). no device output, realtime just paces the mix to the clock,
+		// so it's for profiling and comparing the pipeline against fmod, not for listening to
+		native = 1
+	};
+
+	enum struct LoadMode : i32 {
+		automatic = 0, // AudioEngineConfig::loadPolicy picks one of the three below, per sound
+		stream = 1, // read and decoded a little at a time as it plays, next to nothing resident. playing it on a second channel opens the file again for that channel
+		compressed = 2, // the file's bytes in memory, decoded as it plays
+		decompressed = 3 // decoded to pcm up front. the most memory, but playing it costs no decoding at all
+	};
+
+	// how LoadMode::automatic decides, plus the buffers every stream gets. sizes are the file's (or pack entry's) on disk.
+	// the checks go in order: long or big files stream, small or hot ones get decompressed, anything else stays compressed
+	struct LoadPolicy {
+		u64 streamAboveBytes = 8 * 1024 * 1024;
+		u32 streamAboveSeconds = 120; // a file's length is only known once it's been loaded, so this kicks in from its second load
+		u64 decompressBelowBytes = 64 * 1024;
+		// a file whose sounds have started this many channels gets decoded up front from its next load on, if it's small enough
+		u32 hotPlays = 16;
+		u64 hotDecompressBelowBytes = 1024 * 1024;
+		// fmod's defaults. a bigger file buffer rides out a slower disk, at that many bytes per playing stream
+		u32 streamFileBufferBytes = 16 * 1024;
+		u32 streamDecodeBufferMs = 400;
+	};
+
+	// plain values only so it can cross the dll boundary without worrying about layouts
+	struct AudioEngineConfig {
+		Backend backend = Backend::fmod; // an engine built with AUDIOENGINE_NATIVE_ONLY (the cmake build) is always native
+		ThreadingMode threading = ThreadingMode::callerThread;
+		u32 commandQueueCapacity = 1024; // rounded up to a power of 2. pushes fail once full
+		u32 maxChannelHandles = 4096; // channels that can be playing or waiting at once (max 65535)
+		// only realVoices channels are actually mixed. the rest of the playing channels are virtual: still positioned and
+		// timed but silent and nearly free, and fmod swaps them in as they become the most important/audible ones.
+		// past virtualVoices playing channels, the least important one gets stolen (it ends like any other channel)
+		u32 realVoices = 32;
+		u32 virtualVoices = 1024; // max 4095
+		f32 virtualVolume = 0.001f; // quieter than this (after distance attenuation) goes virtual even if real voices are free. 0 turns it off
+		// once loaded sounds add up past this many bytes (by getSoundMemoryUsage's estimates), update() unloads the least
+		// recently used ones with nothing playing or waiting on them until they fit again. 0 for no limit
+		u64 soundMemoryBudget = 0;
+		// bytes reserved up front for fmod's allocations and the engine's own small ones (see PoolAllocator), so they stop
+		// going through the system heap. only the first init in a process gets to set it. 0 leaves everything on the heap
+		u64 memoryPoolBytes = 0;
+		// worker threads for fmod's file reads (fmod backend only). each open file gets read readAheadBytes ahead in the
+		// background, so a stream rides out a slow or networked disk instead of starving. 0 keeps fmod's own blocking reads
+		u32 ioThreads = 0;
+		u32 readAheadBytes = 256 * 1024;
+		LoadPolicy loadPolicy{}; // fmod backend only, the native one always decodes up front
+		OutputMode output = OutputMode::realtime; // the nrt modes don't need a sound card, for build/bench machines
+		const char* wavWriterPath = "output.wav"; // only read during init
+	};
+};
@@ -0,0 +1,235 @@
+
+#include "pch.h"
+
+#include "AudioEngineCore.hpp"
+
+#include <filesystem>
+#include <utility>
+
+AudioEngineCore::AudioEngineCore(const Audio::AudioEngineConfig& config) :
+	channels(config.maxChannelHandles),
+	positionBatchCount{0},
+	volumeBatchCount{0},
+	writeSequence{0},
+	nextEffectId{1},
+	soundKeys{},
+	soundNames{},
+	packs{},
+	config(config),
+	commands{},
+	droppedCommands(0),
+	residentSoundBytes{0},
+	useClock{1},
+	loadHistory{},
+	evictionCandidates{},
+	pendingEvents{},
+	wakeRequested{false},
+	sleeping{false}
+{
+	if (this->config.memoryPoolBytes != 0)
+		PoolAllocator::shared().reserve(this->config.memoryPoolBytes);
+	if (this->config.threading == Audio::ThreadingMode::commandQueue)
+		this->commands = std::make_unique<MPSCRing<AudioCommand>>(this->config.commandQueueCapacity);
+}
+
+auto AudioEngineCore::submit(AudioCommand&& command) -> bool {
+	if (!this->isQueued()) {
+		this->execute(command);
+		return true;
+	}
+	if (this->commands->tryPush(std::move(command))) {
+		// pairs with the fence in waitForWork. either it sees this command, or this sees it sleeping
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (this->sleeping.load(std::memory_order_relaxed))
+			this->wake();
+		return true;
+	}
+	this->droppedCommands.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+auto AudioEngineCore::waitForWork(std::chrono::milliseconds timeout) -> void {
+	if (timeout.count() <= 0 || !this->pendingEvents.empty() || !this->deferredLoadCallbacks.empty())
+		return; // events from the last update still need handling, or callbacks the next one should run
+	std::unique_lock<std::mutex> lock(this->wakeLock);
+	this->sleeping.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!this->wakeRequested && (!this->isQueued() || this->commands->empty()))
+		this->wakeSignal.wait_for(lock, timeout, [this]() -> bool { return this->wakeRequested; });
+	this->sleeping.store(false, std::memory_order_relaxed);
+	this->wakeRequested = false;
+}
+
+// the lock makes sure this can't land between waitForWork's check and its wait
+auto AudioEngineCore::wake() -> void {
+	{
+		std::lock_guard<std::mutex> lock(this->wakeLock);
+		this->wakeRequested = true;
+	}
+	this->wakeSignal.notify_one();
+}
+
+auto AudioEngineCore::pollEvent(Audio::PlaybackEvent& out) -> bool {
+	if (this->pendingEvents.empty())
+		return false;
+	out = this->pendingEvents.front();
+	this->pendingEvents.pop_front();
+	return true;
+}
+
+auto AudioEngineCore::publish(Audio::PlaybackEventType type, i32 channelId, SlotKey key) -> void {
+	if (this->pendingEvents.size() >= maxPendingEvents) {
+		this->stats.eventsDropped++;
+		return;
+	}
+	this->pendingEvents.push_back(Audio::PlaybackEvent{ type, channelId, toHandle(key) });
+}
+
+auto AudioEngineCore::deferLoadCallback(std::function<void(bool)>&& callback, bool success) -> void {
+	this->deferredLoadCallbacks.emplace_back(std::move(callback), success);
+}
+
+// swapped out first, anything these defer waits for the next update
+auto AudioEngineCore::runLoadCallbacks() -> void {
+	if (this->deferredLoadCallbacks.empty()) return;
+	auto due = std::move(this->deferredLoadCallbacks);
+	this->deferredLoadCallbacks.clear();
+	for (auto& [callback, success] : due)
+		callback(success);
+}
+
+auto AudioEngineCore::isQueued() const -> bool {
+	return this->commands != nullptr;
+}
+
+auto AudioEngineCore::findSound(const std::string& soundName) -> SlotKey {
+	std::lock_guard<std::mutex> lock(this->soundNamesLock);
+	auto foundIter = this->soundNames.find(soundName);
+	if (foundIter == this->soundNames.end())
+		return SlotKey{};
+	return foundIter->second;
+}
+
+auto AudioEngineCore::registerSound(const std::string& soundName) -> std::pair<SlotKey, bool> {
+	std::lock_guard<std::mutex> lock(this->soundNamesLock);
+	auto foundIter = this->soundNames.find(soundName);
+	if (foundIter != this->soundNames.end())
+		return std::make_pair(foundIter->second, false); // sound by that name already exists
+	SlotKey key = this->soundKeys.acquire();
+	this->soundNames[soundName] = key;
+	return std::make_pair(key, true);
+}
+
+auto AudioEngineCore::forgetSound(const std::string& soundName, SlotKey key) -> void {
+	std::lock_guard<std::mutex> lock(this->soundNamesLock);
+	auto foundIter = this->soundNames.find(soundName);
+	if (foundIter != this->soundNames.end() && foundIter->second == key)
+		this->soundNames.erase(foundIter);
+}
+
+auto AudioEngineCore::mountPack(const std::string& packPath) -> bool {
+	auto pack = std::make_shared<Audio::AssetPack>();
+	if (!pack->open(packPath))
+		return false;
+	std::lock_guard<std::mutex> lock(this->packsLock);
+	this->packs.push_back(std::move(pack));
+	return true;
+}
+
+auto AudioEngineCore::findPacked(const std::string& path) -> PackedFile {
+	std::lock_guard<std::mutex> lock(this->packsLock);
+	for (auto packIter = this->packs.rbegin(); packIter != this->packs.rend(); packIter++) {
+		auto bytes = (*packIter)->find(path);
+		if (!bytes.empty())
+			return PackedFile{ *packIter, bytes };
+	}
+	return PackedFile{};
+}
+
+auto AudioEngineCore::mappedPackBytes() -> u64 {
+	std::lock_guard<std::mutex> lock(this->packsLock);
+	u64 bytes = 0;
+	for (const auto& pack : this->packs)
+		bytes += pack->sizeBytes();
+	return bytes;
+}
+
+auto AudioEngineCore::addPoolStats(Audio::EngineStats& snapshot) -> void {
+	const auto pool = PoolAllocator::shared().getStats();
+	snapshot.poolBytes = pool.arenaBytes;
+	snapshot.poolCarvedBytes = pool.carvedBytes;
+	snapshot.poolUsedBytes = pool.usedBytes;
+	snapshot.poolPeakBytes = pool.peakBytes;
+	snapshot.poolFallbacks = pool.fallbacks;
+	snapshot.poolFragmentation = pool.fragmentation;
+}
+
+auto AudioEngineCore::fileBytesForPolicy(const std::string& path, Audio::LoadMode mode) -> u64 {
+	if (mode != Audio::LoadMode::automatic)
+		return 0;
+	u64 bytes = this->findPacked(path).bytes.size();
+	if (bytes == 0) {
+		std::error_code error;
+		bytes = std::filesystem::file_size(path, error);
+		if (error)
+			bytes = 0; // a url or a missing file. stays compressed like every load used to, the open sorts out the rest
+	}
+	return bytes;
+}
+
+auto AudioEngineCore::chooseLoadMode(const std::string& path, Audio::LoadMode requested, u64 fileBytes) -> Audio::LoadMode {
+	Audio::LoadMode mode = requested;
+	if (mode == Audio::LoadMode::automatic) {
+		const Audio::LoadPolicy& policy = this->config.loadPolicy;
+		auto historyIter = this->loadHistory.find(path);
+		const LoadHistory history = historyIter != this->loadHistory.end() ? historyIter->second : LoadHistory{};
+		if (fileBytes > policy.streamAboveBytes || history.durationMs > static_cast<u64>(policy.streamAboveSeconds) * 1000)
+			mode = Audio::LoadMode::stream;
+		else if (fileBytes != 0 && (fileBytes <= policy.decompressBelowBytes || (history.plays >= policy.hotPlays && fileBytes <= policy.hotDecompressBelowBytes)))
+			mode = Audio::LoadMode::decompressed;
+		else
+			mode = Audio::LoadMode::compressed;
+	}
+	if (mode == Audio::LoadMode::stream)
+		this->stats.streamedLoads++;
+	else if (mode == Audio::LoadMode::compressed)
+		this->stats.compressedLoads++;
+	else
+		this->stats.decompressedLoads++;
+	return mode;
+}
+
+auto AudioEngineCore::elapsedNs(Clock::time_point start) -> u64 {
+	return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+auto AudioEngineCore::drainCommands() -> void {
+	if (!this->isQueued()) return;
+	AudioCommand command;
+	while (this->commands->tryPop(command)) {
+		this->execute(command);
+		command = std::monostate{}; // drop any strings now instead of on the next pop
+	}
+}
+
+auto AudioEngineCore::toHandle(SlotKey key) -> Audio::SoundHandle {
+	return Audio::SoundHandle{ key.index, key.generation };
+}
+
+auto AudioEngineCore::nextBatchStamp(u32& counter) -> u32 {
+	u32 stamp = ++counter;
+	if (stamp == 0) // wrapped
+		stamp = ++counter;
+	return stamp;
+}
+
+auto AudioEngineCore::nextWriteSequence() -> u32 {
+	u32 sequence = this->writeSequence.fetch_add(1, std::memory_order_relaxed) + 1;
+	if (sequence == 0) // wrapped
+		sequence = this->writeSequence.fetch_add(1, std::memory_order_relaxed) + 1;
+	return sequence;
+}
+
+auto AudioEngineCore::isStaleWrite(u32 sequence, u32 newest) -> bool {
+	return newest != 0 && static_cast<i32>(sequence - newest) < 0;
+}
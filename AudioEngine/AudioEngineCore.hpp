@@ -0,0 +1,199 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "Vec.hpp"
+#include "AudioEngine.hpp"
+#include "AudioEngineConfig.hpp"
+#include "AudioCommands.hpp"
+#include "MPSCRing.hpp"
+#include "SlotMap.hpp"
+#include "ChannelTable.hpp"
+#include "PositionBatch.hpp"
+#include "VolumeBatch.hpp"
+#include "SoundInfo.hpp"
+#include "EngineStats.hpp"
+#include "PlaybackEvent.hpp"
+#include "AssetPack.hpp"
+#include "PoolAllocator.hpp"
+
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <span>
+#include <vector>
+#include <unordered_map>
+
+/*
+	the half of an engine implementation that doesn't care what's doing the mixing: the command queue, channel ids,
+	the sound name registry, batches, events and the update thread's sleep. AudioEngine only ever talks to this,
+	and each backend (fmod, native) fills in the virtuals. which one gets built is AudioEngineConfig::backend
+*/
+struct AudioEngineCore {
+	typedef std::chrono::steady_clock Clock;
+	typedef std::unordered_map<std::string, SlotKey> SoundNameMap;
+
+	// what the load policy has seen of a file across loads, so the next load can decide better
+	struct LoadHistory {
+		u64 durationMs = 0; // 0 until it's finished loading once
+		u32 plays = 0; // channels started on sounds from it
+	};
+	static constexpr const size_t maxPendingEvents = 4096; // past this, new events are dropped until someone polls
+	static constexpr const i32 defaultPriority = 128; // fmod's scale, 0 most important to 256 least. native uses it too
+
+	// a channel that starts by crossfading out of another one. Fade{} (all zero) is a plain start
+	struct Fade {
+		i32 fromChannelId;
+		u32 lengthMs;
+	};
+	// a channel asked for with playWhenReady whose sound is still opening
+	struct WaitingPlay {
+		i32 channelId;
+		Audio::Vec3<f32> pos;
+		f32 volumedB;
+		Fade fade; // worked out when it finally starts, the outgoing channel has moved on by then
+	};
+	// one entry of a mounted pack. bytes stay mapped for as long as something holds pack
+	struct PackedFile {
+		std::shared_ptr<const Audio::AssetPack> pack; // null if the path isn't in any mounted pack
+		std::span<const u8> bytes;
+	};
+
+	AudioEngineCore(const Audio::AudioEngineConfig& config);
+	virtual ~AudioEngineCore() = default;
+	AudioEngineCore(const AudioEngineCore&) = delete;
+	void operator=(const AudioEngineCore&) = delete;
+
+	// true if the command was accepted. in callerThread mode it runs immediately
+	auto submit(AudioCommand&& command) -> bool;
+	auto isQueued() const -> bool;
+
+	// the update thread sleeps in waitForWork until a command comes in, wake() is called, or the timeout runs out
+	auto waitForWork(std::chrono::milliseconds timeout) -> void;
+	auto wake() -> void; // any thread
+	auto pollEvent(Audio::PlaybackEvent& out) -> bool; // owner only
+
+	// name registry. safe from any thread, only used by the string conveniences and by loads/unloads
+	auto findSound(const std::string& soundName) -> SlotKey;
+	auto registerSound(const std::string& soundName) -> std::pair<SlotKey, bool>; // (key, newly registered)
+	auto forgetSound(const std::string& soundName, SlotKey key) -> void; // only if the name still points at key
+
+	// mounted packs, any thread. loads look in every pack (newest first) before going to the file system
+	auto mountPack(const std::string& packPath) -> bool;
+	auto findPacked(const std::string& path) -> PackedFile;
+	auto mappedPackBytes() -> u64;
+	static auto addPoolStats(Audio::EngineStats& snapshot) -> void;
+	// any thread. the size chooseLoadMode goes by, 0 if it won't need one (mode isn't automatic) or there's no such file.
+	// a stat can block on a slow or network drive, so the loads call this before they're queued, not on the update thread
+	auto fileBytesForPolicy(const std::string& path, Audio::LoadMode mode) -> u64;
+	// any thread, taken when the write is made rather than when it's applied. never 0, that's what fresh slots start with
+	auto nextWriteSequence() -> u32;
+	// owner only. resolves automatic through config.loadPolicy and path's history, and counts the result in stats
+	auto chooseLoadMode(const std::string& path, Audio::LoadMode requested, u64 fileBytes) -> Audio::LoadMode;
+
+	// everything below is the backend's. only call from the thread that owns the impl
+	virtual auto update() -> void = 0;
+	virtual auto loadSound(SlotKey key, const std::string& path, const std::string& soundName, bool space3d, bool looping, Audio::LoadMode mode, u64 fileBytes) -> bool = 0;
+	virtual auto getStats() -> Audio::EngineStats = 0;
+	virtual auto isVirtual(i32 channelId) -> bool = 0;
+	virtual auto getPlayingSound(i32 channelId) -> std::optional<Audio::SoundInfo> = 0;
+	virtual auto getPlaybackPosition(i32 channelId) -> std::optional<Audio::PlaybackPosition> = 0;
+	virtual auto getSoundInfo(SlotKey key) -> const Audio::SoundInfo* = 0;
+	virtual auto getLoadState(SlotKey key) -> Audio::LoadState = 0;
+	virtual auto getSoundMemoryUsage(SlotKey key) -> u64 = 0;
+	virtual auto getFileStats() -> std::vector<Audio::FileStats> = 0;
+	virtual auto getRenderedTime() -> std::chrono::microseconds = 0;
+	virtual auto unloadSound(SlotKey key) -> void = 0;
+
+	ChannelTable channels; // ids handed out from any thread, the rest is owner only
+	PositionBatch positionBatch; // appended from any thread, applied once per update()
+	u32 positionBatchCount;
+	VolumeBatch volumeBatch; // same, for setChannelVolumes
+	u32 volumeBatchCount;
+	std::atomic<u32> writeSequence; // orders every position/volume write, batched or not, so the newest one wins
+	std::atomic<i32> nextEffectId; // handed out from any thread
+
+	SlotKeyAllocator soundKeys;
+	SoundNameMap soundNames;
+	std::mutex soundNamesLock;
+	std::vector<std::shared_ptr<const Audio::AssetPack>> packs; // mount order. sounds opened from one hold it too
+	std::mutex packsLock;
+
+	Audio::AudioEngineConfig config;
+	std::unique_ptr<MPSCRing<AudioCommand>> commands; // only exists in commandQueue mode
+	std::atomic<u64> droppedCommands; // pushes rejected because the ring was full
+	Audio::EngineStats stats; // counters and histograms, owner thread only. the rest of a snapshot is filled in by getStats
+	u64 residentSoundBytes; // memoryBytes summed over ready sounds, the backends add and take away as they load and unload
+	u64 useClock; // what a sound's lastUsed gets set to when it loads or plays. moves on once per update()
+	// by path, owner only. one small entry per file ever loaded, and nodes don't move, so sounds can keep a pointer to theirs
+	std::unordered_map<std::string, LoadHistory> loadHistory;
+
+protected:
+	static auto elapsedNs(Clock::time_point start) -> u64;
+	static auto toHandle(SlotKey key) -> Audio::SoundHandle;
+	auto publish(Audio::PlaybackEventType type, i32 channelId, SlotKey key) -> void;
+	auto nextBatchStamp(u32& counter) -> u32; // never 0, that's what fresh slots start with
+	// whether a write taken at sequence is older than the newest one that already landed on the channel. compared as a
+	// difference so it survives the counter wrapping
+	static auto isStaleWrite(u32 sequence, u32 newest) -> bool;
+	auto drainCommands() -> void;
+	// onLoaded callbacks that come due outside an update(), e.g. straight from the caller's own call in callerThread
+	// mode. the backends run them from update() with runLoadCallbacks, so onLoaded never re-enters its caller
+	auto deferLoadCallback(std::function<void(bool)>&& callback, bool success) -> void;
+	auto runLoadCallbacks() -> void;
+	virtual auto execute(AudioCommand& command) -> void = 0;
+
+	/*
+		the end of each update(). while resident bytes are over config.soundMemoryBudget, the ready sound that's gone
+		longest without loading, playing or having a live channel is unloaded (soundEvicted comes out first).
+		anything loaded or played since the last pass is left alone, so a sound can't be evicted before its caller
+		gets to play it. SoundMap's entries need ready, memoryBytes and lastUsed
+	*/
+	template<typename SoundMap>
+	auto enforceMemoryBudget(SoundMap& sounds) -> void {
+		const u64 budget = this->config.soundMemoryBudget;
+		if (budget != 0 && this->residentSoundBytes > budget) {
+			this->channels.forEachActive([this, &sounds](ChannelTable::Slot& slot) -> void {
+				if (auto* loaded = sounds.get(slot.sound))
+					loaded->lastUsed = this->useClock;
+			});
+			this->evictionCandidates.clear();
+			sounds.forEach([this](SlotKey key, auto& loaded) -> void {
+				if (loaded.ready && loaded.lastUsed != this->useClock)
+					this->evictionCandidates.push_back(EvictionCandidate{ loaded.lastUsed, key });
+			});
+			std::sort(this->evictionCandidates.begin(), this->evictionCandidates.end(), [](const EvictionCandidate& a, const EvictionCandidate& b) {
+				return a.lastUsed < b.lastUsed;
+			});
+			for (const auto& candidate : this->evictionCandidates) {
+				if (this->residentSoundBytes <= budget)
+					break;
+				this->stats.soundsEvicted++;
+				this->publish(Audio::PlaybackEventType::soundEvicted, 0, candidate.key);
+				this->unloadSound(candidate.key);
+			}
+		}
+		this->useClock++;
+	}
+
+private:
+	struct EvictionCandidate {
+		u64 lastUsed;
+		SlotKey key;
+	};
+
+	std::vector<EvictionCandidate> evictionCandidates; // scratch for enforceMemoryBudget
+	std::deque<Audio::PlaybackEvent, PoolStlAllocator<Audio::PlaybackEvent>> pendingEvents; // owner only, oldest at the front
+	std::vector<std::pair<std::function<void(bool)>, bool>> deferredLoadCallbacks; // owner only, (onLoaded, success)
+	std::mutex wakeLock;
+	std::condition_variable wakeSignal;
+	bool wakeRequested; // guarded by wakeLock
+	std::atomic<bool> sleeping; // lets submit skip the lock when nobody's waiting
+};
@@ -4,41 +4,879 @@
 #include "AudioEngineFMODImpl.hpp"
 
 #include <vector>
+#include <cstring>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <type_traits>
 
-AudioEngineFMODImpl::AudioEngineFMODImpl() : nextChannelId(1) {
-	assert(FMOD::System_Create(&this->system) == FMOD_OK);
-	assert(this->system->init(32, FMOD_INIT_NORMAL, nullptr) == FMOD_OK);
-	assert(this->system->createChannelGroup("main", &this->channelGroup) == FMOD_OK);
+namespace {
+	// fmod wants everything 16 byte aligned, which the pool is
+	auto F_CALL poolAlloc(unsigned int size, FMOD_MEMORY_TYPE, const char*) -> void* {
+		return PoolAllocator::shared().allocate(size);
+	}
+	auto F_CALL poolRealloc(void* block, unsigned int size, FMOD_MEMORY_TYPE, const char*) -> void* {
+		return PoolAllocator::shared().reallocate(block, size);
+	}
+	auto F_CALL poolFree(void* block, FMOD_MEMORY_TYPE, const char*) -> void {
+		PoolAllocator::shared().deallocate(block);
+	}
+};
+
+auto Vec3ToFMODVec(const Audio::Vec3<f32>& in) -> FMOD_VECTOR {
+	return FMOD_VECTOR{ in.x, in.y, in.z };
+}
+
+// same three floats, so batches (kept as Vec3 so the shared code doesn't need fmod) go to fmod without a copy
+static_assert(sizeof(Audio::Vec3<f32>) == sizeof(FMOD_VECTOR) && std::is_standard_layout_v<Audio::Vec3<f32>>);
+
+auto toFMODVec(const Audio::Vec3<f32>* in) -> const FMOD_VECTOR* {
+	return reinterpret_cast<const FMOD_VECTOR*>(in);
+}
+
+AudioEngineFMODImpl::AudioEngineFMODImpl(const Audio::AudioEngineConfig& config) :
+	AudioEngineCore(config),
+	retiredChannels{},
+	channelHandles(channels.getCapacity(), nullptr),
+	channelStreams(channels.getCapacity()),
+	fileReader{},
+	effects{}
+{
+	// has to come before fmod allocates anything. it refuses once a system exists (SoundMetadata's, or an earlier
+	// init's still around), and then just keeps its own heap, so there's no mixing of blocks between the two
+	if (this->config.memoryPoolBytes != 0)
+		FMOD::Memory_Initialize(nullptr, 0, poolAlloc, poolRealloc, poolFree);
+	FMOD_RESULT createResult = FMOD::System_Create(&this->system);
+	assert(createResult == FMOD_OK);
+	if (this->config.ioThreads != 0)
+		this->fileReader = std::make_unique<AsyncFileReader>(this->config.ioThreads, this->config.readAheadBytes);
+	FMOD_INITFLAGS initFlags = FMOD_INIT_NORMAL;
+	void* outputData = nullptr;
+	if (this->config.output != Audio::OutputMode::realtime) {
+		bool wavWriter = this->config.output == Audio::OutputMode::wavWriterNRT;
+		FMOD_RESULT outputResult = this->system->setOutput(wavWriter ? FMOD_OUTPUTTYPE_WAVWRITER_NRT : FMOD_OUTPUTTYPE_NOSOUND_NRT);
+		assert(outputResult == FMOD_OK);
+		if (wavWriter)
+			outputData = const_cast<char*>(this->config.wavWriterPath); // the wav writer takes its file name here
+		// mixing runs as fast as update() is called, so streams have to be fed from update() too or they fall behind
+		initFlags |= FMOD_INIT_STREAM_FROM_UPDATE;
+	}
+	FMOD_RESULT voicesResult = this->system->setSoftwareChannels(static_cast<i32>(this->config.realVoices));
+	assert(voicesResult == FMOD_OK);
+	FMOD_RESULT bufferResult = this->system->setStreamBufferSize(this->config.loadPolicy.streamFileBufferBytes, FMOD_TIMEUNIT_RAWBYTES);
+	assert(bufferResult == FMOD_OK);
+	FMOD_ADVANCEDSETTINGS advanced{};
+	advanced.cbSize = sizeof(FMOD_ADVANCEDSETTINGS);
+	advanced.defaultDecodeBufferSize = this->config.loadPolicy.streamDecodeBufferMs;
+	if (this->config.virtualVolume > 0.0f) {
+		advanced.vol0virtualvol = this->config.virtualVolume;
+		initFlags |= FMOD_INIT_VOL0_BECOMES_VIRTUAL;
+	}
+	FMOD_RESULT advancedResult = this->system->setAdvancedSettings(&advanced);
+	assert(advancedResult == FMOD_OK);
+	const i32 virtualVoices = static_cast<i32>(std::min(this->config.virtualVoices, 4095u));
+	FMOD_RESULT initResult = this->system->init(virtualVoices, initFlags, outputData);
+	assert(initResult == FMOD_OK);
+	FMOD_RESULT groupResult = this->system->createChannelGroup("main", &this->channelGroup);
+	assert(groupResult == FMOD_OK);
 
 	this->system->set3DNumListeners(1);
+	this->system->setUserData(this); // so the channel callback can find its way back here
+
+	this->retiredChannels.reserve(this->channels.getCapacity()); // never more ends per tick than channels
 }
 
 AudioEngineFMODImpl::~AudioEngineFMODImpl() {
-	for (auto& channel : this->channels) {
-		channel.second->stop();
-	}
-	this->channels.clear(); // these seem to not need to be released. I think the channels might just be ids for internal
+	this->channels.forEachActive([this](ChannelTable::Slot& slot) -> void {
+		if (FMOD::Channel* channel = this->channelOf(slot))
+			channel->stop();
+	}); // these seem to not need to be released. I think the channels might just be ids for internal
 	// structures inside the system, so i think the system release handles it
-	for (auto& sound : this->sounds) {
-		sound.second->release();
-	}
+	for (auto& [effectId, effect] : this->effects)
+		this->releaseEffect(effect); // units have to stay alive until the mixer is off them
+	this->effects.clear();
+	this->sounds.forEach([](SlotKey, LoadedSound& loaded) -> void {
+		loaded.sound->release(); // blocks until fmod's loader thread lets go of it if it's still opening
+	});
 	this->sounds.clear();
+	this->pendingLoads.clear();
+	this->soundNames.clear();
 	this->channelGroup->release();
 	this->system->release();
 }
 
 auto AudioEngineFMODImpl::update() -> void {
-	std::vector<ChannelMap::iterator> stoppedChannels;
-	for (auto iter = this->channels.begin(), iterEnd = this->channels.end(); iter != iterEnd; iter++) {
-		bool isPlaying = false;
-		iter->second->isPlaying(&isPlaying);
-		if (!isPlaying) {
-			stoppedChannels.push_back(iter);
+	auto start = Clock::now();
+	this->drainCommands();
+	this->pollPendingLoads();
+	this->runLoadCallbacks();
+	this->applyPositionBatch(); // after the commands, so channels started this tick get moved too
+	this->applyVolumeBatch();
+	this->system->update(); // end callbacks fire in here
+	this->retireChannels();
+	this->dropFinishedEffects();
+	this->enforceMemoryBudget(this->sounds);
+	this->stats.update.record(elapsedNs(start));
+}
+
+auto AudioEngineFMODImpl::isVirtual(i32 channelId) -> bool {
+	auto* slot = this->channels.find(channelId);
+	FMOD::Channel* channel = slot ? this->channelOf(*slot) : nullptr;
+	if (!channel)
+		return false;
+	bool isVirtual = false;
+	channel->isVirtual(&isVirtual);
+	return isVirtual;
+}
+
+auto AudioEngineFMODImpl::getPlayingSound(i32 channelId) -> std::optional<Audio::SoundInfo> {
+	auto* slot = this->channels.find(channelId);
+	FMOD::Channel* channel = slot ? this->channelOf(*slot) : nullptr;
+	if (channel) {
+		FMOD::Sound* sound = nullptr;
+		channel->getCurrentSound(&sound);
+		if (sound) {
+			return std::optional<Audio::SoundInfo>(std::in_place, sound, channel);
 		}
 	}
-	for (auto& channel : stoppedChannels) {
-		this->channels.erase(channel);
+	return std::optional<Audio::SoundInfo>{};
+}
+
+auto AudioEngineFMODImpl::getPlaybackPosition(i32 channelId) -> std::optional<Audio::PlaybackPosition> {
+	const auto* slot = this->channels.find(channelId);
+	if (!slot)
+		return std::nullopt;
+	Audio::PlaybackPosition playback{ toHandle(slot->sound), std::chrono::milliseconds::zero(), std::chrono::milliseconds::zero() };
+	if (FMOD::Channel* channel = this->channelOf(*slot)) { // still zero while waiting on a load
+		u32 position = 0;
+		channel->getPosition(&position, FMOD_TIMEUNIT_MS);
+		playback.position = std::chrono::milliseconds(position);
+	}
+	const auto* loaded = this->sounds.get(slot->sound);
+	if (loaded && loaded->info)
+		playback.duration = loaded->info->getDuration();
+	return playback;
+}
+
+auto AudioEngineFMODImpl::getSoundInfo(SlotKey key) -> const Audio::SoundInfo* {
+	const auto* loaded = this->sounds.get(key);
+	if (!loaded)
+		return nullptr;
+	return loaded->info.get();
+}
+
+auto AudioEngineFMODImpl::getLoadState(SlotKey key) -> Audio::LoadState {
+	const auto* loaded = this->sounds.get(key);
+	if (!loaded)
+		return Audio::LoadState::notLoaded;
+	return loaded->ready ? Audio::LoadState::loaded : Audio::LoadState::loading;
+}
+
+auto AudioEngineFMODImpl::getSoundMemoryUsage(SlotKey key) -> u64 {
+	const auto* loaded = this->sounds.get(key);
+	if (!loaded || !loaded->ready)
+		return 0;
+	return loaded->memoryBytes;
+}
+
+auto AudioEngineFMODImpl::getRenderedTime() -> std::chrono::microseconds {
+	unsigned long long clock = 0;
+	i32 sampleRate = 0;
+	this->channelGroup->getDSPClock(&clock, nullptr); // in output samples
+	this->system->getSoftwareFormat(&sampleRate, nullptr, nullptr);
+	if (sampleRate <= 0)
+		return std::chrono::microseconds::zero();
+	return std::chrono::microseconds(clock * 1000000 / static_cast<u64>(sampleRate));
+}
+
+auto AudioEngineFMODImpl::getStats() -> Audio::EngineStats {
+	Audio::EngineStats snapshot = this->stats;
+	snapshot.commandsDropped = this->droppedCommands.load(std::memory_order_relaxed);
+	snapshot.soundsLoaded = static_cast<u32>(this->sounds.size());
+	snapshot.channelsActive = this->channels.activeCount();
+	i32 playing = 0, real = 0;
+	this->system->getChannelsPlaying(&playing, &real);
+	snapshot.channelsReal = real;
+	snapshot.channelsVirtual = playing - real;
+	FMOD_CPU_USAGE usage{};
+	this->system->getCPUUsage(&usage);
+	snapshot.cpuDsp = usage.dsp;
+	snapshot.cpuStream = usage.stream;
+	snapshot.cpuUpdate = usage.update;
+	snapshot.cpuGeometry = usage.geometry;
+	snapshot.soundMemoryBytes = this->residentSoundBytes;
+	snapshot.mappedPackBytes = this->mappedPackBytes();
+	addPoolStats(snapshot);
+	if (this->fileReader)
+		this->fileReader->addStats(snapshot);
+	FMOD::Memory_GetStats(&snapshot.fmodMemoryBytes, &snapshot.fmodMemoryPeakBytes, false); // non blocking, might be a hair stale
+	return snapshot;
+}
+
+auto AudioEngineFMODImpl::getFileStats() -> std::vector<Audio::FileStats> {
+	if (!this->fileReader)
+		return {};
+	return this->fileReader->getFileStats();
+}
+
+auto AudioEngineFMODImpl::loadSound(SlotKey key, const std::string& path, const std::string& soundName, bool space3d, bool looping, Audio::LoadMode mode, u64 fileBytes) -> bool {
+	std::shared_ptr<const Audio::AssetPack> pack;
+	auto start = Clock::now();
+	FMOD::Sound* sound = this->createSound(path, buildMode(space3d, looping, this->chooseLoadMode(path, mode, fileBytes)), pack);
+	this->stats.loadSound.record(elapsedNs(start));
+	if (sound) {
+		LoadedSound& loaded = this->sounds.insert(key, LoadedSound{ sound, soundName, true });
+		loaded.pack = std::move(pack);
+		loaded.memoryBytes = estimateSoundMemory(sound, loaded.pack != nullptr);
+		loaded.lastUsed = this->useClock;
+		this->residentSoundBytes += loaded.memoryBytes;
+		loaded.info = std::make_unique<Audio::SoundInfo>(sound);
+		loaded.history = &this->loadHistory[path];
+		loaded.path = path;
+		loaded.history->durationMs = static_cast<u64>(loaded.info->getDuration().count());
+		this->publish(Audio::PlaybackEventType::soundLoaded, 0, key);
+		return true; // success in creating new sound
 	}
-	this->system->update();
+	this->stats.loadsFailed++;
+	this->publish(Audio::PlaybackEventType::loadFailed, 0, key);
+	this->forgetSound(soundName, key);
+	this->soundKeys.release(key);
+	return false; // failed to create new sound
 }
+
+auto AudioEngineFMODImpl::loadSoundAsync(SlotKey key, const std::string& path, const std::string& soundName, bool space3d, bool looping, Audio::LoadMode mode, u64 fileBytes, std::function<void(bool)>&& onLoaded) -> void {
+	std::shared_ptr<const Audio::AssetPack> pack;
+	FMOD::Sound* sound = this->createSound(path, buildMode(space3d, looping, this->chooseLoadMode(path, mode, fileBytes)) | FMOD_NONBLOCKING, pack);
+	if (!sound) { // fmod can reject it up front (bad args, out of memory), the open itself fails later
+		this->stats.loadsFailed++;
+		this->publish(Audio::PlaybackEventType::loadFailed, 0, key);
+		this->forgetSound(soundName, key);
+		this->soundKeys.release(key);
+		if (onLoaded)
+			this->deferLoadCallback(std::move(onLoaded), false);
+		return;
+	}
+	LoadedSound& loaded = this->sounds.insert(key, LoadedSound{ sound, soundName, false });
+	loaded.pack = std::move(pack); // fmod's loader thread reads from it until the open finishes
+	loaded.requested = Clock::now();
+	loaded.history = &this->loadHistory[path];
+	loaded.path = path;
+	if (onLoaded)
+		loaded.callbacks.push_back(std::move(onLoaded));
+	this->pendingLoads.push_back(key);
+}
+
+auto AudioEngineFMODImpl::awaitLoad(SlotKey key, std::function<void(bool)>&& onLoaded) -> void {
+	LoadedSound* loaded = this->sounds.get(key);
+	if (!loaded)
+		this->deferLoadCallback(std::move(onLoaded), false); // failed or unloaded before we got here
+	else if (loaded->ready)
+		this->deferLoadCallback(std::move(onLoaded), true);
+	else
+		loaded->callbacks.push_back(std::move(onLoaded));
+}
+
+auto AudioEngineFMODImpl::unloadSound(SlotKey key) -> void {
+	LoadedSound* loaded = this->sounds.get(key);
+	if (!loaded) return;
+	auto callbacks = std::move(loaded->callbacks); // only non-empty if it was still loading
+	for (auto& waiting : loaded->waitingPlays) {
+		this->channels.release(waiting.channelId);
+		this->publish(Audio::PlaybackEventType::channelEnded, waiting.channelId, key);
+	}
+	if (!loaded->ready)
+		std::erase(this->pendingLoads, key);
+	else
+		this->residentSoundBytes -= loaded->memoryBytes;
+	// releasing the sound stops everything playing it, except channels on a stream of their own
+	this->channels.forEachActive([this, key](ChannelTable::Slot& slot) -> void {
+		if (slot.state == ChannelTable::State::playing && slot.sound == key && this->channelStreams[static_cast<u32>(slot.channelId) & 0xFFFF].sound)
+			this->channelOf(slot)->stop();
+	});
+	loaded->sound->release();
+	this->forgetSound(loaded->name, key);
+	this->sounds.erase(key);
+	this->soundKeys.release(key);
+	for (auto& callback : callbacks) // unload can come straight from the caller, so not from in here
+		this->deferLoadCallback(std::move(callback), false);
+}
+
+auto AudioEngineFMODImpl::set3dListenerAndOrientation(const Audio::Vec3<f32>& pos, const Audio::Vec3<f32>& look, const Audio::Vec3<f32>& up) -> void {
+	FMOD_VECTOR position = Vec3ToFMODVec(pos);
+	FMOD_VECTOR looking = Vec3ToFMODVec(look);
+	FMOD_VECTOR upward = Vec3ToFMODVec(up);
+	this->system->set3DListenerAttributes(0, &position, nullptr, &looking, &upward);
+}
+
+auto AudioEngineFMODImpl::playSound(i32 channelId, SlotKey key, const Audio::Vec3<f32>& pos, f32 volumedB) -> void {
+	LoadedSound* loaded = this->sounds.get(key);
+	if (!loaded || !loaded->ready) {
+		this->stats.playsFailed++;
+		this->channels.abandonId(channelId); // this is a failure case, but caller already has a valid channel id anyway. never claimed, so it just goes back
+		this->publish(Audio::PlaybackEventType::playFailed, channelId, key);
+		return;
+	}
+	this->startChannel(channelId, key, *loaded, pos, volumedB);
+}
+
+auto AudioEngineFMODImpl::playWhenReady(i32 channelId, SlotKey key, const Audio::Vec3<f32>& pos, f32 volumedB, const Fade& fade) -> void {
+	LoadedSound* loaded = this->sounds.get(key);
+	if (!loaded) {
+		this->stats.playsFailed++;
+		this->channels.abandonId(channelId); // unlike a blocking load, there's nothing to fall back on
+		this->publish(Audio::PlaybackEventType::playFailed, channelId, key);
+		return;
+	}
+	if (loaded->ready) {
+		this->startChannel(channelId, key, *loaded, pos, volumedB, fade);
+		return;
+	}
+	ChannelTable::Slot* slot = this->channels.claim(channelId);
+	if (!slot) return;
+	this->channelOf(*slot) = nullptr; // whatever last played in the slot. startChannel fills it in
+	slot->sound = key;
+	this->channels.setState(*slot, ChannelTable::State::waiting);
+	loaded->waitingPlays.push_back(WaitingPlay{ channelId, pos, volumedB, fade });
+}
+
+auto AudioEngineFMODImpl::stopChannel(i32 channelId) -> void {
+	ChannelTable::Slot* slot = this->channels.find(channelId);
+	if (!slot) return;
+	if (slot->state == ChannelTable::State::waiting) { // hasn't started yet, just forget about it
+		LoadedSound* loaded = this->sounds.get(slot->sound);
+		if (loaded) {
+			std::erase_if(loaded->waitingPlays, [channelId](const WaitingPlay& w) {
+				return w.channelId == channelId;
+			});
+		}
+		this->publish(Audio::PlaybackEventType::channelEnded, channelId, slot->sound);
+		this->channels.release(channelId);
+		return;
+	}
+	this->channelOf(*slot)->stop(); // the end callback retires it
+}
+
+auto AudioEngineFMODImpl::stopAllChannels() -> void {
+	std::vector<i32> waiting;
+	this->channels.forEachActive([this, &waiting](ChannelTable::Slot& slot) -> void {
+		if (slot.state == ChannelTable::State::waiting) {
+			LoadedSound* loaded = this->sounds.get(slot.sound);
+			if (loaded)
+				loaded->waitingPlays.clear();
+			this->publish(Audio::PlaybackEventType::channelEnded, slot.channelId, slot.sound);
+			waiting.push_back(slot.channelId);
+		}
+		else
+			this->channelOf(slot)->stop();
+	});
+	for (auto channelId : waiting)
+		this->channels.release(channelId);
+}
+
+auto AudioEngineFMODImpl::setChannel3dPosition(i32 channelId, const Audio::Vec3<f32>& pos, u32 sequence) -> void {
+	ChannelTable::Slot* slot = this->channels.find(channelId);
+	FMOD::Channel* channel = slot ? this->channelOf(*slot) : nullptr;
+	if (!channel) return;
+	slot->positionWrite = sequence;
+	FMOD_VECTOR position = Vec3ToFMODVec(pos);
+	channel->set3DAttributes(&position, nullptr);
+}
+
+auto AudioEngineFMODImpl::setChannelVolume(i32 channelId, f32 volumedB, u32 sequence) -> void {
+	ChannelTable::Slot* slot = this->channels.find(channelId);
+	FMOD::Channel* channel = slot ? this->channelOf(*slot) : nullptr;
+	if (!channel) return;
+	slot->volumeWrite = sequence;
+	channel->setVolume(Audio::dBToVolume(volumedB));
+}
+
+auto AudioEngineFMODImpl::setSoundPriority(SlotKey key, i32 priority) -> void {
+	LoadedSound* loaded = this->sounds.get(key);
+	if (!loaded) return;
+	loaded->priority = std::clamp(priority, 0, 256);
+	this->channels.forEachActive([this, key, loaded](ChannelTable::Slot& slot) -> void {
+		FMOD::Channel* channel = this->channelOf(slot);
+		if (channel && slot.sound == key) // waiting ones pick it up when they start
+			channel->setPriority(loaded->priority);
+	});
+}
+
+auto AudioEngineFMODImpl::addEffect(i32 effectId, std::shared_ptr<Audio::DspUnit>&& unit, i32 channelId) -> void {
+	ChannelTable::Slot* slot = nullptr;
+	if (channelId != 0) {
+		slot = this->channels.find(channelId);
+		if (!slot) return; // already over, the unit just gets dropped
+	}
+	i32 sampleRate = 0;
+	u32 blockFrames = 0;
+	this->system->getSoftwareFormat(&sampleRate, nullptr, nullptr);
+	this->system->getDSPBufferSize(&blockFrames, nullptr);
+	blockFrames = std::max(blockFrames, 256u);
+	unit->prepare(static_cast<u32>(sampleRate), blockFrames); // before fmod can see it, so this is the only thread touching it
+
+	Effect& effect = this->effects[effectId];
+	effect.unit = std::move(unit);
+	effect.channelId = channelId;
+	effect.maxFrames = blockFrames;
+	FMOD_DSP_DESCRIPTION description{};
+	description.pluginsdkversion = FMOD_PLUGIN_SDK_VERSION;
+	std::strncpy(description.name, "AudioEngine DspUnit", sizeof(description.name) - 1);
+	description.numinputbuffers = 1;
+	description.numoutputbuffers = 1;
+	description.create = &AudioEngineFMODImpl::effectCreate;
+	description.read = &AudioEngineFMODImpl::effectRead;
+	description.shouldiprocess = &AudioEngineFMODImpl::effectShouldProcess;
+	description.userdata = &effect; // map nodes don't move, so this stays good for the effect's whole life
+	if (this->system->createDSP(&description, &effect.dsp) != FMOD_OK || !effect.dsp) {
+		this->effects.erase(effectId);
+		return;
+	}
+	// dsp head is the output end of the chain, so each new one runs after the ones before it, post fader
+	if (!slot)
+		effect.attached = this->channelGroup->addDSP(FMOD_CHANNELCONTROL_DSP_HEAD, effect.dsp) == FMOD_OK;
+	else if (FMOD::Channel* channel = this->channelOf(*slot))
+		effect.attached = channel->addDSP(FMOD_CHANNELCONTROL_DSP_HEAD, effect.dsp) == FMOD_OK;
+	// still waiting on its load, startChannel attaches it
+}
+
+auto AudioEngineFMODImpl::removeEffect(i32 effectId) -> void {
+	auto found = this->effects.find(effectId);
+	if (found == this->effects.end()) return;
+	this->releaseEffect(found->second);
+	this->effects.erase(found);
+}
+
+auto AudioEngineFMODImpl::attachEffects(i32 channelId, FMOD::Channel* channel) -> void {
+	for (auto& [effectId, effect] : this->effects) {
+		if (effect.channelId == channelId && !effect.attached)
+			effect.attached = channel->addDSP(FMOD_CHANNELCONTROL_DSP_HEAD, effect.dsp) == FMOD_OK;
+	}
+}
+
+// release blocks until the mixer isn't inside the dsp, after that the unit is ours again
+auto AudioEngineFMODImpl::releaseEffect(Effect& effect) -> void {
+	if (effect.attached) {
+		if (effect.channelId == 0)
+			this->channelGroup->removeDSP(effect.dsp);
+		else if (ChannelTable::Slot* slot = this->channels.find(effect.channelId); slot && this->channelOf(*slot))
+			this->channelOf(*slot)->removeDSP(effect.dsp);
+	}
+	effect.dsp->disconnectAll(true, true); // covers a channel that ended on its own
+	effect.dsp->release();
+	effect.dsp = nullptr;
+}
+
+// channel effects go away with their channel, whether it ended, was stopped, or never got to start
+auto AudioEngineFMODImpl::dropFinishedEffects() -> void {
+	if (this->effects.empty()) return;
+	for (auto it = this->effects.begin(); it != this->effects.end();) {
+		Effect& effect = it->second;
+		if (effect.channelId == 0 || this->channels.find(effect.channelId)) {
+			++it;
+			continue;
+		}
+		this->releaseEffect(effect);
+		it = this->effects.erase(it);
+	}
+}
+
+FMOD_RESULT F_CALLBACK AudioEngineFMODImpl::effectCreate(FMOD_DSP_STATE* state) {
+	return state->functions->getuserdata(state, &state->plugindata); // the Effect, from the description
+}
+
+FMOD_RESULT F_CALLBACK AudioEngineFMODImpl::effectRead(FMOD_DSP_STATE* state, float* inBuffer, float* outBuffer, unsigned int length, int inChannels, int* outChannels) {
+	*outChannels = inChannels;
+	const Effect* effect = static_cast<const Effect*>(state->plugindata);
+	if (!effect || inChannels > Audio::DspUnit::maxChannels) {
+		std::memcpy(outBuffer, inBuffer, static_cast<size_t>(length) * inChannels * sizeof(float));
+		return FMOD_OK;
+	}
+	for (u32 done = 0; done < length;) { // blocks are normally exactly maxFrames, this is just in case
+		u32 frames = std::min(length - done, effect->maxFrames);
+		size_t offset = static_cast<size_t>(done) * inChannels;
+		effect->unit->process(inBuffer + offset, outBuffer + offset, frames, inChannels);
+		done += frames;
+	}
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALLBACK AudioEngineFMODImpl::effectShouldProcess(FMOD_DSP_STATE* state, FMOD_BOOL inputsIdle, unsigned int length, FMOD_CHANNELMASK inMask, FMOD_SPEAKERMODE inSpeakerMode) {
+	return inputsIdle ? FMOD_ERR_DSP_DONTPROCESS : FMOD_OK; // nothing playing, nothing to do
+}
+
+/*
+	fmod 2 dropped Sound::getMemoryInfo so this works it out from the open mode instead.
+	compressed samples keep the file bytes, samples keep decoded pcm, and streams only hold
+	a file buffer plus a decode buffer (sized by config.loadPolicy).
+	mapped sounds read their file bytes out of a pack, so those aren't ours to count
+*/
+auto AudioEngineFMODImpl::estimateSoundMemory(FMOD::Sound* sound, bool mapped) const -> u64 {
+	const u64 streamFileBuffer = this->config.loadPolicy.streamFileBufferBytes;
+	const u64 decodeBufferMs = this->config.loadPolicy.streamDecodeBufferMs;
+	FMOD_MODE mode = FMOD_DEFAULT;
+	sound->getMode(&mode);
+	u32 bytes = 0;
+	if (mode & FMOD_CREATESTREAM) {
+		f32 frequency = 0;
+		i32 channels = 0, bits = 0;
+		sound->getDefaults(&frequency, nullptr);
+		sound->getFormat(nullptr, nullptr, &channels, &bits);
+		u64 bytesPerSecond = static_cast<u64>(frequency) * channels * (bits / 8);
+		return (mapped ? 0 : streamFileBuffer) + bytesPerSecond * decodeBufferMs / 1000;
+	}
+	if (mode & FMOD_CREATECOMPRESSEDSAMPLE) {
+		if (mapped)
+			return 0;
+		sound->getLength(&bytes, FMOD_TIMEUNIT_RAWBYTES);
+	}
+	else
+		sound->getLength(&bytes, FMOD_TIMEUNIT_PCMBYTES);
+	return bytes;
+}
+
+auto AudioEngineFMODImpl::buildMode(bool space3d, bool looping, Audio::LoadMode loadMode) -> FMOD_MODE {
+	FMOD_MODE mode = FMOD_DEFAULT;
+	mode |= space3d ? FMOD_3D : FMOD_2D;
+	mode |= looping ? FMOD_LOOP_NORMAL : FMOD_LOOP_OFF;
+	if (loadMode == Audio::LoadMode::stream)
+		mode |= FMOD_CREATESTREAM;
+	else if (loadMode == Audio::LoadMode::decompressed)
+		mode |= FMOD_CREATESAMPLE;
+	else
+		mode |= FMOD_CREATECOMPRESSEDSAMPLE;
+	return mode;
+}
+
+// out of a mounted pack if path is one of its entries. fmod is pointed at the mapped bytes rather than copying them,
+// so pack has to outlive the sound
+auto AudioEngineFMODImpl::createSound(const std::string& path, FMOD_MODE mode, std::shared_ptr<const Audio::AssetPack>& pack) -> FMOD::Sound* {
+	FMOD::Sound* sound = nullptr;
+	PackedFile packed = this->findPacked(path);
+	if (!packed.pack || packed.bytes.size() > std::numeric_limits<u32>::max()) { // exinfo lengths are 32 bit
+		if (!this->fileReader) {
+			this->system->createSound(path.c_str(), mode, nullptr, &sound);
+			return sound;
+		}
+		FMOD_CREATESOUNDEXINFO info{};
+		info.cbsize = sizeof(info);
+		this->fileReader->attach(info);
+		this->system->createSound(path.c_str(), mode, &info, &sound);
+		return sound;
+	}
+	FMOD_CREATESOUNDEXINFO info{};
+	info.cbsize = sizeof(info);
+	info.length = static_cast<u32>(packed.bytes.size());
+	// fmod can only point at bytes it decodes as it plays. decoding up front goes through its own copy, but a nonblocking
+	// open might not have made that copy yet, so the pack is held either way
+	const bool decodeUpFront = !(mode & (FMOD_CREATESTREAM | FMOD_CREATECOMPRESSEDSAMPLE));
+	this->system->createSound(reinterpret_cast<const char*>(packed.bytes.data()), mode | (decodeUpFront ? FMOD_OPENMEMORY : FMOD_OPENMEMORY_POINT), &info, &sound);
+	if (sound)
+		pack = std::move(packed.pack);
+	return sound;
+}
+
+auto AudioEngineFMODImpl::finishLoad(SlotKey key, bool loaded) -> void {
+	LoadedSound* sound = this->sounds.get(key);
+	if (!sound) return;
+	// moved out first: starting one can stop another that's waiting on this same sound (a crossfade into itself), and
+	// stopChannel erases from the list
+	auto waitingPlays = std::move(sound->waitingPlays);
+	sound->waitingPlays.clear();
+	for (auto& waiting : waitingPlays) {
+		if (!this->channels.find(waiting.channelId)) continue; // stopped by one started before it
+		if (loaded)
+			this->startChannel(waiting.channelId, key, *sound, waiting.pos, waiting.volumedB, waiting.fade);
+		else {
+			this->channels.release(waiting.channelId);
+			this->publish(Audio::PlaybackEventType::playFailed, waiting.channelId, key);
+		}
+	}
+	auto callbacks = std::move(sound->callbacks);
+	this->stats.loadSound.record(elapsedNs(sound->requested)); // only as precise as how often update() polls
+	this->publish(loaded ? Audio::PlaybackEventType::soundLoaded : Audio::PlaybackEventType::loadFailed, 0, key);
+	if (loaded) {
+		sound->ready = true;
+		sound->memoryBytes = estimateSoundMemory(sound->sound, sound->pack != nullptr);
+		sound->lastUsed = this->useClock;
+		this->residentSoundBytes += sound->memoryBytes;
+		sound->info = std::make_unique<Audio::SoundInfo>(sound->sound);
+		sound->history->durationMs = static_cast<u64>(sound->info->getDuration().count());
+	}
+	else {
+		this->stats.loadsFailed++;
+		sound->sound->release();
+		this->forgetSound(sound->name, key);
+		this->sounds.erase(key);
+		this->soundKeys.release(key);
+	}
+	for (auto& callback : callbacks) // last, since they're allowed to call back into the engine
+		callback(loaded);
+}
+
+/*
+	nonblocking sounds get opened on fmod's own loader thread. all we do here is ask each one
+	if it's done. the pending list is settled before finishing any of them since callbacks can start new loads
+*/
+auto AudioEngineFMODImpl::pollPendingLoads() -> void {
+	if (this->pendingLoads.empty()) return;
+	std::vector<std::pair<SlotKey, bool>> finished;
+	std::erase_if(this->pendingLoads, [this, &finished](SlotKey key) -> bool {
+		LoadedSound* loaded = this->sounds.get(key);
+		if (!loaded)
+			return true; // unloaded while opening
+		FMOD_OPENSTATE state = FMOD_OPENSTATE_LOADING;
+		loaded->sound->getOpenState(&state, nullptr, nullptr, nullptr);
+		if (state == FMOD_OPENSTATE_LOADING || state == FMOD_OPENSTATE_CONNECTING)
+			return false;
+		finished.emplace_back(key, state != FMOD_OPENSTATE_ERROR);
+		return true;
+	});
+	for (auto& [key, loaded] : finished)
+		this->finishLoad(key, loaded);
+}
+
+/*
+	walks the batch backwards so the newest entry for a channel wins and older ones cost a compare.
+	ids are direct table indices, so this is one pass over the arrays with no searching.
+	waiting channels have nothing to move yet, the position they were played with still applies.
+	this runs after the commands, so a setChannel3dPosition made after the entry has already landed
+	and the sequences say to leave it be
+*/
+auto AudioEngineFMODImpl::applyPositionBatch() -> void {
+	const auto& batch = this->positionBatch.take();
+	if (batch.size() == 0) return;
+	u32 stamp = this->nextBatchStamp(this->positionBatchCount);
+	for (size_t i = batch.size(); i-- > 0;) {
+		ChannelTable::Slot* slot = this->channels.find(batch.channelIds[i]);
+		if (!slot || !this->channelOf(*slot) || slot->batchStamp == stamp)
+			continue;
+		slot->batchStamp = stamp;
+		if (isStaleWrite(batch.sequences[i], slot->positionWrite))
+			continue;
+		slot->positionWrite = batch.sequences[i];
+		this->channelOf(*slot)->set3DAttributes(toFMODVec(&batch.positions[i]), batch.hasVelocity[i] ? toFMODVec(&batch.velocities[i]) : nullptr);
+	}
+}
+
+// same walk as the position batch. the volumes were converted to linear in bulk by take()
+auto AudioEngineFMODImpl::applyVolumeBatch() -> void {
+	const auto& batch = this->volumeBatch.take();
+	if (batch.size() == 0) return;
+	u32 stamp = this->nextBatchStamp(this->volumeBatchCount);
+	for (size_t i = batch.size(); i-- > 0;) {
+		ChannelTable::Slot* slot = this->channels.find(batch.channelIds[i]);
+		if (!slot || !this->channelOf(*slot) || slot->volumeStamp == stamp)
+			continue;
+		slot->volumeStamp = stamp;
+		if (isStaleWrite(batch.sequences[i], slot->volumeWrite))
+			continue;
+		slot->volumeWrite = batch.sequences[i];
+		this->channelOf(*slot)->setVolume(batch.volumes[i]);
+	}
+}
+
+/*
+	fmod calls this from inside system->update() (or stop()) on the thread that owns the engine.
+	all it does is note the id, the table gets cleaned up in retireChannels once fmod is done
+*/
+FMOD_RESULT F_CALLBACK AudioEngineFMODImpl::channelCallback(
+	FMOD_CHANNELCONTROL* channelControl,
+	FMOD_CHANNELCONTROL_TYPE controlType,
+	FMOD_CHANNELCONTROL_CALLBACK_TYPE callbackType,
+	void* commandData1,
+	void* commandData2
+) {
+	if (controlType != FMOD_CHANNELCONTROL_CHANNEL || callbackType != FMOD_CHANNELCONTROL_CALLBACK_END)
+		return FMOD_OK;
+	FMOD::Channel* channel = reinterpret_cast<FMOD::Channel*>(channelControl);
+	void* channelData = nullptr;
+	channel->getUserData(&channelData);
+	FMOD::System* system = nullptr;
+	channel->getSystemObject(&system);
+	void* implData = nullptr;
+	if (system)
+		system->getUserData(&implData);
+	if (implData)
+		static_cast<AudioEngineFMODImpl*>(implData)->retiredChannels.push_back(static_cast<i32>(reinterpret_cast<intptr_t>(channelData)));
+	return FMOD_OK;
+}
+
+auto AudioEngineFMODImpl::channelOf(const ChannelTable::Slot& slot) -> FMOD::Channel*& {
+	return this->channelHandles[static_cast<u32>(slot.channelId) & 0xFFFF];
+}
+
+auto AudioEngineFMODImpl::soundToPlay(i32 channelId, LoadedSound& loaded) -> FMOD::Sound* {
+	FMOD_MODE mode = FMOD_DEFAULT;
+	loaded.sound->getMode(&mode);
+	if (!(mode & FMOD_CREATESTREAM))
+		return loaded.sound;
+	ChannelTable::Slot* holder = this->channels.find(loaded.streamChannelId);
+	if (!holder || holder->state != ChannelTable::State::playing) {
+		loaded.streamChannelId = channelId;
+		return loaded.sound;
+	}
+	// blocking, but opening a stream only reads the header and fills the first buffer
+	ChannelStream& own = this->channelStreams[static_cast<u32>(channelId) & 0xFFFF];
+	own.sound = this->createSound(loaded.path, mode & ~FMOD_NONBLOCKING, own.pack);
+	if (!own.sound)
+		own.pack.reset();
+	return own.sound;
+}
+
+auto AudioEngineFMODImpl::releaseChannelStream(i32 channelId) -> void {
+	ChannelStream& own = this->channelStreams[static_cast<u32>(channelId) & 0xFFFF];
+	if (!own.sound) return;
+	own.sound->release();
+	own = ChannelStream{};
+}
+
+auto AudioEngineFMODImpl::retireChannels() -> void {
+	for (auto channelId : this->retiredChannels) {
+		ChannelTable::Slot* slot = this->channels.find(channelId);
+		if (slot && slot->state == ChannelTable::State::playing) {
+			this->publish(Audio::PlaybackEventType::channelEnded, channelId, slot->sound);
+			this->channels.release(channelId);
+			this->releaseChannelStream(channelId); // fmod is done with the channel, so with its stream too
+		}
+	}
+	this->retiredChannels.clear(); // keeps its capacity
+}
+
+auto AudioEngineFMODImpl::startChannel(i32 channelId, SlotKey key, LoadedSound& loaded, const Audio::Vec3<f32>& pos, f32 volumedB, const Fade& fade) -> void {
+	ChannelTable::Slot* slot = this->channels.claim(channelId);
+	if (!slot) return;
+	loaded.lastUsed = this->useClock;
+	auto start = Clock::now();
+	FMOD::Channel* channel = nullptr;
+	FMOD::Sound* sound = this->soundToPlay(channelId, loaded);
+	if (sound)
+		this->system->playSound(sound, this->channelGroup, true, &channel);
+	if (!channel) {
+		this->stats.playsFailed++;
+		this->releaseChannelStream(channelId);
+		this->channels.release(channelId);
+		this->publish(Audio::PlaybackEventType::playFailed, channelId, key);
+		return;
+	}
+	loaded.history->plays++;
+	// don't want to play sound automatically because still need to set some values on the channel
+	channel->setUserData(reinterpret_cast<void*>(static_cast<intptr_t>(channelId)));
+	channel->setCallback(&AudioEngineFMODImpl::channelCallback);
+	FMOD_VECTOR position = Vec3ToFMODVec(pos);
+	channel->set3DAttributes(&position, nullptr);
+	channel->setVolume(Audio::dBToVolume(volumedB));
+	if (loaded.priority != defaultPriority)
+		channel->setPriority(loaded.priority);
+	if (!this->effects.empty())
+		this->attachEffects(channelId, channel); // ones added while it was waiting on a load
+	if (fade.fromChannelId != 0)
+		this->scheduleCrossfade(fade, channel); // delay and fade points go on while it's paused so no block slips out early
+	channel->setPaused(false); // fmod decides real or virtual from here on, by priority then audibility
+	this->channelOf(*slot) = channel;
+	slot->sound = key;
+	this->channels.setState(*slot, ChannelTable::State::playing);
+	this->stats.playSound.record(elapsedNs(start));
+}
+
+/*
+	all in the main group's dsp clock (output samples since init), which is what setDelay and fade points on its
+	channels count in. the outgoing channel's position and that clock both only move once per mix block, so reading
+	them together gives the exact sample its sound runs out on. from there the mixer carries out the start, both
+	curves and the stop by itself, so the overlap lands in the same place however late or often update() runs
+*/
+auto AudioEngineFMODImpl::scheduleCrossfade(const Fade& fade, FMOD::Channel* next) -> void {
+	ChannelTable::Slot* from = this->channels.find(fade.fromChannelId);
+	if (!from) return; // already over, next just starts now
+	FMOD::Channel* outgoing = this->channelOf(*from);
+	if (!outgoing) { // still waiting on its own load, it never gets to play
+		this->stopChannel(fade.fromChannelId);
+		return;
+	}
+	i32 sampleRate = 0;
+	u32 blockFrames = 0;
+	this->system->getSoftwareFormat(&sampleRate, nullptr, nullptr);
+	this->system->getDSPBufferSize(&blockFrames, nullptr);
+	if (sampleRate <= 0) return;
+	unsigned long long now = 0;
+	this->channelGroup->getDSPClock(&now, nullptr);
+	// the mixer may already be working on the block after now, anything due before that gets applied late
+	const u64 earliest = now + 2ull * blockFrames;
+	const u64 length = static_cast<u64>(fade.lengthMs) * static_cast<u64>(sampleRate) / 1000;
+	u64 end = earliest + length; // looping, so it fades out from now instead
+	if (auto remaining = this->remainingOutputSamples(outgoing, static_cast<u32>(sampleRate)))
+		end = std::max<u64>(now + *remaining, earliest);
+	const u64 start = end - std::min(length, end - earliest); // asked for too late to fit the whole fade, so it's shorter
+
+	next->setDelay(start, 0, false);
+	outgoing->removeFadePoints(now, std::numeric_limits<unsigned long long>::max());
+	if (end > start) {
+		// equal power curves, two straight ramps would dip by 3dB halfway through
+		for (u32 i = 0; i <= crossfadeSegments; i++) {
+			const f64 angle = std::numbers::pi / 2.0 * i / crossfadeSegments;
+			const u64 clock = start + (end - start) * i / crossfadeSegments;
+			next->addFadePoint(clock, static_cast<f32>(std::sin(angle)));
+			outgoing->addFadePoint(clock, static_cast<f32>(std::cos(angle)));
+		}
+	}
+	outgoing->setDelay(0, end, true); // ends on that exact sample, the end callback retires it as usual
+}
+
+// how many output samples until the channel's sound runs out, at the channel's current playback rate
+auto AudioEngineFMODImpl::remainingOutputSamples(FMOD::Channel* channel, u32 sampleRate) -> std::optional<u64> {
+	FMOD::Sound* sound = nullptr;
+	if (channel->getCurrentSound(&sound) != FMOD_OK || !sound)
+		return std::nullopt;
+	FMOD_MODE mode = FMOD_DEFAULT;
+	sound->getMode(&mode);
+	if (mode & (FMOD_LOOP_NORMAL | FMOD_LOOP_BIDI))
+		return std::nullopt;
+	u32 position = 0, length = 0;
+	f32 frequency = 0.0f;
+	channel->getPosition(&position, FMOD_TIMEUNIT_PCM);
+	sound->getLength(&length, FMOD_TIMEUNIT_PCM);
+	channel->getFrequency(&frequency);
+	if (length == 0 || frequency <= 0.0f)
+		return std::nullopt;
+	if (position >= length)
+		return 0;
+	return static_cast<u64>(static_cast<f64>(length - position) * sampleRate / frequency);
+}
+
+auto AudioEngineFMODImpl::execute(AudioCommand& command) -> void {
+	std::visit([this](auto& cmd) -> void {
+		using T = std::decay_t<decltype(cmd)>;
+		if constexpr (std::is_same_v<T, AudioCommands::LoadSound>)
+			this->loadSound(cmd.key, cmd.path, cmd.soundName, cmd.space3d, cmd.looping, cmd.mode, cmd.fileBytes);
+		else if constexpr (std::is_same_v<T, AudioCommands::LoadSoundAsync>)
+			this->loadSoundAsync(cmd.key, cmd.path, cmd.soundName, cmd.space3d, cmd.looping, cmd.mode, cmd.fileBytes, std::move(cmd.onLoaded));
+		else if constexpr (std::is_same_v<T, AudioCommands::AwaitLoad>)
+			this->awaitLoad(cmd.key, std::move(cmd.onLoaded));
+		else if constexpr (std::is_same_v<T, AudioCommands::UnloadSound>)
+			this->unloadSound(cmd.key);
+		else if constexpr (std::is_same_v<T, AudioCommands::SetListener>)
+			this->set3dListenerAndOrientation(cmd.pos, cmd.look, cmd.up);
+		else if constexpr (std::is_same_v<T, AudioCommands::PlaySound>)
+			this->playSound(cmd.channelId, cmd.key, cmd.pos, cmd.volumedB);
+		else if constexpr (std::is_same_v<T, AudioCommands::PlayWhenReady>)
+			this->playWhenReady(cmd.channelId, cmd.key, cmd.pos, cmd.volumedB);
+		else if constexpr (std::is_same_v<T, AudioCommands::Crossfade>)
+			this->playWhenReady(cmd.channelId, cmd.key, Audio::Vec3<f32>{ 0, 0, 0 }, cmd.volumedB, Fade{ cmd.fromChannelId, cmd.fadeMs });
+		else if constexpr (std::is_same_v<T, AudioCommands::StopChannel>)
+			this->stopChannel(cmd.channelId);
+		else if constexpr (std::is_same_v<T, AudioCommands::StopAllChannels>)
+			this->stopAllChannels();
+		else if constexpr (std::is_same_v<T, AudioCommands::SetChannel3dPosition>)
+			this->setChannel3dPosition(cmd.channelId, cmd.pos, cmd.sequence);
+		else if constexpr (std::is_same_v<T, AudioCommands::SetChannelVolume>)
+			this->setChannelVolume(cmd.channelId, cmd.volumedB, cmd.sequence);
+		else if constexpr (std::is_same_v<T, AudioCommands::SetSoundPriority>)
+			this->setSoundPriority(cmd.key, cmd.priority);
+		else if constexpr (std::is_same_v<T, AudioCommands::AddEffect>)
+			this->addEffect(cmd.effectId, std::move(cmd.unit), cmd.channelId);
+		else if constexpr (std::is_same_v<T, AudioCommands::RemoveEffect>)
+			this->removeEffect(cmd.effectId);
+	}, command);
+}
+
@@ -2,23 +2,140 @@
 
 #include "PrimitiveTypes.hpp"
 
+#include "Vec.hpp"
+#include "AudioEngineCore.hpp"
+#include "SlotMap.hpp"
+#include "PoolAllocator.hpp"
+#include "AsyncFileReader.hpp"
+#include "ChannelTable.hpp"
+#include "SoundInfo.hpp"
+#include "DspUnit.hpp"
+
 #include "fmod.hpp"
 
-#include <map>
 #include <string>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <functional>
+#include <unordered_map>
+
+auto Vec3ToFMODVec(const Audio::Vec3<f32>& in) -> FMOD_VECTOR;
+auto toFMODVec(const Audio::Vec3<f32>* in) -> const FMOD_VECTOR*;
+
+struct AudioEngineFMODImpl : AudioEngineCore {
+	static constexpr const u32 crossfadeSegments = 16; // fade points are joined by straight lines, this many per curve
+
+	struct LoadedSound {
+		FMOD::Sound* sound = nullptr;
+		std::string name;
+		bool ready = false; // false while a nonblocking open is still in flight
+		u64 memoryBytes = 0; // filled in once ready
+		std::unique_ptr<Audio::SoundInfo> info; // static details (name, format, duration, tags), also filled in once ready
+		Clock::time_point requested{}; // when a nonblocking open was asked for, for the load histogram
+		i32 priority = defaultPriority; // handed to every channel it plays on
+		u64 lastUsed = 0; // useClock as of its last load, play or live channel, for the memory budget
+		std::vector<WaitingPlay> waitingPlays;
+		std::vector<std::function<void(bool)>> callbacks;
+		std::shared_ptr<const Audio::AssetPack> pack; // set if it was opened out of a mounted pack. fmod reads straight from the mapping
+		LoadHistory* history = nullptr; // its path's entry in loadHistory, for the load policy
+		std::string path; // for opening a second stream of it, see ChannelStream
+		i32 streamChannelId = 0; // if it's a stream, the last channel that played sound itself
+	};
+
+	// a stream is one decoder with one read position, so fmod takes it off whatever channel it was on when it's played
+	// again. a channel that starts while its sound's stream is already playing (a crossfade into the same song) gets its
+	// own instance of the file instead, released once the channel ends
+	struct ChannelStream {
+		FMOD::Sound* sound = nullptr;
+		std::shared_ptr<const Audio::AssetPack> pack;
+	};
 
-struct AudioEngineFMODImpl {
-	typedef std::map<std::string, FMOD::Sound*> SoundMap;
-	typedef std::map<i32, FMOD::Channel*> ChannelMap;
+	// a DspUnit wrapped in an fmod dsp. the mixer reaches it through the dsp's plugin data, so it lives in a node based map
+	struct Effect {
+		FMOD::DSP* dsp = nullptr;
+		std::shared_ptr<Audio::DspUnit> unit; // held until fmod has let go of the dsp
+		i32 channelId = 0; // 0 for the main group
+		u32 maxFrames = 0; // what the unit was prepared for, longer blocks get split
+		bool attached = false; // false while its channel is still waiting on a load
+	};
 
-	AudioEngineFMODImpl();
-	~AudioEngineFMODImpl();
+	typedef SlotMap<LoadedSound> SoundMap;
 
-	auto update() -> void;
+	AudioEngineFMODImpl(const Audio::AudioEngineConfig& config = Audio::AudioEngineConfig{});
+	~AudioEngineFMODImpl() override;
+
+	auto update() -> void override;
+	auto loadSound(SlotKey key, const std::string& path, const std::string& soundName, bool space3d, bool looping, Audio::LoadMode mode, u64 fileBytes) -> bool override;
+	auto getStats() -> Audio::EngineStats override;
+	auto isVirtual(i32 channelId) -> bool override;
+	auto getPlayingSound(i32 channelId) -> std::optional<Audio::SoundInfo> override;
+	auto getPlaybackPosition(i32 channelId) -> std::optional<Audio::PlaybackPosition> override;
+	auto getSoundInfo(SlotKey key) -> const Audio::SoundInfo* override;
+	auto getLoadState(SlotKey key) -> Audio::LoadState override;
+	auto getSoundMemoryUsage(SlotKey key) -> u64 override;
+	auto getFileStats() -> std::vector<Audio::FileStats> override;
+	auto getRenderedTime() -> std::chrono::microseconds override;
+
+	// these do the actual fmod work. only call from the thread that owns the impl
+	auto loadSoundAsync(SlotKey key, const std::string& path, const std::string& soundName, bool space3d, bool looping, Audio::LoadMode mode, u64 fileBytes, std::function<void(bool)>&& onLoaded) -> void;
+	auto awaitLoad(SlotKey key, std::function<void(bool)>&& onLoaded) -> void;
+	auto unloadSound(SlotKey key) -> void override;
+	auto set3dListenerAndOrientation(const Audio::Vec3<f32>& pos, const Audio::Vec3<f32>& look, const Audio::Vec3<f32>& up) -> void;
+	auto playSound(i32 channelId, SlotKey key, const Audio::Vec3<f32>& pos, f32 volumedB) -> void;
+	auto playWhenReady(i32 channelId, SlotKey key, const Audio::Vec3<f32>& pos, f32 volumedB, const Fade& fade = Fade{}) -> void;
+	auto stopChannel(i32 channelId) -> void;
+	auto stopAllChannels() -> void;
+	auto setChannel3dPosition(i32 channelId, const Audio::Vec3<f32>& pos, u32 sequence) -> void;
+	auto setChannelVolume(i32 channelId, f32 volumedB, u32 sequence) -> void;
+	auto setSoundPriority(SlotKey key, i32 priority) -> void;
+	auto addEffect(i32 effectId, std::shared_ptr<Audio::DspUnit>&& unit, i32 channelId) -> void;
+	auto removeEffect(i32 effectId) -> void;
+
+	// roughly what fmod keeps resident for this sound, based on how it was opened
+	auto estimateSoundMemory(FMOD::Sound* sound, bool mapped) const -> u64;
 
 	FMOD::System* system;
-	i32 nextChannelId;
 	FMOD::ChannelGroup* channelGroup;
 	SoundMap sounds;
-	ChannelMap channels;
-};
\ No newline at end of file
+	std::vector<i32> retiredChannels; // filled by fmod's end callback during system->update()
+	std::vector<SlotKey> pendingLoads; // sounds whose nonblocking open hasn't finished
+	std::vector<FMOD::Channel*> channelHandles; // by table index, like the native backend's voices. null while waiting on a load
+	std::vector<ChannelStream> channelStreams; // by table index too, empty unless that channel needed a stream of its own
+	std::unique_ptr<AsyncFileReader> fileReader; // only with config.ioThreads. fmod closes its files in system->release(), so it goes after
+	std::unordered_map<i32, Effect, std::hash<i32>, std::equal_to<i32>, PoolStlAllocator<std::pair<const i32, Effect>>> effects; // owner only
+
+protected:
+	auto execute(AudioCommand& command) -> void override;
+
+private:
+	static auto buildMode(bool space3d, bool looping, Audio::LoadMode loadMode) -> FMOD_MODE; // loadMode already resolved, not automatic
+	auto createSound(const std::string& path, FMOD_MODE mode, std::shared_ptr<const Audio::AssetPack>& pack) -> FMOD::Sound*;
+	auto finishLoad(SlotKey key, bool loaded) -> void;
+	auto pollPendingLoads() -> void;
+	auto applyPositionBatch() -> void;
+	auto applyVolumeBatch() -> void;
+	auto retireChannels() -> void;
+	auto channelOf(const ChannelTable::Slot& slot) -> FMOD::Channel*&; // only meaningful for a slot that's been claimed
+	auto soundToPlay(i32 channelId, LoadedSound& loaded) -> FMOD::Sound*; // loaded.sound, or a stream just for channelId
+	auto releaseChannelStream(i32 channelId) -> void;
+	auto attachEffects(i32 channelId, FMOD::Channel* channel) -> void;
+	auto releaseEffect(Effect& effect) -> void;
+	auto dropFinishedEffects() -> void;
+	// fmod wants a plain function pointer with its calling convention, so no trailing return here
+	static FMOD_RESULT F_CALLBACK channelCallback(
+		FMOD_CHANNELCONTROL* channelControl,
+		FMOD_CHANNELCONTROL_TYPE controlType,
+		FMOD_CHANNELCONTROL_CALLBACK_TYPE callbackType,
+		void* commandData1,
+		void* commandData2
+	);
+	// the fmod side of every Effect, these run on the mixer thread
+	static FMOD_RESULT F_CALLBACK effectCreate(FMOD_DSP_STATE* state);
+	static FMOD_RESULT F_CALLBACK effectRead(FMOD_DSP_STATE* state, float* inBuffer, float* outBuffer, unsigned int length, int inChannels, int* outChannels);
+	static FMOD_RESULT F_CALLBACK effectShouldProcess(FMOD_DSP_STATE* state, FMOD_BOOL inputsIdle, unsigned int length, FMOD_CHANNELMASK inMask, FMOD_SPEAKERMODE inSpeakerMode);
+	auto startChannel(i32 channelId, SlotKey key, LoadedSound& loaded, const Audio::Vec3<f32>& pos, f32 volumedB, const Fade& fade = Fade{}) -> void;
+	auto scheduleCrossfade(const Fade& fade, FMOD::Channel* next) -> void;
+	auto remainingOutputSamples(FMOD::Channel* channel, u32 sampleRate) -> std::optional<u64>; // nullopt if it loops or can't tell
+};
@@ -0,0 +1,692 @@
+
+#include "pch.h"
+
+#include "AudioEngineNativeImpl.hpp"
+
+#include "Utils.hpp"
+#include "VecMath.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <type_traits>
+
+AudioEngineNativeImpl::AudioEngineNativeImpl(const Audio::AudioEngineConfig& config) :
+	AudioEngineCore(config),
+	mixer(channels.getCapacity()),
+	sounds{},
+	voices(channels.getCapacity()),
+	effects{},
+	listenerPos{ 0, 0, 0 },
+	listenerLook{ 0, 0, 1 }, // fmod's default listener: at the origin, facing +z, +y up
+	listenerUp{ 0, 1, 0 },
+	realCount{0},
+	virtualCount{0},
+	loadJobs{},
+	loadResults{},
+	released{},
+	loader{}
+{
+	if (this->config.output == Audio::OutputMode::wavWriterNRT)
+		this->mixer.openWavFile(this->config.wavWriterPath);
+	else if (this->config.output == Audio::OutputMode::realtime)
+		this->mixer.startThread();
+	this->loader = std::make_unique<std::jthread>([this](std::stop_token stop) -> void {
+		this->runLoader(stop);
+	});
+}
+
+AudioEngineNativeImpl::~AudioEngineNativeImpl() {
+	this->loader.reset(); // its stop token wakes the condition variable
+	this->mixer.stopThread();
+	this->effects.clear();
+	this->sounds.clear();
+	this->soundNames.clear();
+}
+
+auto AudioEngineNativeImpl::update() -> void {
+	auto start = Clock::now();
+	this->drainCommands();
+	this->pollLoads();
+	this->runLoadCallbacks();
+	this->applyPositionBatch(); // after the commands, so channels started this tick get moved too
+	this->applyVolumeBatch();
+	this->updateVoices();
+	if (this->config.output != Audio::OutputMode::realtime)
+		this->mixer.render(); // one block per update, like fmod's nrt outputs
+	this->retireChannels();
+	this->collectReleased();
+	this->enforceMemoryBudget(this->sounds);
+	this->stats.update.record(elapsedNs(start));
+}
+
+auto AudioEngineNativeImpl::isVirtual(i32 channelId) -> bool {
+	auto* slot = this->channels.find(channelId);
+	if (!slot || slot->state != ChannelTable::State::playing)
+		return false;
+	return this->voices[static_cast<u32>(channelId) & 0xFFFF].silent;
+}
+
+auto AudioEngineNativeImpl::getPlayingSound(i32 channelId) -> std::optional<Audio::SoundInfo> {
+	auto* slot = this->channels.find(channelId);
+	if (!slot || slot->state != ChannelTable::State::playing)
+		return std::optional<Audio::SoundInfo>{};
+	const auto* loaded = this->sounds.get(slot->sound);
+	if (!loaded || !loaded->ready)
+		return std::optional<Audio::SoundInfo>{};
+	auto* details = new SoundInfoImpl(loaded->details);
+	u64 clock = 0;
+	details->durationPlayed = std::chrono::milliseconds(this->mixer.getPosition(channelId, clock) * 1000 / std::max(loaded->data->sampleRate, 1u));
+	return std::optional<Audio::SoundInfo>(std::in_place, details);
+}
+
+auto AudioEngineNativeImpl::getPlaybackPosition(i32 channelId) -> std::optional<Audio::PlaybackPosition> {
+	const auto* slot = this->channels.find(channelId);
+	if (!slot)
+		return std::nullopt;
+	Audio::PlaybackPosition playback{ toHandle(slot->sound), std::chrono::milliseconds::zero(), std::chrono::milliseconds::zero() };
+	const auto* loaded = this->sounds.get(slot->sound);
+	if (!loaded || !loaded->ready)
+		return playback;
+	playback.duration = loaded->details.duration;
+	if (slot->state == ChannelTable::State::playing) { // still zero while waiting on a load
+		u64 clock = 0;
+		playback.position = std::chrono::milliseconds(this->mixer.getPosition(channelId, clock) * 1000 / std::max(loaded->data->sampleRate, 1u));
+	}
+	return playback;
+}
+
+auto AudioEngineNativeImpl::getSoundInfo(SlotKey key) -> const Audio::SoundInfo* {
+	const auto* loaded = this->sounds.get(key);
+	if (!loaded)
+		return nullptr;
+	return loaded->info.get();
+}
+
+auto AudioEngineNativeImpl::getLoadState(SlotKey key) -> Audio::LoadState {
+	const auto* loaded = this->sounds.get(key);
+	if (!loaded)
+		return Audio::LoadState::notLoaded;
+	return loaded->ready ? Audio::LoadState::loaded : Audio::LoadState::loading;
+}
+
+auto AudioEngineNativeImpl::getSoundMemoryUsage(SlotKey key) -> u64 {
+	const auto* loaded = this->sounds.get(key);
+	if (!loaded || !loaded->ready)
+		return 0;
+	return loaded->memoryBytes;
+}
+
+// the loader reads whole files in one go and nothing streams, so there's no i/o of fmod's to report on
+auto AudioEngineNativeImpl::getFileStats() -> std::vector<Audio::FileStats> {
+	return {};
+}
+
+auto AudioEngineNativeImpl::getRenderedTime() -> std::chrono::microseconds {
+	return std::chrono::microseconds(this->mixer.getClock() * 1000000 / NativeMixer::sampleRate);
+}
+
+// cpuDsp is the mixer's time per block against the block's length, the other fmod cpu figures have no equivalent here
+auto AudioEngineNativeImpl::getStats() -> Audio::EngineStats {
+	Audio::EngineStats snapshot = this->stats;
+	snapshot.commandsDropped = this->droppedCommands.load(std::memory_order_relaxed);
+	snapshot.soundsLoaded = static_cast<u32>(this->sounds.size());
+	snapshot.channelsActive = this->channels.activeCount();
+	snapshot.channelsReal = this->realCount;
+	snapshot.channelsVirtual = this->virtualCount;
+	snapshot.cpuDsp = this->mixer.getLoad();
+	snapshot.soundMemoryBytes = this->residentSoundBytes;
+	snapshot.mappedPackBytes = this->mappedPackBytes();
+	addPoolStats(snapshot);
+	return snapshot;
+}
+
+/*
+	mono and stereo go to the mixer as they are. wider layouts fold down with even channels to the left and odd to the
+	right, which puts L/R/Ls/Rs where they belong for the usual orders and splits center and lfe evenly
+*/
+auto AudioEngineNativeImpl::toSoundData(DecodedSound& decoded, bool looping) -> std::shared_ptr<const NativeSoundData> {
+	auto data = std::make_shared<NativeSoundData>();
+	data->sampleRate = decoded.sampleRate;
+	data->frames = decoded.frames;
+	data->looping = looping;
+	if (decoded.channels <= 2) {
+		data->channels = decoded.channels;
+		data->samples = std::move(decoded.samples);
+		return data;
+	}
+	const i32 channels = decoded.channels;
+	const f32 leftScale = 1.0f / ((channels + 1) / 2), rightScale = 1.0f / (channels / 2);
+	data->channels = 2;
+	data->samples.resize(static_cast<size_t>(decoded.frames) * 2);
+	for (u64 f = 0; f < decoded.frames; f++) {
+		f32 left = 0.0f, right = 0.0f;
+		for (i32 c = 0; c < channels; c++)
+			(c % 2 == 0 ? left : right) += decoded.samples[f * channels + c];
+		data->samples[f * 2] = left * leftScale;
+		data->samples[f * 2 + 1] = right * rightScale;
+	}
+	decoded.samples = std::vector<f32>{}; // gives the memory back now, not when the result goes away
+	return data;
+}
+
+auto AudioEngineNativeImpl::toDetails(const std::string& path, const DecodedSound& decoded) -> SoundInfoImpl {
+	SoundInfoImpl details;
+	size_t slash = path.find_last_of("/\\");
+	details.name = slash == std::string::npos ? path : path.substr(slash + 1); // fmod falls back on the file name too
+	details.format = decoded.format;
+	details.type = decoded.type;
+	details.channels = decoded.channels;
+	details.bitsPerSample = decoded.bitsPerSample;
+	details.duration = std::chrono::milliseconds(decoded.sampleRate ? decoded.frames * 1000 / decoded.sampleRate : 0);
+	details.tags = decoded.tags;
+	return details;
+}
+
+// mode doesn't matter here, everything gets decoded up front
+auto AudioEngineNativeImpl::loadSound(SlotKey key, const std::string& path, const std::string& soundName, bool space3d, bool looping, Audio::LoadMode mode, u64 fileBytes) -> bool {
+	auto start = Clock::now();
+	LoadResult result{ key, path, false, DecodedSound{} };
+	result.loaded = decode(path, this->findPacked(path), result.decoded);
+	this->stats.loadSound.record(elapsedNs(start));
+	if (!result.loaded) {
+		this->stats.loadsFailed++;
+		this->publish(Audio::PlaybackEventType::loadFailed, 0, key);
+		this->forgetSound(soundName, key);
+		this->soundKeys.release(key);
+		return false;
+	}
+	LoadedSound& loaded = this->sounds.insert(key, LoadedSound{});
+	loaded.name = soundName;
+	loaded.space3d = space3d;
+	loaded.looping = looping;
+	loaded.details = toDetails(path, result.decoded);
+	loaded.data = toSoundData(result.decoded, looping);
+	loaded.memoryBytes = loaded.data->samples.size() * sizeof(f32);
+	loaded.lastUsed = this->useClock;
+	this->residentSoundBytes += loaded.memoryBytes;
+	loaded.info = std::make_unique<Audio::SoundInfo>(new SoundInfoImpl(loaded.details));
+	loaded.ready = true;
+	this->publish(Audio::PlaybackEventType::soundLoaded, 0, key);
+	return true;
+}
+
+auto AudioEngineNativeImpl::loadSoundAsync(SlotKey key, const std::string& path, const std::string& soundName, bool space3d, bool looping, Audio::LoadMode mode, u64 fileBytes, std::function<void(bool)>&& onLoaded) -> void {
+	LoadedSound& loaded = this->sounds.insert(key, LoadedSound{});
+	loaded.name = soundName;
+	loaded.space3d = space3d;
+	loaded.looping = looping;
+	loaded.requested = Clock::now();
+	if (onLoaded)
+		loaded.callbacks.push_back(std::move(onLoaded));
+	{
+		std::lock_guard<std::mutex> lock(this->loadLock);
+		this->loadJobs.push_back(LoadJob{ key, path, this->findPacked(path) });
+	}
+	this->loadSignal.notify_one();
+}
+
+// decoding copies everything into pcm anyway, so a pack only saves the open and the read
+auto AudioEngineNativeImpl::decode(const std::string& path, const PackedFile& packed, DecodedSound& out) -> bool {
+	if (packed.pack)
+		return decodeSound(packed.bytes.data(), packed.bytes.size(), out);
+	return decodeSoundFile(path, out);
+}
+
+// one file at a time, in the order asked. the update thread is woken for each one so playWhenReady starts promptly
+auto AudioEngineNativeImpl::runLoader(std::stop_token stop) -> void {
+	while (true) {
+		LoadJob job;
+		{
+			std::unique_lock<std::mutex> lock(this->loadLock);
+			if (!this->loadSignal.wait(lock, stop, [this]() -> bool { return !this->loadJobs.empty(); }))
+				return;
+			job = std::move(this->loadJobs.front());
+			this->loadJobs.pop_front();
+		}
+		LoadResult result{ job.key, std::move(job.path), false, DecodedSound{} };
+		result.loaded = decode(result.path, job.packed, result.decoded);
+		{
+			std::lock_guard<std::mutex> lock(this->loadLock);
+			this->loadResults.push_back(std::move(result));
+		}
+		this->wake();
+	}
+}
+
+auto AudioEngineNativeImpl::pollLoads() -> void {
+	std::vector<LoadResult> finished;
+	{
+		std::lock_guard<std::mutex> lock(this->loadLock);
+		if (this->loadResults.empty()) return;
+		finished.swap(this->loadResults);
+	}
+	for (auto& result : finished)
+		this->finishLoad(result.key, result.loaded ? &result : nullptr);
+}
+
+auto AudioEngineNativeImpl::awaitLoad(SlotKey key, std::function<void(bool)>&& onLoaded) -> void {
+	LoadedSound* loaded = this->sounds.get(key);
+	if (!loaded)
+		this->deferLoadCallback(std::move(onLoaded), false); // failed or unloaded before we got here
+	else if (loaded->ready)
+		this->deferLoadCallback(std::move(onLoaded), true);
+	else
+		loaded->callbacks.push_back(std::move(onLoaded));
+}
+
+auto AudioEngineNativeImpl::finishLoad(SlotKey key, LoadResult* result) -> void {
+	LoadedSound* sound = this->sounds.get(key);
+	if (!sound || sound->ready) return; // unloaded while decoding (and maybe the key reused since)
+	const bool loaded = result != nullptr;
+	auto callbacks = std::move(sound->callbacks);
+	this->stats.loadSound.record(elapsedNs(sound->requested)); // only as precise as how often update() polls
+	if (loaded) {
+		sound->details = toDetails(result->path, result->decoded);
+		sound->data = toSoundData(result->decoded, sound->looping);
+		sound->memoryBytes = sound->data->samples.size() * sizeof(f32);
+		sound->lastUsed = this->useClock;
+		this->residentSoundBytes += sound->memoryBytes;
+		sound->info = std::make_unique<Audio::SoundInfo>(new SoundInfoImpl(sound->details));
+		sound->ready = true;
+	}
+	// moved out first: starting one can stop another that's waiting on this same sound (a crossfade into itself), and
+	// stopChannel erases from the list
+	auto waitingPlays = std::move(sound->waitingPlays);
+	sound->waitingPlays.clear();
+	for (auto& waiting : waitingPlays) {
+		if (!this->channels.find(waiting.channelId)) continue; // stopped by one started before it
+		if (loaded)
+			this->startChannel(waiting.channelId, key, *sound, waiting.pos, waiting.volumedB, waiting.fade);
+		else {
+			this->channels.release(waiting.channelId);
+			this->publish(Audio::PlaybackEventType::playFailed, waiting.channelId, key);
+		}
+	}
+	this->publish(loaded ? Audio::PlaybackEventType::soundLoaded : Audio::PlaybackEventType::loadFailed, 0, key);
+	if (!loaded) {
+		this->stats.loadsFailed++;
+		this->forgetSound(sound->name, key);
+		this->sounds.erase(key);
+		this->soundKeys.release(key);
+	}
+	for (auto& callback : callbacks) // last, since they're allowed to call back into the engine
+		callback(loaded);
+}
+
+auto AudioEngineNativeImpl::unloadSound(SlotKey key) -> void {
+	LoadedSound* loaded = this->sounds.get(key);
+	if (!loaded) return;
+	auto callbacks = std::move(loaded->callbacks); // only non-empty if it was still loading
+	for (auto& waiting : loaded->waitingPlays) {
+		this->channels.release(waiting.channelId);
+		this->publish(Audio::PlaybackEventType::channelEnded, waiting.channelId, key);
+	}
+	// like releasing an fmod sound, anything playing it stops. they're retired when the mixer says they've ended
+	this->channels.forEachActive([this, key](ChannelTable::Slot& slot) -> void {
+		if (slot.state == ChannelTable::State::playing && slot.sound == key)
+			this->mixer.control(slot.channelId).stopRequested.store(true, std::memory_order_relaxed);
+	});
+	if (loaded->ready)
+		this->residentSoundBytes -= loaded->memoryBytes;
+	if (loaded->data)
+		this->releaseLater(std::move(loaded->data));
+	this->forgetSound(loaded->name, key);
+	this->sounds.erase(key); // a load still in flight finds nothing when it lands and is dropped
+	this->soundKeys.release(key);
+	for (auto& callback : callbacks) // unload can come straight from the caller, so not from in here
+		this->deferLoadCallback(std::move(callback), false);
+}
+
+auto AudioEngineNativeImpl::set3dListenerAndOrientation(const Audio::Vec3<f32>& pos, const Audio::Vec3<f32>& look, const Audio::Vec3<f32>& up) -> void {
+	this->listenerPos = pos;
+	this->listenerLook = look;
+	this->listenerUp = up;
+}
+
+auto AudioEngineNativeImpl::playSound(i32 channelId, SlotKey key, const Audio::Vec3<f32>& pos, f32 volumedB) -> void {
+	LoadedSound* loaded = this->sounds.get(key);
+	if (!loaded || !loaded->ready) {
+		this->stats.playsFailed++;
+		this->channels.abandonId(channelId); // this is a failure case, but caller already has a valid channel id anyway. never claimed, so it just goes back
+		this->publish(Audio::PlaybackEventType::playFailed, channelId, key);
+		return;
+	}
+	this->startChannel(channelId, key, *loaded, pos, volumedB);
+}
+
+auto AudioEngineNativeImpl::playWhenReady(i32 channelId, SlotKey key, const Audio::Vec3<f32>& pos, f32 volumedB, const Fade& fade) -> void {
+	LoadedSound* loaded = this->sounds.get(key);
+	if (!loaded) {
+		this->stats.playsFailed++;
+		this->channels.abandonId(channelId); // unlike a blocking load, there's nothing to fall back on
+		this->publish(Audio::PlaybackEventType::playFailed, channelId, key);
+		return;
+	}
+	if (loaded->ready) {
+		this->startChannel(channelId, key, *loaded, pos, volumedB, fade);
+		return;
+	}
+	ChannelTable::Slot* slot = this->channels.claim(channelId);
+	if (!slot) return;
+	slot->sound = key;
+	this->channels.setState(*slot, ChannelTable::State::waiting);
+	loaded->waitingPlays.push_back(WaitingPlay{ channelId, pos, volumedB, fade });
+}
+
+auto AudioEngineNativeImpl::stopChannel(i32 channelId) -> void {
+	ChannelTable::Slot* slot = this->channels.find(channelId);
+	if (!slot) return;
+	if (slot->state == ChannelTable::State::waiting) { // hasn't started yet, just forget about it
+		LoadedSound* loaded = this->sounds.get(slot->sound);
+		if (loaded) {
+			std::erase_if(loaded->waitingPlays, [channelId](const WaitingPlay& w) {
+				return w.channelId == channelId;
+			});
+		}
+		this->publish(Audio::PlaybackEventType::channelEnded, channelId, slot->sound);
+		this->channels.release(channelId);
+		return;
+	}
+	this->mixer.control(channelId).stopRequested.store(true, std::memory_order_relaxed); // retired once the mixer drops it
+}
+
+auto AudioEngineNativeImpl::stopAllChannels() -> void {
+	std::vector<i32> waiting;
+	this->channels.forEachActive([this, &waiting](ChannelTable::Slot& slot) -> void {
+		if (slot.state == ChannelTable::State::waiting) {
+			LoadedSound* loaded = this->sounds.get(slot.sound);
+			if (loaded)
+				loaded->waitingPlays.clear();
+			this->publish(Audio::PlaybackEventType::channelEnded, slot.channelId, slot.sound);
+			waiting.push_back(slot.channelId);
+		}
+		else
+			this->mixer.control(slot.channelId).stopRequested.store(true, std::memory_order_relaxed);
+	});
+	for (auto channelId : waiting)
+		this->channels.release(channelId);
+}
+
+auto AudioEngineNativeImpl::setChannel3dPosition(i32 channelId, const Audio::Vec3<f32>& pos, u32 sequence) -> void {
+	ChannelTable::Slot* slot = this->channels.find(channelId);
+	if (!slot || slot->state != ChannelTable::State::playing) return;
+	slot->positionWrite = sequence;
+	this->voices[static_cast<u32>(channelId) & 0xFFFF].pos = pos;
+}
+
+auto AudioEngineNativeImpl::setChannelVolume(i32 channelId, f32 volumedB, u32 sequence) -> void {
+	ChannelTable::Slot* slot = this->channels.find(channelId);
+	if (!slot || slot->state != ChannelTable::State::playing) return;
+	slot->volumeWrite = sequence;
+	this->voices[static_cast<u32>(channelId) & 0xFFFF].volume = Audio::dBToVolume(volumedB);
+}
+
+auto AudioEngineNativeImpl::setSoundPriority(SlotKey key, i32 priority) -> void {
+	LoadedSound* loaded = this->sounds.get(key);
+	if (!loaded) return;
+	loaded->priority = std::clamp(priority, 0, 256);
+	this->channels.forEachActive([this, key, loaded](ChannelTable::Slot& slot) -> void {
+		if (slot.state == ChannelTable::State::playing && slot.sound == key) // waiting ones pick it up when they start
+			this->voices[static_cast<u32>(slot.channelId) & 0xFFFF].priority = loaded->priority;
+	});
+}
+
+auto AudioEngineNativeImpl::addEffect(i32 effectId, std::shared_ptr<Audio::DspUnit>&& unit, i32 channelId) -> void {
+	ChannelTable::Slot* slot = nullptr;
+	if (channelId != 0) {
+		slot = this->channels.find(channelId);
+		if (!slot) return; // already over, the unit just gets dropped
+	}
+	unit->prepare(NativeMixer::sampleRate, NativeMixer::blockFrames); // before the mixer can see it
+	Effect& effect = this->effects[effectId];
+	effect.unit = std::move(unit);
+	effect.channelId = channelId;
+	if (!slot || slot->state == ChannelTable::State::playing)
+		effect.attached = this->mixer.send(NativeMixer::AddEffect{ effectId, channelId, effect.unit });
+	// still waiting on its load, startChannel attaches it
+}
+
+auto AudioEngineNativeImpl::removeEffect(i32 effectId) -> void {
+	auto found = this->effects.find(effectId);
+	if (found == this->effects.end()) return;
+	if (found->second.attached)
+		this->mixer.send(NativeMixer::RemoveEffect{ effectId });
+	this->releaseLater(std::move(found->second.unit));
+	this->effects.erase(found);
+}
+
+/*
+	walks the batch backwards so the newest entry for a channel wins and older ones cost a compare.
+	same as the fmod side, except the positions land in our own voice table for updateVoices to use
+*/
+auto AudioEngineNativeImpl::applyPositionBatch() -> void {
+	const auto& batch = this->positionBatch.take();
+	if (batch.size() == 0) return;
+	u32 stamp = this->nextBatchStamp(this->positionBatchCount);
+	for (size_t i = batch.size(); i-- > 0;) {
+		ChannelTable::Slot* slot = this->channels.find(batch.channelIds[i]);
+		if (!slot || slot->state != ChannelTable::State::playing || slot->batchStamp == stamp)
+			continue;
+		slot->batchStamp = stamp;
+		if (isStaleWrite(batch.sequences[i], slot->positionWrite))
+			continue;
+		slot->positionWrite = batch.sequences[i];
+		this->voices[static_cast<u32>(batch.channelIds[i]) & 0xFFFF].pos = batch.positions[i];
+	}
+}
+
+auto AudioEngineNativeImpl::applyVolumeBatch() -> void {
+	const auto& batch = this->volumeBatch.take();
+	if (batch.size() == 0) return;
+	u32 stamp = this->nextBatchStamp(this->volumeBatchCount);
+	for (size_t i = batch.size(); i-- > 0;) {
+		ChannelTable::Slot* slot = this->channels.find(batch.channelIds[i]);
+		if (!slot || slot->state != ChannelTable::State::playing || slot->volumeStamp == stamp)
+			continue;
+		slot->volumeStamp = stamp;
+		if (isStaleWrite(batch.sequences[i], slot->volumeWrite))
+			continue;
+		slot->volumeWrite = batch.sequences[i];
+		this->voices[static_cast<u32>(batch.channelIds[i]) & 0xFFFF].volume = batch.volumes[i];
+	}
+}
+
+// inverse rolloff and an equal power pan across the listener's right axis (left handed, like fmod's default). 2d is just volume
+auto AudioEngineNativeImpl::voiceGains(const Voice& voice, f32 distance, f32& left, f32& right) const -> void {
+	left = voice.volume;
+	right = voice.volume;
+	if (!voice.space3d)
+		return;
+	const Audio::Vec3<f32> rightAxis = Audio::normalized(Audio::cross(this->listenerUp, this->listenerLook));
+	const f32 attenuation = minDistance / std::clamp(distance, minDistance, maxDistance);
+	const f32 pan = distance > 0.0f ? std::clamp(Audio::dot(voice.pos - this->listenerPos, rightAxis) / distance, -1.0f, 1.0f) : 0.0f;
+	const f32 angle = (pan + 1.0f) * std::numbers::pi_v<f32> / 4.0f;
+	left *= attenuation * std::cos(angle);
+	right *= attenuation * std::sin(angle);
+}
+
+/*
+	what fmod's update does for its channels. distances go through VecMath in bulk, then the most important realVoices
+	(priority, then how loud they'd be) get mixed, the rest and anything under virtualVolume stay silent, and past
+	virtualVoices the least important are stopped outright. the mixer picks the results up through its atomics
+*/
+auto AudioEngineNativeImpl::updateVoices() -> void {
+	this->order.clear();
+	this->xs.clear();
+	this->ys.clear();
+	this->zs.clear();
+	this->channels.forEachActive([this](ChannelTable::Slot& slot) -> void {
+		if (slot.state != ChannelTable::State::playing) return;
+		const u32 index = static_cast<u32>(slot.channelId) & 0xFFFF;
+		const Voice& voice = this->voices[index];
+		this->order.push_back(index);
+		this->xs.push_back(voice.pos.x);
+		this->ys.push_back(voice.pos.y);
+		this->zs.push_back(voice.pos.z);
+	});
+	const size_t count = this->order.size();
+	this->distances.resize(count);
+	this->audibility.resize(count);
+	Audio::distances(this->listenerPos, this->xs, this->ys, this->zs, this->distances);
+	for (size_t i = 0; i < count; i++) {
+		f32 left, right;
+		this->voiceGains(this->voices[this->order[i]], this->distances[i], left, right);
+		NativeMixer::VoiceControl& control = this->mixer.control(static_cast<i32>(this->order[i]));
+		control.left.store(left, std::memory_order_relaxed);
+		control.right.store(right, std::memory_order_relaxed);
+		this->audibility[i] = std::max(left, right);
+	}
+
+	// only sorted when there's more than can be real, which is the only time the order matters
+	const size_t realLimit = this->config.realVoices;
+	const size_t virtualLimit = std::min<size_t>(this->config.virtualVoices, 4095);
+	this->ranking.resize(count);
+	for (size_t i = 0; i < count; i++)
+		this->ranking[i] = static_cast<u32>(i);
+	if (count > realLimit) {
+		std::sort(this->ranking.begin(), this->ranking.end(), [this](u32 a, u32 b) -> bool {
+			const i32 first = this->voices[this->order[a]].priority, second = this->voices[this->order[b]].priority;
+			if (first != second)
+				return first < second;
+			return this->audibility[a] > this->audibility[b];
+		});
+	}
+	this->realCount = 0;
+	this->virtualCount = 0;
+	for (size_t rank = 0; rank < count; rank++) {
+		const u32 i = this->ranking[rank];
+		const u32 index = this->order[i];
+		NativeMixer::VoiceControl& control = this->mixer.control(static_cast<i32>(index));
+		if (rank >= virtualLimit) {
+			control.stopRequested.store(true, std::memory_order_relaxed); // stolen, it ends like any other channel
+			continue;
+		}
+		const bool silent = rank >= realLimit || (this->config.virtualVolume > 0.0f && this->audibility[i] < this->config.virtualVolume);
+		this->voices[index].silent = silent;
+		control.silent.store(silent, std::memory_order_relaxed);
+		(silent ? this->virtualCount : this->realCount)++;
+	}
+}
+
+auto AudioEngineNativeImpl::retireChannels() -> void {
+	i32 channelId = 0;
+	while (this->mixer.takeEnded(channelId)) {
+		ChannelTable::Slot* slot = this->channels.find(channelId);
+		if (!slot || slot->state != ChannelTable::State::playing)
+			continue;
+		this->publish(Audio::PlaybackEventType::channelEnded, channelId, slot->sound);
+		this->channels.release(channelId);
+		if (this->effects.empty())
+			continue;
+		std::erase_if(this->effects, [this, channelId](auto& entry) -> bool { // channel effects go away with their channel
+			if (entry.second.channelId != channelId)
+				return false;
+			this->releaseLater(std::move(entry.second.unit));
+			return true;
+		});
+	}
+}
+
+// anything the mixer might still hold a reference to waits here, so the last release (and the free) happens on this thread
+auto AudioEngineNativeImpl::releaseLater(std::shared_ptr<const void> held) -> void {
+	if (held && held.use_count() > 1)
+		this->released.push_back(std::move(held));
+}
+
+auto AudioEngineNativeImpl::collectReleased() -> void {
+	std::erase_if(this->released, [](const std::shared_ptr<const void>& held) -> bool {
+		return held.use_count() == 1;
+	});
+}
+
+auto AudioEngineNativeImpl::startChannel(i32 channelId, SlotKey key, LoadedSound& loaded, const Audio::Vec3<f32>& pos, f32 volumedB, const Fade& fade) -> void {
+	ChannelTable::Slot* slot = this->channels.claim(channelId);
+	if (!slot) return;
+	loaded.lastUsed = this->useClock;
+	auto start = Clock::now();
+	const u32 index = static_cast<u32>(channelId) & 0xFFFF;
+	Voice& voice = this->voices[index];
+	voice = Voice{ pos, Audio::dBToVolume(volumedB), loaded.space3d, loaded.priority, false };
+	NativeMixer::VoiceControl& control = this->mixer.control(channelId);
+	control.stopRequested.store(false, std::memory_order_relaxed);
+	control.silent.store(false, std::memory_order_relaxed);
+	control.position.store(0, std::memory_order_relaxed);
+	f32 left, right; // updateVoices keeps these current, this is just so the very first block is right
+	this->voiceGains(voice, Audio::distance(pos, this->listenerPos), left, right);
+	control.left.store(left, std::memory_order_relaxed);
+	control.right.store(right, std::memory_order_relaxed);
+
+	NativeMixer::StartVoice command{ channelId, loaded.data, 0, 0 };
+	if (fade.fromChannelId != 0) {
+		// the same schedule as the fmod side, on the mixer's clock: the overlap ends right where the outgoing sound runs out
+		ChannelTable::Slot* from = this->channels.find(fade.fromChannelId);
+		if (from && from->state == ChannelTable::State::waiting)
+			this->stopChannel(fade.fromChannelId); // still waiting on its own load, it never gets to play
+		else if (from) {
+			u64 now = 0;
+			const u64 position = this->mixer.getPosition(fade.fromChannelId, now);
+			const u64 earliest = now + 2ull * NativeMixer::blockFrames; // the mixer may already be on the block after now
+			const u64 length = static_cast<u64>(fade.lengthMs) * NativeMixer::sampleRate / 1000;
+			u64 end = earliest + length; // looping, so it fades out from now instead
+			const LoadedSound* outgoing = this->sounds.get(from->sound);
+			if (outgoing && outgoing->data && !outgoing->looping) {
+				const u64 remaining = outgoing->data->frames > position ? outgoing->data->frames - position : 0;
+				end = std::max<u64>(now + remaining * NativeMixer::sampleRate / std::max(outgoing->data->sampleRate, 1u), earliest);
+			}
+			const u64 begin = end - std::min(length, end - earliest); // asked for too late to fit the whole fade, so it's shorter
+			command.startClock = begin;
+			command.fadeInEnd = end;
+			this->mixer.send(NativeMixer::FadeOutVoice{ fade.fromChannelId, begin, end });
+		}
+	}
+	if (!this->mixer.send(std::move(command))) {
+		this->stats.playsFailed++;
+		this->channels.release(channelId);
+		this->publish(Audio::PlaybackEventType::playFailed, channelId, key);
+		return;
+	}
+	slot->sound = key;
+	this->channels.setState(*slot, ChannelTable::State::playing);
+	for (auto& [effectId, effect] : this->effects) { // ones added while it was waiting on a load, after the start in the ring
+		if (effect.channelId == channelId && !effect.attached)
+			effect.attached = this->mixer.send(NativeMixer::AddEffect{ effectId, channelId, effect.unit });
+	}
+	this->stats.playSound.record(elapsedNs(start));
+}
+
+auto AudioEngineNativeImpl::execute(AudioCommand& command) -> void {
+	std::visit([this](auto& cmd) -> void {
+		using T = std::decay_t<decltype(cmd)>;
+		if constexpr (std::is_same_v<T, AudioCommands::LoadSound>)
+			this->loadSound(cmd.key, cmd.path, cmd.soundName, cmd.space3d, cmd.looping, cmd.mode, cmd.fileBytes);
+		else if constexpr (std::is_same_v<T, AudioCommands::LoadSoundAsync>)
+			this->loadSoundAsync(cmd.key, cmd.path, cmd.soundName, cmd.space3d, cmd.looping, cmd.mode, cmd.fileBytes, std::move(cmd.onLoaded));
+		else if constexpr (std::is_same_v<T, AudioCommands::AwaitLoad>)
+			this->awaitLoad(cmd.key, std::move(cmd.onLoaded));
+		else if constexpr (std::is_same_v<T, AudioCommands::UnloadSound>)
+			this->unloadSound(cmd.key);
+		else if constexpr (std::is_same_v<T, AudioCommands::SetListener>)
+			this->set3dListenerAndOrientation(cmd.pos, cmd.look, cmd.up);
+		else if constexpr (std::is_same_v<T, AudioCommands::PlaySound>)
+			this->playSound(cmd.channelId, cmd.key, cmd.pos, cmd.volumedB);
+		else if constexpr (std::is_same_v<T, AudioCommands::PlayWhenReady>)
+			this->playWhenReady(cmd.channelId, cmd.key, cmd.pos, cmd.volumedB);
+		else if constexpr (std::is_same_v<T, AudioCommands::Crossfade>)
+			this->playWhenReady(cmd.channelId, cmd.key, Audio::Vec3<f32>{ 0, 0, 0 }, cmd.volumedB, Fade{ cmd.fromChannelId, cmd.fadeMs });
+		else if constexpr (std::is_same_v<T, AudioCommands::StopChannel>)
+			this->stopChannel(cmd.channelId);
+		else if constexpr (std::is_same_v<T, AudioCommands::StopAllChannels>)
+			this->stopAllChannels();
+		else if constexpr (std::is_same_v<T, AudioCommands::SetChannel3dPosition>)
+			this->setChannel3dPosition(cmd.channelId, cmd.pos, cmd.sequence);
+		else if constexpr (std::is_same_v<T, AudioCommands::SetChannelVolume>)
+			this->setChannelVolume(cmd.channelId, cmd.volumedB, cmd.sequence);
+		else if constexpr (std::is_same_v<T, AudioCommands::SetSoundPriority>)
+			this->setSoundPriority(cmd.key, cmd.priority);
+		else if constexpr (std::is_same_v<T, AudioCommands::AddEffect>)
+			this->addEffect(cmd.effectId, std::move(cmd.unit), cmd.channelId);
+		else if constexpr (std::is_same_v<T, AudioCommands::RemoveEffect>)
+			this->removeEffect(cmd.effectId);
+	}, command);
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "Vec.hpp"
+#include "AudioEngineCore.hpp"
+#include "NativeMixer.hpp"
+#include "NativeDecoder.hpp"
+#include "SlotMap.hpp"
+#include "PoolAllocator.hpp"
+#include "SoundInfo.hpp"
+#include "SoundInfoImpl.hpp"
+#include "DspUnit.hpp"
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <unordered_map>
+
+/*
+	the same engine with our own decoding and mixing in place of fmod's. the owner thread does everything fmod's
+	system->update() would: loads, channel bookkeeping, 3d gains and choosing which voices are real. NativeMixer only
+	ever sees finished gains and flags. sounds are always decoded whole on a loader thread, stream is accepted and ignored
+*/
+struct AudioEngineNativeImpl : AudioEngineCore {
+	static constexpr const f32 minDistance = 1.0f; // fmod's defaults, so 3d sounds fall off the same on both backends
+	static constexpr const f32 maxDistance = 10000.0f;
+
+	struct LoadedSound {
+		std::shared_ptr<const NativeSoundData> data; // null while loading
+		std::string name;
+		bool ready = false;
+		bool space3d = false;
+		bool looping = false;
+		u64 memoryBytes = 0;
+		SoundInfoImpl details; // copied into each getPlayingSound
+		std::unique_ptr<Audio::SoundInfo> info;
+		Clock::time_point requested{};
+		i32 priority = defaultPriority;
+		u64 lastUsed = 0; // useClock as of its last load, play or live channel, for the memory budget
+		std::vector<WaitingPlay> waitingPlays;
+		std::vector<std::function<void(bool)>> callbacks;
+	};
+
+	// the owner's side of a playing channel, by table index like the mixer's controls
+	struct Voice {
+		Audio::Vec3<f32> pos{ 0, 0, 0 };
+		f32 volume = 1.0f; // linear
+		bool space3d = false;
+		i32 priority = defaultPriority;
+		bool silent = false; // what the mixer was last told
+	};
+
+	struct Effect {
+		std::shared_ptr<Audio::DspUnit> unit;
+		i32 channelId = 0; // 0 for the main bus
+		bool attached = false; // false while its channel is still waiting on a load
+	};
+
+	struct LoadJob {
+		SlotKey key;
+		std::string path;
+		PackedFile packed; // looked up when it's queued, so a pack mounted later doesn't change what was asked for
+	};
+	struct LoadResult {
+		SlotKey key;
+		std::string path;
+		bool loaded = false;
+		DecodedSound decoded;
+	};
+
+	typedef SlotMap<LoadedSound> SoundMap;
+
+	AudioEngineNativeImpl(const Audio::AudioEngineConfig& config = Audio::AudioEngineConfig{});
+	~AudioEngineNativeImpl() override;
+
+	auto update() -> void override;
+	auto loadSound(SlotKey key, const std::string& path, const std::string& soundName, bool space3d, bool looping, Audio::LoadMode mode, u64 fileBytes) -> bool override;
+	auto getStats() -> Audio::EngineStats override;
+	auto isVirtual(i32 channelId) -> bool override;
+	auto getPlayingSound(i32 channelId) -> std::optional<Audio::SoundInfo> override;
+	auto getPlaybackPosition(i32 channelId) -> std::optional<Audio::PlaybackPosition> override;
+	auto getSoundInfo(SlotKey key) -> const Audio::SoundInfo* override;
+	auto getLoadState(SlotKey key) -> Audio::LoadState override;
+	auto getSoundMemoryUsage(SlotKey key) -> u64 override;
+	auto getFileStats() -> std::vector<Audio::FileStats> override;
+	auto getRenderedTime() -> std::chrono::microseconds override;
+
+	// same set as the fmod backend. only call from the thread that owns the impl
+	auto loadSoundAsync(SlotKey key, const std::string& path, const std::string& soundName, bool space3d, bool looping, Audio::LoadMode mode, u64 fileBytes, std::function<void(bool)>&& onLoaded) -> void;
+	auto awaitLoad(SlotKey key, std::function<void(bool)>&& onLoaded) -> void;
+	auto unloadSound(SlotKey key) -> void override;
+	auto set3dListenerAndOrientation(const Audio::Vec3<f32>& pos, const Audio::Vec3<f32>& look, const Audio::Vec3<f32>& up) -> void;
+	auto playSound(i32 channelId, SlotKey key, const Audio::Vec3<f32>& pos, f32 volumedB) -> void;
+	auto playWhenReady(i32 channelId, SlotKey key, const Audio::Vec3<f32>& pos, f32 volumedB, const Fade& fade = Fade{}) -> void;
+	auto stopChannel(i32 channelId) -> void;
+	auto stopAllChannels() -> void;
+	auto setChannel3dPosition(i32 channelId, const Audio::Vec3<f32>& pos, u32 sequence) -> void;
+	auto setChannelVolume(i32 channelId, f32 volumedB, u32 sequence) -> void;
+	auto setSoundPriority(SlotKey key, i32 priority) -> void;
+	auto addEffect(i32 effectId, std::shared_ptr<Audio::DspUnit>&& unit, i32 channelId) -> void;
+	auto removeEffect(i32 effectId) -> void;
+
+	NativeMixer mixer;
+	SoundMap sounds;
+	std::vector<Voice> voices; // by table index
+	std::unordered_map<i32, Effect, std::hash<i32>, std::equal_to<i32>, PoolStlAllocator<std::pair<const i32, Effect>>> effects; // owner only
+	Audio::Vec3<f32> listenerPos;
+	Audio::Vec3<f32> listenerLook;
+	Audio::Vec3<f32> listenerUp;
+	i32 realCount; // from the last update's voice pass
+	i32 virtualCount;
+
+protected:
+	auto execute(AudioCommand& command) -> void override;
+
+private:
+	static auto toSoundData(DecodedSound& decoded, bool looping) -> std::shared_ptr<const NativeSoundData>;
+	static auto toDetails(const std::string& path, const DecodedSound& decoded) -> SoundInfoImpl;
+	static auto decode(const std::string& path, const PackedFile& packed, DecodedSound& out) -> bool;
+	auto finishLoad(SlotKey key, LoadResult* result) -> void; // null result means it failed
+	auto pollLoads() -> void;
+	auto runLoader(std::stop_token stop) -> void;
+	auto applyPositionBatch() -> void;
+	auto applyVolumeBatch() -> void;
+	auto updateVoices() -> void;
+	auto voiceGains(const Voice& voice, f32 distance, f32& left, f32& right) const -> void;
+	auto retireChannels() -> void;
+	auto releaseLater(std::shared_ptr<const void> held) -> void;
+	auto collectReleased() -> void;
+	auto startChannel(i32 channelId, SlotKey key, LoadedSound& loaded, const Audio::Vec3<f32>& pos, f32 volumedB, const Fade& fade = Fade{}) -> void;
+
+	std::mutex loadLock; // guards the two queues below
+	std::condition_variable_any loadSignal;
+	std::deque<LoadJob> loadJobs;
+	std::vector<LoadResult> loadResults;
+	std::vector<std::shared_ptr<const void>> released; // things the mixer might still hold, freed here once it lets go
+	std::vector<u32> order; // scratch for updateVoices: table indices of playing voices
+	std::vector<u32> ranking; // positions in order, most important first
+	std::vector<f32> xs, ys, zs, distances, audibility; // one per entry in order
+	std::unique_ptr<std::jthread> loader; // last, so it stops before anything it touches goes away
+};
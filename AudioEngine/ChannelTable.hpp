@@ -0,0 +1,139 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "IndexPool.hpp"
+#include "SlotMap.hpp"
+
+#include <vector>
+#include <atomic>
+#include <memory>
+
+/*
+	every channel the engine knows about lives in one fixed size table, addressed straight from its id.
+	ids are (generation << 16) | index, so they still fit in the i32 the public api hands out, a lookup
+	is a mask and a compare, and an old id never matches whatever took its slot afterwards.
+
+	ids get handed out on the caller's thread (acquireId, lock-free). everything else belongs to the
+	thread that owns the engine. channels leave the table when the backend says they ended, not by polling.
+	nothing backend specific lives in a slot, each backend keeps its own per channel state by the same index.
+*/
+class ChannelTable {
+public:
+	constexpr const static u32 maxCapacity = 0xFFFF;
+
+	enum struct State : u8 {
+		free = 0,
+		waiting = 1, // playWhenReady on a sound that's still opening
+		playing = 2
+	};
+
+	struct Slot {
+		i32 channelId = 0;
+		State state = State::free;
+		SlotKey sound{}; // what it's playing or waiting on
+		u32 batchStamp = 0; // last position batch that moved it, so only the newest entry per channel gets applied
+		u32 volumeStamp = 0; // same thing for volume batches
+		u32 positionWrite = 0; // sequence of the newest position that landed, batch or not, so an older batch entry can't undo it
+		u32 volumeWrite = 0; // same thing for volume
+	};
+
+	explicit ChannelTable(u32 requestedCapacity) :
+		capacity{requestedCapacity < maxCapacity ? requestedCapacity : maxCapacity},
+		slots(capacity),
+		generations{std::make_unique<std::atomic<u16>[]>(capacity)},
+		indices{capacity},
+		active{0}
+	{
+		for (u32 i = 0; i < this->capacity; i++)
+			this->generations[i].store(1, std::memory_order_relaxed);
+	}
+
+	// any thread. 0 if every slot is taken
+	auto acquireId() -> i32 {
+		u32 index = this->indices.pop();
+		if (index == IndexPool::npos)
+			return 0;
+		u16 generation = this->generations[index].load(std::memory_order_acquire);
+		return static_cast<i32>((static_cast<u32>(generation) << 16) | index);
+	}
+
+	// any thread, for ids that were never claimed (the command carrying them got dropped)
+	auto abandonId(i32 channelId) -> void {
+		this->recycle(static_cast<u32>(channelId) & 0xFFFF);
+	}
+
+	// owner thread from here down
+	auto claim(i32 channelId) -> Slot* {
+		u32 index = static_cast<u32>(channelId) & 0xFFFF;
+		if (channelId <= 0 || index >= this->capacity) return nullptr;
+		Slot& slot = this->slots[index];
+		slot.channelId = channelId;
+		return &slot;
+	}
+
+	auto find(i32 channelId) -> Slot* {
+		u32 index = static_cast<u32>(channelId) & 0xFFFF;
+		if (channelId <= 0 || index >= this->capacity) return nullptr;
+		Slot& slot = this->slots[index];
+		if (slot.channelId != channelId || slot.state == State::free) return nullptr;
+		return &slot;
+	}
+
+	auto setState(Slot& slot, State state) -> void {
+		if (slot.state == State::free && state != State::free)
+			this->active++;
+		slot.state = state;
+	}
+
+	// slot goes back to free and the id stops matching. fine on an id that was never claimed too
+	auto release(i32 channelId) -> void {
+		u32 index = static_cast<u32>(channelId) & 0xFFFF;
+		if (channelId <= 0 || index >= this->capacity) return;
+		Slot& slot = this->slots[index];
+		if (slot.channelId != channelId) {
+			// the slot still has whoever held the index before. the generation tells a live unclaimed id
+			// (recycle it, or the index is gone for good) from one that's already been released
+			if (this->generations[index].load(std::memory_order_relaxed) == (static_cast<u32>(channelId) >> 16))
+				this->recycle(index);
+			return;
+		}
+		if (slot.state != State::free)
+			this->active--;
+		slot = Slot{};
+		this->recycle(index);
+	}
+
+	// func(Slot&) for every waiting or playing slot
+	template <typename Func>
+	auto forEachActive(Func&& func) -> void {
+		for (auto& slot : this->slots) {
+			if (slot.state != State::free)
+				func(slot);
+		}
+	}
+
+	auto activeCount() const -> u32 {
+		return this->active;
+	}
+
+	auto getCapacity() const -> u32 {
+		return this->capacity;
+	}
+
+private:
+	auto recycle(u32 index) -> void {
+		u16 generation = this->generations[index].load(std::memory_order_relaxed);
+		generation = (generation + 1) & 0x7FFF; // 15 bits so ids stay positive
+		if (generation == 0)
+			generation = 1;
+		this->generations[index].store(generation, std::memory_order_release);
+		this->indices.push(index);
+	}
+
+	u32 capacity;
+	std::vector<Slot> slots;
+	std::unique_ptr<std::atomic<u16>[]> generations;
+	IndexPool indices;
+	u32 active;
+};
@@ -0,0 +1,243 @@
+
+#include "pch.h"
+
+#include "DspUnit.hpp"
+#include "VecMath.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <span>
+#include <vector>
+
+namespace {
+	// one pole smoothing coefficient for a time constant, 0 means jump straight there
+	auto timeCoefficient(f32 ms, u32 sampleRate) -> f32 {
+		if (ms <= 0.0f || sampleRate == 0)
+			return 0.0f;
+		return static_cast<f32>(std::exp(-1000.0 / (static_cast<f64>(ms) * sampleRate)));
+	}
+
+	// transposed direct form 2, the usual choice for float biquads. coefficients are normalized by a0
+	struct Biquad {
+		f32 b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+		bool active = false; // a 0dB band is a passthrough, skip it
+
+		auto run(f32* samples, u32 frames, i32 channels, i32 channel, std::array<f32, 2>& state) const -> void {
+			f32 z1 = state[0], z2 = state[1];
+			for (u32 f = 0; f < frames; f++) {
+				f32& sample = samples[f * channels + channel];
+				f32 x = sample;
+				f32 y = this->b0 * x + z1;
+				z1 = this->b1 * x - this->a1 * y + z2;
+				z2 = this->b2 * x - this->a2 * y;
+				sample = y;
+			}
+			state[0] = z1;
+			state[1] = z2;
+		}
+	};
+
+	enum struct BandShape : u8 {
+		lowShelf = 0,
+		peaking = 1,
+		highShelf = 2
+	};
+
+	// from the rbj audio eq cookbook, shelves use a slope of 1
+	auto designBand(BandShape shape, f64 frequency, f64 gaindB, f64 q, u32 sampleRate) -> Biquad {
+		Biquad band{};
+		if (std::fabs(gaindB) < 0.01 || sampleRate == 0)
+			return band;
+		frequency = std::clamp(frequency, 10.0, 0.45 * sampleRate);
+		q = std::max(q, 0.05);
+		const f64 a = std::pow(10.0, gaindB / 40.0);
+		const f64 w0 = 2.0 * std::numbers::pi * frequency / sampleRate;
+		const f64 cosW = std::cos(w0);
+		const f64 sinW = std::sin(w0);
+		f64 b0, b1, b2, a0, a1, a2;
+		if (shape == BandShape::peaking) {
+			const f64 alpha = sinW / (2.0 * q);
+			b0 = 1.0 + alpha * a;
+			b1 = -2.0 * cosW;
+			b2 = 1.0 - alpha * a;
+			a0 = 1.0 + alpha / a;
+			a1 = -2.0 * cosW;
+			a2 = 1.0 - alpha / a;
+		}
+		else {
+			const f64 shelf = 2.0 * std::sqrt(a) * (sinW / 2.0 * std::numbers::sqrt2);
+			const f64 sign = shape == BandShape::lowShelf ? 1.0 : -1.0; // the high shelf is the low one mirrored
+			b0 = a * ((a + 1.0) - sign * (a - 1.0) * cosW + shelf);
+			b1 = sign * 2.0 * a * ((a - 1.0) - sign * (a + 1.0) * cosW);
+			b2 = a * ((a + 1.0) - sign * (a - 1.0) * cosW - shelf);
+			a0 = (a + 1.0) + sign * (a - 1.0) * cosW + shelf;
+			a1 = -sign * 2.0 * ((a - 1.0) + sign * (a + 1.0) * cosW);
+			a2 = (a + 1.0) + sign * (a - 1.0) * cosW - shelf;
+		}
+		band.b0 = static_cast<f32>(b0 / a0);
+		band.b1 = static_cast<f32>(b1 / a0);
+		band.b2 = static_cast<f32>(b2 / a0);
+		band.a1 = static_cast<f32>(a1 / a0);
+		band.a2 = static_cast<f32>(a2 / a0);
+		band.active = true;
+		return band;
+	}
+
+	// low shelf, one peaking band, high shelf
+	class Equalizer : public Audio::DspUnit {
+	public:
+		Equalizer() {
+			this->setParameter(Audio::EqualizerParameter::lowFrequency, 100.0f);
+			this->setParameter(Audio::EqualizerParameter::lowGaindB, 0.0f);
+			this->setParameter(Audio::EqualizerParameter::midFrequency, 1000.0f);
+			this->setParameter(Audio::EqualizerParameter::midGaindB, 0.0f);
+			this->setParameter(Audio::EqualizerParameter::midQ, 0.707f);
+			this->setParameter(Audio::EqualizerParameter::highFrequency, 8000.0f);
+			this->setParameter(Audio::EqualizerParameter::highGaindB, 0.0f);
+		}
+
+		auto prepare(u32 sampleRate, u32 maxFrames) -> void override {
+			this->sampleRate = sampleRate;
+			for (auto& band : this->state)
+				band.fill(std::array<f32, 2>{});
+			this->design();
+		}
+
+		auto process(const f32* in, f32* out, u32 frames, i32 channels) -> void override {
+			if (this->parametersChanged())
+				this->design(); // keeps the filter state, so a sweep doesn't click
+			std::memcpy(out, in, static_cast<size_t>(frames) * channels * sizeof(f32));
+			for (size_t b = 0; b < bandCount; b++) {
+				if (!this->bands[b].active) continue;
+				for (i32 c = 0; c < channels; c++)
+					this->bands[b].run(out, frames, channels, c, this->state[b][c]);
+			}
+		}
+
+	private:
+		static constexpr const size_t bandCount = 3;
+
+		auto design() -> void {
+			using Parameter = Audio::EqualizerParameter;
+			this->bands[0] = designBand(BandShape::lowShelf, this->getParameter(Parameter::lowFrequency), this->getParameter(Parameter::lowGaindB), 0.707, this->sampleRate);
+			this->bands[1] = designBand(BandShape::peaking, this->getParameter(Parameter::midFrequency), this->getParameter(Parameter::midGaindB), this->getParameter(Parameter::midQ), this->sampleRate);
+			this->bands[2] = designBand(BandShape::highShelf, this->getParameter(Parameter::highFrequency), this->getParameter(Parameter::highGaindB), 0.707, this->sampleRate);
+		}
+
+		u32 sampleRate = 0;
+		std::array<Biquad, bandCount> bands{};
+		std::array<std::array<std::array<f32, 2>, maxChannels>, bandCount> state{};
+	};
+
+	/*
+		shared by the compressor and limiter. works a block at a time in dB: the per frame peaks and both dB conversions
+		are the bulk VecMath kernels, only the envelope follower in between has to go frame by frame
+	*/
+	class Dynamics : public Audio::DspUnit {
+	public:
+		auto prepare(u32 sampleRate, u32 maxFrames) -> void override {
+			this->sampleRate = sampleRate;
+			this->levels.assign(maxFrames, 0.0f);
+			this->gains.assign(maxFrames, 1.0f);
+			this->envelopedB = 0.0f;
+			this->settings = this->readSettings();
+		}
+
+		auto process(const f32* in, f32* out, u32 frames, i32 channels) -> void override {
+			if (this->parametersChanged())
+				this->settings = this->readSettings();
+			const size_t samples = static_cast<size_t>(frames) * channels;
+			std::span<f32> levels(this->levels.data(), frames);
+			std::span<f32> gains(this->gains.data(), frames);
+			Audio::framePeaks(std::span<const f32>(in, samples), channels, levels);
+			Audio::volumeTodB(levels, levels); // silence comes out as -inf, which never goes over
+			f32 envelope = this->envelopedB;
+			for (auto& level : levels) {
+				f32 over = level - this->settings.thresholddB;
+				f32 target = over > 0.0f ? -over * this->settings.slope : 0.0f;
+				f32 coefficient = target < envelope ? this->settings.attack : this->settings.release;
+				envelope = target + coefficient * (envelope - target);
+				level = envelope + this->settings.makeupdB;
+			}
+			this->envelopedB = envelope;
+			Audio::dBToVolume(levels, gains);
+			Audio::applyFrameGains(std::span<const f32>(in, samples), channels, gains, std::span<f32>(out, samples));
+		}
+
+	protected:
+		struct Settings {
+			f32 thresholddB = 0.0f;
+			f32 slope = 0.0f; // 1 - 1/ratio, how much of the overshoot gets taken off
+			f32 attack = 0.0f;
+			f32 release = 0.0f;
+			f32 makeupdB = 0.0f;
+		};
+		virtual auto readSettings() -> Settings = 0;
+
+		u32 sampleRate = 0;
+
+	private:
+		Settings settings{};
+		f32 envelopedB = 0.0f; // current gain reduction, <= 0
+		std::vector<f32> levels;
+		std::vector<f32> gains;
+	};
+
+	class Compressor : public Dynamics {
+	public:
+		Compressor() {
+			this->setParameter(Audio::CompressorParameter::thresholddB, -18.0f);
+			this->setParameter(Audio::CompressorParameter::ratio, 4.0f);
+			this->setParameter(Audio::CompressorParameter::attackMs, 10.0f);
+			this->setParameter(Audio::CompressorParameter::releaseMs, 150.0f);
+			this->setParameter(Audio::CompressorParameter::makeupdB, 0.0f);
+		}
+
+	protected:
+		auto readSettings() -> Settings override {
+			using Parameter = Audio::CompressorParameter;
+			return Settings{
+				.thresholddB = this->getParameter(Parameter::thresholddB),
+				.slope = 1.0f - 1.0f / std::max(this->getParameter(Parameter::ratio), 1.0f),
+				.attack = timeCoefficient(this->getParameter(Parameter::attackMs), this->sampleRate),
+				.release = timeCoefficient(this->getParameter(Parameter::releaseMs), this->sampleRate),
+				.makeupdB = this->getParameter(Parameter::makeupdB)
+			};
+		}
+	};
+
+	class Limiter : public Dynamics {
+	public:
+		Limiter() {
+			this->setParameter(Audio::LimiterParameter::ceilingdB, -1.0f);
+			this->setParameter(Audio::LimiterParameter::releaseMs, 50.0f);
+		}
+
+	protected:
+		auto readSettings() -> Settings override {
+			return Settings{
+				.thresholddB = this->getParameter(Audio::LimiterParameter::ceilingdB),
+				.slope = 1.0f, // infinite ratio
+				.attack = 0.0f, // instant, see LimiterParameter
+				.release = timeCoefficient(this->getParameter(Audio::LimiterParameter::releaseMs), this->sampleRate),
+				.makeupdB = 0.0f
+			};
+		}
+	};
+};
+
+namespace Audio {
+	auto makeEqualizer() -> std::shared_ptr<DspUnit> {
+		return std::make_shared<Equalizer>();
+	}
+
+	auto makeCompressor() -> std::shared_ptr<DspUnit> {
+		return std::make_shared<Compressor>();
+	}
+
+	auto makeLimiter() -> std::shared_ptr<DspUnit> {
+		return std::make_shared<Limiter>();
+	}
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+
+#ifndef _WIN32
+#define AUDIOENGINE_API
+#elif defined(AUDIOENGINE_EXPORTS)
+#define AUDIOENGINE_API __declspec(dllexport)
+#else
+#define AUDIOENGINE_API __declspec(dllimport)
+#endif
+
+/*
+	our own processing inside fmod's mixer. a unit is handed to AudioEngine::addEffect, which wraps it in an fmod dsp
+	so process() gets fmod's buffers directly, no extra copies. process runs on fmod's mixer thread, so it must not
+	lock or allocate, anything it needs gets sized in prepare. parameters are atomics so any thread can set them
+	without waiting on the mixer, process picks the change up at the start of its next block.
+	one unit per effect, the same unit added twice would have two mixer threads sharing its state.
+*/
+namespace Audio {
+	class DspUnit {
+	public:
+		static constexpr const u32 maxParameters = 16;
+		static constexpr const i32 maxChannels = 8; // 7.1. anything wider is passed through untouched
+
+		virtual ~DspUnit() = default;
+
+		// owner thread, before the unit joins the mixer. sampleRate and maxFrames are the mixer's
+		virtual auto prepare(u32 sampleRate, u32 maxFrames) -> void = 0;
+		// mixer thread. interleaved, frames <= maxFrames, channels <= maxChannels, in and out never overlap
+		virtual auto process(const f32* in, f32* out, u32 frames, i32 channels) -> void = 0;
+
+		auto setParameter(u32 index, f32 value) -> void { // any thread
+			if (index >= maxParameters) return;
+			this->parameters[index].store(value, std::memory_order_relaxed);
+			this->parameterVersion.fetch_add(1, std::memory_order_release);
+		}
+		auto getParameter(u32 index) const -> f32 {
+			return index < maxParameters ? this->parameters[index].load(std::memory_order_relaxed) : 0.0f;
+		}
+		template <typename Parameter> requires std::is_enum_v<Parameter>
+		auto setParameter(Parameter parameter, f32 value) -> void {
+			this->setParameter(static_cast<u32>(parameter), value);
+		}
+		template <typename Parameter> requires std::is_enum_v<Parameter>
+		auto getParameter(Parameter parameter) const -> f32 {
+			return this->getParameter(static_cast<u32>(parameter));
+		}
+
+	protected:
+		// mixer thread. true once after any setParameter, and on the very first block
+		auto parametersChanged() -> bool {
+			u32 version = this->parameterVersion.load(std::memory_order_acquire);
+			if (version == this->seenVersion)
+				return false;
+			this->seenVersion = version;
+			return true;
+		}
+
+	private:
+		std::array<std::atomic<f32>, maxParameters> parameters{};
+		std::atomic<u32> parameterVersion{1};
+		u32 seenVersion = 0;
+	};
+
+	// built in units. parameters are set through the enums below, the comments are the defaults
+
+	enum struct EqualizerParameter : u32 {
+		lowFrequency = 0, // 100hz, low shelf corner
+		lowGaindB = 1, // 0
+		midFrequency = 2, // 1000hz, peaking band center
+		midGaindB = 3, // 0
+		midQ = 4, // 0.707
+		highFrequency = 5, // 8000hz, high shelf corner
+		highGaindB = 6 // 0
+	};
+
+	enum struct CompressorParameter : u32 {
+		thresholddB = 0, // -18
+		ratio = 1, // 4, as in 4:1
+		attackMs = 2, // 10
+		releaseMs = 3, // 150
+		makeupdB = 4 // 0
+	};
+
+	// no lookahead, gain drops on the same frame that goes over, so the output never passes the ceiling
+	enum struct LimiterParameter : u32 {
+		ceilingdB = 0, // -1
+		releaseMs = 1 // 50
+	};
+
+	AUDIOENGINE_API auto makeEqualizer() -> std::shared_ptr<DspUnit>;
+	AUDIOENGINE_API auto makeCompressor() -> std::shared_ptr<DspUnit>;
+	AUDIOENGINE_API auto makeLimiter() -> std::shared_ptr<DspUnit>;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <array>
+#include <bit>
+
+namespace Audio {
+	// power of 2 buckets over nanoseconds, bucket i holds [2^(i-1), 2^i). recording is a bit_width and two adds,
+	// so it stays on in release builds. percentiles come back as a bucket's upper bound, good to within 2x
+	struct LatencyHistogram {
+		static constexpr const u32 bucketCount = 40; // the last one catches anything past ~9 minutes
+		u64 count = 0;
+		u64 totalNs = 0;
+		u64 maxNs = 0;
+		std::array<u64, bucketCount> buckets{};
+
+		auto record(u64 ns) -> void {
+			u32 bucket = static_cast<u32>(std::bit_width(ns));
+			this->buckets[bucket < bucketCount ? bucket : bucketCount - 1]++;
+			this->count++;
+			this->totalNs += ns;
+			if (ns > this->maxNs)
+				this->maxNs = ns;
+		}
+		auto meanNs() const -> u64 {
+			return this->count ? this->totalNs / this->count : 0;
+		}
+		auto percentileNs(f64 p) const -> u64 {
+			if (this->count == 0)
+				return 0;
+			u64 target = static_cast<u64>(p * static_cast<f64>(this->count - 1)) + 1;
+			u64 seen = 0;
+			for (u32 i = 0; i < bucketCount; i++) {
+				seen += this->buckets[i];
+				if (seen >= target)
+					return i == 0 ? 0 : (1ull << i) - 1;
+			}
+			return this->maxNs;
+		}
+	};
+
+	// a snapshot from AudioEngine::getStats(). plain values only, same reason as AudioEngineConfig
+	struct EngineStats {
+		LatencyHistogram loadSound; // blocking loads: the whole open. async loads: request to ready
+		LatencyHistogram playSound; // starting a channel on fmod, not counting any wait for a load
+		LatencyHistogram update;
+		LatencyHistogram fileRead; // fmod's reads through our i/o (AudioEngineConfig::ioThreads), request to done
+		u64 loadsFailed = 0;
+		u64 playsFailed = 0; // unknown or unloaded sound, or fmod refused the channel
+		u64 commandsDropped = 0; // commandQueue mode only, the ring was full
+		u64 eventsDropped = 0; // pollEvent wasn't called for long enough that the event queue filled up
+		u64 soundsEvicted = 0; // idle sounds unloaded to stay under the memory budget
+		u64 streamedLoads = 0; // loads by the mode they were opened with, whether the caller or the load policy picked it
+		u64 compressedLoads = 0;
+		u64 decompressedLoads = 0;
+		u32 soundsLoaded = 0; // includes ones still opening
+		u32 channelsActive = 0; // playing or waiting on a load
+		i32 channelsReal = 0; // being mixed right now
+		i32 channelsVirtual = 0; // playing but virtualized by fmod
+		f32 cpuDsp = 0.0f; // percent of one core, from fmod
+		f32 cpuStream = 0.0f;
+		f32 cpuUpdate = 0.0f;
+		f32 cpuGeometry = 0.0f;
+		u64 soundMemoryBytes = 0; // our estimate, summed over loaded sounds
+		u64 mappedPackBytes = 0; // mounted asset packs. shared with the os page cache, sounds opened from them don't count their bytes above
+		i32 fmodMemoryBytes = 0; // what fmod's allocator has out right now
+		i32 fmodMemoryPeakBytes = 0;
+		u64 poolBytes = 0; // AudioEngineConfig::memoryPoolBytes, rounded down to whole pages. 0 if there's no pool
+		u64 poolCarvedBytes = 0; // pages handed to a size class so far
+		u64 poolUsedBytes = 0; // live blocks, at their rounded up sizes
+		u64 poolPeakBytes = 0;
+		u64 poolFallbacks = 0; // allocations that were too big for the pool or found it full, and went to the system heap
+		f32 poolFragmentation = 0.0f; // share of the carved pages sitting free, where only their own size class can use them
+		u64 fileReadAheadHits = 0; // fileRead samples served from memory that was read ahead
+		u64 fileDiskBytes = 0; // read off disk for fmod, read-ahead included
+	};
+};
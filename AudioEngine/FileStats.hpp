@@ -0,0 +1,21 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <string>
+
+namespace Audio {
+	// what AudioEngine::getFileStats reports per file read through the engine's own i/o (AudioEngineConfig::ioThreads).
+	// kept by path for the engine's whole life, so a stream that's been reopened adds up across opens
+	struct FileStats {
+		std::string path;
+		u32 opens = 0;
+		u32 failedReads = 0; // the os read errored, fmod got FMOD_ERR_FILE_BAD
+		u64 reads = 0; // requests from fmod
+		u64 readAheadHits = 0; // served straight from memory, never waited on the disk
+		u64 bytesServed = 0; // handed to fmod
+		u64 diskBytes = 0; // actually read, read-ahead included
+		u64 meanLatencyNs = 0; // request to done, queue wait included
+		u64 maxLatencyNs = 0;
+	};
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <atomic>
+#include <memory>
+
+/*
+	fixed size pool of indices [0, capacity). lock-free stack (treiber) where the head carries a
+	tag next to the index so a pop racing a pop+push of the same index can't succeed with a stale next.
+	pop and push are both safe from any thread and never allocate.
+*/
+class IndexPool {
+public:
+	constexpr const static u32 npos = 0xFFFFFFFF;
+
+	explicit IndexPool(u32 capacity) :
+		next{std::make_unique<std::atomic<u32>[]>(capacity)},
+		head{capacity > 0 ? 0 : npos}
+	{
+		for (u32 i = 0; i < capacity; i++)
+			this->next[i].store(i + 1 < capacity ? i + 1 : npos, std::memory_order_relaxed);
+	}
+	IndexPool(const IndexPool&) = delete;
+	void operator=(const IndexPool&) = delete;
+
+	// npos when empty
+	auto pop() -> u32 {
+		u64 old = this->head.load(std::memory_order_acquire);
+		for (;;) {
+			u32 index = static_cast<u32>(old);
+			if (index == npos)
+				return npos;
+			u32 following = this->next[index].load(std::memory_order_relaxed);
+			u64 desired = (((old >> 32) + 1) << 32) | following;
+			if (this->head.compare_exchange_weak(old, desired, std::memory_order_acq_rel, std::memory_order_acquire))
+				return index;
+		}
+	}
+
+	auto push(u32 index) -> void {
+		u64 old = this->head.load(std::memory_order_relaxed);
+		for (;;) {
+			this->next[index].store(static_cast<u32>(old), std::memory_order_relaxed);
+			u64 desired = (((old >> 32) + 1) << 32) | index;
+			if (this->head.compare_exchange_weak(old, desired, std::memory_order_release, std::memory_order_relaxed))
+				return;
+		}
+	}
+
+private:
+	std::unique_ptr<std::atomic<u32>[]> next;
+	std::atomic<u64> head; // (tag << 32) | index
+};
@@ -0,0 +1,151 @@
+
+#include "pch.h"
+
+#include "LoudnessMeter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+namespace {
+	constexpr const f64 absoluteGate = -70.0; // LUFS
+	constexpr const f64 relativeGate = -10.0; // LU under the mean of what passed the absolute gate
+	constexpr const f64 loudnessOffset = -0.691; // makes a full scale 1khz sine in one channel read -3.01
+
+	auto toLoudness(f64 meanSquare) -> f64 {
+		return meanSquare > 0.0 ? loudnessOffset + 10.0 * std::log10(meanSquare) : -std::numeric_limits<f64>::infinity();
+	}
+};
+
+/*
+	bs.1770 only lists k-weighting coefficients for 48khz. these are the analog prototypes behind them
+	(the same ones libebur128 uses), so any sample rate comes out matching the spec
+*/
+LoudnessMeter::LoudnessMeter(u32 sampleRate, i32 channels) :
+	channels{std::max(channels, 1)},
+	subBlockFrames{std::max(sampleRate / 10, 1u)},
+	shelf{},
+	highPass{},
+	interpolator{},
+	states(static_cast<size_t>(this->channels))
+{
+	const f64 rate = std::max(sampleRate, 1u);
+	{
+		const f64 f0 = 1681.974450955533, gain = 3.999843853973347, q = 0.7071752369554196;
+		const f64 k = std::tan(std::numbers::pi * f0 / rate);
+		const f64 vh = std::pow(10.0, gain / 20.0);
+		const f64 vb = std::pow(vh, 0.4996667741545416);
+		const f64 a0 = 1.0 + k / q + k * k;
+		this->shelf = Biquad{
+			(vh + vb * k / q + k * k) / a0,
+			2.0 * (k * k - vh) / a0,
+			(vh - vb * k / q + k * k) / a0,
+			2.0 * (k * k - 1.0) / a0,
+			(1.0 - k / q + k * k) / a0
+		};
+	}
+	{
+		const f64 f0 = 38.13547087602444, q = 0.5003270373238773;
+		const f64 k = std::tan(std::numbers::pi * f0 / rate);
+		const f64 a0 = 1.0 + k / q + k * k;
+		this->highPass = Biquad{ 1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+	}
+
+	// hann windowed sinc with its cutoff at the original nyquist. each phase is normalized to unity gain at dc
+	constexpr const u32 taps = oversampling * tapsPerPhase;
+	const f64 center = (taps - 1) / 2.0;
+	for (u32 phase = 0; phase < oversampling; phase++) {
+		f64 sum = 0.0;
+		for (u32 t = 0; t < tapsPerPhase; t++) {
+			const f64 n = static_cast<f64>(t * oversampling + phase);
+			const f64 x = (n - center) / oversampling;
+			const f64 sinc = x == 0.0 ? 1.0 : std::sin(std::numbers::pi * x) / (std::numbers::pi * x);
+			const f64 window = 0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * (n + 0.5) / taps);
+			this->interpolator[phase * tapsPerPhase + t] = static_cast<f32>(sinc * window);
+			sum += sinc * window;
+		}
+		for (u32 t = 0; t < tapsPerPhase; t++)
+			this->interpolator[phase * tapsPerPhase + t] = static_cast<f32>(this->interpolator[phase * tapsPerPhase + t] / sum);
+	}
+
+	if (this->channels == 6) { // 5.1 in fmod's order: L R C LFE Ls Rs
+		this->states[3].weight = 0.0;
+		this->states[4].weight = 1.41;
+		this->states[5].weight = 1.41;
+	}
+}
+
+auto LoudnessMeter::filterSample(ChannelState& state, f64 sample) const -> f64 {
+	const auto run = [](const Biquad& filter, std::array<f64, 2>& z, f64 x) -> f64 {
+		f64 y = filter.b0 * x + z[0];
+		z[0] = filter.b1 * x - filter.a1 * y + z[1];
+		z[1] = filter.b2 * x - filter.a2 * y;
+		return y;
+	};
+	return run(this->highPass, state.highPass, run(this->shelf, state.shelf, sample));
+}
+
+// tap t of a phase lines up with the sample t steps back from the newest
+auto LoudnessMeter::oversampledPeak(const ChannelState& state) const -> f32 {
+	f32 peak = 0.0f;
+	for (u32 phase = 0; phase < oversampling; phase++) {
+		const f32* coefficients = &this->interpolator[phase * tapsPerPhase];
+		f32 value = 0.0f;
+		for (u32 t = 0; t < tapsPerPhase; t++)
+			value += coefficients[t] * state.history[(this->historyIndex + tapsPerPhase - t) % tapsPerPhase];
+		peak = std::max(peak, std::fabs(value));
+	}
+	return peak;
+}
+
+auto LoudnessMeter::add(const f32* interleaved, u32 frames) -> void {
+	for (u32 f = 0; f < frames; f++) {
+		this->historyIndex = (this->historyIndex + 1) % tapsPerPhase;
+		for (i32 c = 0; c < this->channels; c++) {
+			ChannelState& state = this->states[c];
+			const f32 sample = interleaved[static_cast<size_t>(f) * this->channels + c];
+			state.history[this->historyIndex] = sample;
+			this->peak = std::max({ this->peak, std::fabs(sample), this->oversampledPeak(state) });
+			const f64 weighted = this->filterSample(state, sample);
+			this->subBlockSum += state.weight * weighted * weighted;
+		}
+		if (++this->subBlockFill == this->subBlockFrames) {
+			this->subBlocks.push_back(this->subBlockSum / this->subBlockFrames);
+			this->subBlockSum = 0.0;
+			this->subBlockFill = 0;
+		}
+	}
+}
+
+// gating blocks are 400ms long and start every 100ms, so block j is the mean of sub blocks j to j+3
+auto LoudnessMeter::integratedLoudness() const -> f32 {
+	if (this->subBlocks.size() < 4)
+		return -std::numeric_limits<f32>::infinity();
+	std::vector<f64> blocks;
+	blocks.reserve(this->subBlocks.size() - 3);
+	for (size_t j = 0; j + 3 < this->subBlocks.size(); j++) {
+		f64 meanSquare = (this->subBlocks[j] + this->subBlocks[j + 1] + this->subBlocks[j + 2] + this->subBlocks[j + 3]) / 4.0;
+		if (toLoudness(meanSquare) > absoluteGate)
+			blocks.push_back(meanSquare);
+	}
+	if (blocks.empty())
+		return -std::numeric_limits<f32>::infinity();
+	f64 sum = 0.0;
+	for (f64 block : blocks)
+		sum += block;
+	const f64 threshold = toLoudness(sum / blocks.size()) + relativeGate;
+	sum = 0.0;
+	size_t kept = 0;
+	for (f64 block : blocks) {
+		if (toLoudness(block) > threshold) {
+			sum += block;
+			kept++;
+		}
+	}
+	return kept ? static_cast<f32>(toLoudness(sum / kept)) : -std::numeric_limits<f32>::infinity();
+}
+
+auto LoudnessMeter::truePeakdB() const -> f32 {
+	return this->peak > 0.0f ? 20.0f * std::log10(this->peak) : -std::numeric_limits<f32>::infinity();
+}
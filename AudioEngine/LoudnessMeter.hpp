@@ -0,0 +1,51 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <array>
+#include <vector>
+
+/*
+	ITU-R BS.1770-4 loudness (what EBU R128 and ReplayGain 2 are built on) over a whole file, fed interleaved
+	float pcm a block at a time. the signal goes through the k-weighting filters, mean squares are kept per 100ms,
+	and integratedLoudness() does the 400ms block gating at the end. true peak is the max over 4x oversampled
+	audio, which catches the inter-sample peaks a plain sample peak misses.
+	meant for offline analysis, nothing here is fast enough to bother running inside the mixer.
+*/
+class LoudnessMeter {
+public:
+	LoudnessMeter(u32 sampleRate, i32 channels);
+
+	auto add(const f32* interleaved, u32 frames) -> void;
+	auto integratedLoudness() const -> f32; // LUFS. -inf when nothing gets past the gates (silence, or under 400ms)
+	auto truePeakdB() const -> f32; // dBTP, relative to full scale
+
+private:
+	static constexpr const u32 oversampling = 4;
+	static constexpr const u32 tapsPerPhase = 12;
+
+	struct Biquad {
+		f64 b0, b1, b2, a1, a2;
+	};
+	struct ChannelState {
+		std::array<f64, 2> shelf{}; // k-weighting stage one
+		std::array<f64, 2> highPass{}; // stage two
+		std::array<f32, tapsPerPhase> history{}; // last few input samples for the oversampler, newest at historyIndex
+		f64 weight = 1.0; // surround channels count more, lfe not at all
+	};
+
+	auto filterSample(ChannelState& state, f64 sample) const -> f64;
+	auto oversampledPeak(const ChannelState& state) const -> f32;
+
+	i32 channels;
+	u32 subBlockFrames; // 100ms
+	Biquad shelf;
+	Biquad highPass;
+	std::array<f32, oversampling * tapsPerPhase> interpolator; // windowed sinc, phase major
+	std::vector<ChannelState> states;
+	u32 historyIndex = 0;
+	f64 subBlockSum = 0.0; // channel weighted sum of squares so far in the current 100ms
+	u32 subBlockFill = 0;
+	std::vector<f64> subBlocks; // mean square of every finished 100ms, four in a row make one gating block
+	f32 peak = 0.0f; // linear
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+/*
+	bounded multi-producer single-consumer ring. based on Dmitry Vyukov's bounded mpmc queue,
+	just with the consumer side simplified since only the audio thread ever pops.
+	every cell carries a sequence number so producers can claim a slot with a single CAS on head
+	and then publish it by bumping the sequence. no locks, no allocation after construction.
+	a full ring makes tryPush fail instead of waiting, callers decide what to do about that.
+*/
+template <typename T>
+class MPSCRing {
+public:
+	explicit MPSCRing(size_t requestedCapacity) :
+		cells{},
+		mask{0},
+		head{0},
+		tail{0}
+	{
+		size_t capacity = 2;
+		while (capacity < requestedCapacity) // power of 2 so wrapping is just a mask
+			capacity <<= 1;
+		this->mask = capacity - 1;
+		this->cells = std::make_unique<Cell[]>(capacity);
+		for (size_t i = 0; i < capacity; i++)
+			this->cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	MPSCRing(const MPSCRing&) = delete;
+	void operator=(const MPSCRing&) = delete;
+
+	// safe from any thread
+	auto tryPush(T&& value) -> bool {
+		size_t position = this->head.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;) {
+			cell = &this->cells[position & this->mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			auto difference = static_cast<i64>(sequence) - static_cast<i64>(position);
+			if (difference == 0) {
+				if (this->head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (difference < 0)
+				return false; // full
+			else
+				position = this->head.load(std::memory_order_relaxed);
+		}
+		cell->data = std::move(value);
+		cell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	// only the consumer thread may call this
+	auto tryPop(T& out) -> bool {
+		Cell& cell = this->cells[this->tail & this->mask];
+		size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		if (sequence != this->tail + 1)
+			return false; // empty (or a producer claimed the slot but hasn't published yet)
+		out = std::move(cell.data);
+		cell.sequence.store(this->tail + this->mask + 1, std::memory_order_release);
+		this->tail++;
+		return true;
+	}
+
+	// consumer only. a push that's claimed its slot but not published yet still counts as empty
+	auto empty() const -> bool {
+		return this->cells[this->tail & this->mask].sequence.load(std::memory_order_acquire) != this->tail + 1;
+	}
+
+	auto capacity() const -> size_t {
+		return this->mask + 1;
+	}
+
+private:
+	struct alignas(64) Cell {
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	std::unique_ptr<Cell[]> cells;
+	size_t mask;
+	alignas(64) std::atomic<size_t> head; // shared by producers
+	alignas(64) size_t tail; // consumer only
+};
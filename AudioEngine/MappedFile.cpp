@@ -0,0 +1,128 @@
+
+#include "pch.h"
+
+#include "MappedFile.hpp"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Audio {
+	MappedFile::MappedFile() :
+		view{nullptr},
+		length{0},
+		fileHandle{nullptr},
+		mappingHandle{nullptr}
+	{}
+
+	MappedFile::~MappedFile() {
+		this->close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept :
+		view{other.view},
+		length{other.length},
+		fileHandle{other.fileHandle},
+		mappingHandle{other.mappingHandle}
+	{
+		other.view = nullptr;
+		other.length = 0;
+		other.fileHandle = nullptr;
+		other.mappingHandle = nullptr;
+	}
+
+	auto MappedFile::operator=(MappedFile&& other) noexcept -> MappedFile& {
+		if (this != &other) {
+			this->close();
+			std::swap(this->view, other.view);
+			std::swap(this->length, other.length);
+			std::swap(this->fileHandle, other.fileHandle);
+			std::swap(this->mappingHandle, other.mappingHandle);
+		}
+		return *this;
+	}
+
+#ifdef _WIN32
+	auto MappedFile::open(const std::string& path) -> bool {
+		this->close();
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) { // can't map an empty file
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			CloseHandle(file);
+			return false;
+		}
+		const void* mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!mapped) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		this->view = static_cast<const u8*>(mapped);
+		this->length = static_cast<size_t>(fileSize.QuadPart);
+		this->fileHandle = file;
+		this->mappingHandle = mapping;
+		return true;
+	}
+
+	auto MappedFile::close() -> void {
+		if (this->view)
+			UnmapViewOfFile(this->view);
+		if (this->mappingHandle)
+			CloseHandle(this->mappingHandle);
+		if (this->fileHandle)
+			CloseHandle(this->fileHandle);
+		this->view = nullptr;
+		this->length = 0;
+		this->fileHandle = nullptr;
+		this->mappingHandle = nullptr;
+	}
+#else
+	auto MappedFile::open(const std::string& path) -> bool {
+		this->close();
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd); // the mapping keeps the file alive on its own
+		if (mapped == MAP_FAILED)
+			return false;
+		this->view = static_cast<const u8*>(mapped);
+		this->length = static_cast<size_t>(info.st_size);
+		return true;
+	}
+
+	auto MappedFile::close() -> void {
+		if (this->view)
+			munmap(const_cast<u8*>(this->view), this->length);
+		this->view = nullptr;
+		this->length = 0;
+	}
+#endif
+
+	auto MappedFile::isOpen() const -> bool {
+		return this->view != nullptr;
+	}
+
+	auto MappedFile::data() const -> const u8* {
+		return this->view;
+	}
+
+	auto MappedFile::size() const -> size_t {
+		return this->length;
+	}
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <string>
+
+#ifndef _WIN32
+#define AUDIOENGINE_API
+#elif defined(AUDIOENGINE_EXPORTS)
+#define AUDIOENGINE_API __declspec(dllexport)
+#else
+#define AUDIOENGINE_API __declspec(dllimport)
+#endif
+
+namespace Audio {
+	// read-only view of a whole file through the os page cache. nothing gets copied into our heap,
+	// and several processes mapping the same file share the same physical pages.
+	class MappedFile {
+	public:
+		AUDIOENGINE_API MappedFile();
+		AUDIOENGINE_API ~MappedFile();
+		AUDIOENGINE_API MappedFile(MappedFile&& other) noexcept;
+		AUDIOENGINE_API auto operator=(MappedFile&& other) noexcept -> MappedFile&;
+		MappedFile(const MappedFile&) = delete;
+		void operator=(const MappedFile&) = delete;
+
+		AUDIOENGINE_API auto open(const std::string& path) -> bool; // closes whatever was mapped before
+		AUDIOENGINE_API auto close() -> void;
+		AUDIOENGINE_API auto isOpen() const -> bool;
+		AUDIOENGINE_API auto data() const -> const u8*;
+		AUDIOENGINE_API auto size() const -> size_t;
+
+	private:
+		const u8* view;
+		size_t length;
+		void* fileHandle; // HANDLE on windows, fd stuffed in a pointer elsewhere
+		void* mappingHandle;
+	};
+};
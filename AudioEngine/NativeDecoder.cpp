@@ -0,0 +1,499 @@
+
+#include "pch.h"
+
+#include "NativeDecoder.hpp"
+
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <span>
+
+namespace {
+	auto readLE16(const u8* p) -> u32 {
+		return static_cast<u32>(p[0]) | (static_cast<u32>(p[1]) << 8);
+	}
+
+	auto readLE32(const u8* p) -> u32 {
+		return static_cast<u32>(p[0]) | (static_cast<u32>(p[1]) << 8) | (static_cast<u32>(p[2]) << 16) | (static_cast<u32>(p[3]) << 24);
+	}
+
+	auto formatName(i32 bitsPerSample, bool isFloat) -> std::string {
+		if (isFloat) return "pcm_float";
+		if (bitsPerSample <= 8) return "pcm8";
+		if (bitsPerSample <= 16) return "pcm16";
+		if (bitsPerSample <= 24) return "pcm24";
+		return "pcm32";
+	}
+
+	// ---- wav ----
+
+	constexpr const u32 wavPcm = 1;
+	constexpr const u32 wavFloat = 3;
+	constexpr const u32 wavExtensible = 0xFFFE;
+
+	auto decodeWav(const u8* data, size_t size, DecodedSound& out) -> bool {
+		u32 formatTag = 0, channels = 0, sampleRate = 0, blockAlign = 0, bits = 0;
+		const u8* samples = nullptr;
+		size_t sampleBytes = 0;
+		for (size_t at = 12; at + 8 <= size;) {
+			const u8* chunk = data + at;
+			const size_t length = std::min<size_t>(readLE32(chunk + 4), size - at - 8); // trust the file, but only so far
+			const u8* body = chunk + 8;
+			if (std::memcmp(chunk, "fmt ", 4) == 0 && length >= 16) {
+				formatTag = readLE16(body);
+				channels = readLE16(body + 2);
+				sampleRate = readLE32(body + 4);
+				blockAlign = readLE16(body + 12);
+				bits = readLE16(body + 14);
+				if (formatTag == wavExtensible && length >= 26)
+					formatTag = readLE16(body + 24); // first two bytes of the subformat guid are the plain tag
+			}
+			else if (std::memcmp(chunk, "data", 4) == 0) {
+				samples = body;
+				sampleBytes = length;
+			}
+			else if (std::memcmp(chunk, "LIST", 4) == 0 && length >= 4 && std::memcmp(body, "INFO", 4) == 0) {
+				for (size_t item = 4; item + 8 <= length;) {
+					const size_t itemLength = std::min<size_t>(readLE32(body + item + 4), length - item - 8);
+					const char* text = reinterpret_cast<const char*>(body + item + 8);
+					std::string value(text, strnlen(text, itemLength));
+					if (!value.empty())
+						out.tags.emplace(std::string(reinterpret_cast<const char*>(body + item), 4), std::move(value));
+					item += 8 + itemLength + (itemLength & 1);
+				}
+			}
+			at += 8 + length + (length & 1); // chunks are padded to even sizes
+		}
+		if (!samples || channels == 0 || sampleRate == 0 || blockAlign < channels)
+			return false;
+		const u32 container = blockAlign / channels; // bytes each sample really takes, valid bits can be fewer
+		const bool isFloat = formatTag == wavFloat;
+		if (isFloat ? (container != 4 && container != 8) : (formatTag != wavPcm || container < 1 || container > 4))
+			return false;
+
+		out.type = "wav";
+		out.format = formatName(bits, isFloat);
+		out.sampleRate = sampleRate;
+		out.channels = static_cast<i32>(channels);
+		out.bitsPerSample = static_cast<i32>(bits);
+		out.frames = sampleBytes / blockAlign;
+		const size_t count = static_cast<size_t>(out.frames) * channels;
+		out.samples.resize(count);
+		for (size_t i = 0; i < count; i++) {
+			const u8* p = samples + i * container;
+			f32 value;
+			if (isFloat && container == 4)
+				std::memcpy(&value, p, sizeof(value));
+			else if (isFloat) {
+				f64 wide;
+				std::memcpy(&wide, p, sizeof(wide));
+				value = static_cast<f32>(wide);
+			}
+			else if (container == 1)
+				value = (static_cast<i32>(p[0]) - 128) / 128.0f; // 8 bit wav is the one unsigned format
+			else {
+				// left justify into 32 bits so every width shares one scale
+				u32 raw = 0;
+				for (u32 b = 0; b < container; b++)
+					raw |= static_cast<u32>(p[b]) << (8 * (4 - container + b));
+				value = static_cast<f32>(static_cast<i32>(raw) / 2147483648.0);
+			}
+			out.samples[i] = value;
+		}
+		return true;
+	}
+
+	// ---- flac ----
+
+	// msb first, the way flac packs everything past the metadata. reads past the end give zeros and set overrun
+	class BitReader {
+	public:
+		BitReader(const u8* data, size_t size, size_t start) : data{data}, size{size}, next{start}, cache{0}, cacheBits{0} {}
+
+		auto read(u32 bits) -> u32 { // up to 32
+			if (bits == 0) return 0;
+			if (this->cacheBits < bits)
+				this->refill();
+			u32 value = static_cast<u32>(this->cache >> (64 - bits));
+			this->consume(bits);
+			return value;
+		}
+
+		auto readSigned(u32 bits) -> i32 {
+			if (bits == 0) return 0;
+			u32 value = this->read(bits);
+			return static_cast<i32>(value << (32 - bits)) >> (32 - bits);
+		}
+
+		auto readUnary() -> u32 { // zeros before the next one
+			u32 zeros = 0;
+			for (;;) {
+				if (this->cacheBits == 0) {
+					this->refill();
+					if (this->overrun()) return zeros;
+				}
+				if (this->cache == 0) {
+					zeros += this->cacheBits;
+					this->cacheBits = 0;
+					continue;
+				}
+				u32 leading = static_cast<u32>(std::countl_zero(this->cache)); // always < cacheBits, the bits past it are zero
+				zeros += leading;
+				this->consume(leading + 1);
+				return zeros;
+			}
+		}
+
+		auto readRice(u32 parameter) -> i32 {
+			u32 quotient = this->readUnary();
+			u32 folded = (quotient << parameter) | this->read(parameter);
+			return static_cast<i32>(folded >> 1) ^ -static_cast<i32>(folded & 1);
+		}
+
+		auto alignToByte() -> void {
+			this->consume(this->cacheBits & 7);
+		}
+
+		auto bytePosition() const -> size_t { // only meaningful when aligned
+			return this->next - this->cacheBits / 8;
+		}
+
+		auto overrun() const -> bool {
+			return this->next * 8 - this->cacheBits > this->size * 8;
+		}
+
+		auto bytes(size_t from, size_t to) const -> std::span<const u8> { // clipped to the data
+			to = std::min(to, this->size);
+			return from < to ? std::span<const u8>(this->data + from, to - from) : std::span<const u8>{};
+		}
+
+	private:
+		auto refill() -> void {
+			while (this->cacheBits <= 56) {
+				u64 byte = this->next < this->size ? this->data[this->next] : 0;
+				this->cache |= byte << (56 - this->cacheBits);
+				this->cacheBits += 8;
+				this->next++;
+			}
+		}
+
+		auto consume(u32 bits) -> void {
+			this->cache = bits < 64 ? this->cache << bits : 0;
+			this->cacheBits -= bits;
+		}
+
+		const u8* data;
+		size_t size;
+		size_t next; // next byte to load into the cache
+		u64 cache; // left justified
+		u32 cacheBits;
+	};
+
+	struct FlacStream {
+		u32 sampleRate = 0;
+		i32 channels = 0;
+		i32 bitsPerSample = 0;
+		u64 totalFrames = 0; // 0 if the encoder didn't know
+		u32 maxBlockSize = 0;
+	};
+
+	constexpr const u32 flacMaxLpcOrder = 32;
+	constexpr const u32 flacMaxFixedOrder = 4;
+
+	auto decodeResidual(BitReader& bits, u32 blockSize, u32 order, i32* residual) -> bool {
+		const u32 method = bits.read(2);
+		if (method > 1) return false;
+		const u32 parameterBits = method == 0 ? 4 : 5;
+		const u32 escape = method == 0 ? 15 : 31;
+		const u32 partitionOrder = bits.read(4);
+		const u32 partitions = 1u << partitionOrder;
+		if ((blockSize & (partitions - 1)) != 0 || (blockSize >> partitionOrder) < order)
+			return false;
+		u32 at = 0;
+		for (u32 p = 0; p < partitions; p++) {
+			const u32 count = (blockSize >> partitionOrder) - (p == 0 ? order : 0);
+			const u32 parameter = bits.read(parameterBits);
+			if (parameter == escape) {
+				const u32 rawBits = bits.read(5);
+				for (u32 i = 0; i < count; i++)
+					residual[at++] = bits.readSigned(rawBits);
+			}
+			else {
+				for (u32 i = 0; i < count; i++)
+					residual[at++] = bits.readRice(parameter);
+			}
+		}
+		return !bits.overrun();
+	}
+
+	// samples[0, blockSize) for one channel. warm up samples go in first, the predictor fills in the rest
+	auto decodeSubframe(BitReader& bits, u32 blockSize, u32 sampleBits, i32* samples) -> bool {
+		if (bits.read(1) != 0) return false; // zero padding
+		const u32 type = bits.read(6);
+		u32 wasted = 0;
+		if (bits.read(1)) {
+			wasted = bits.readUnary() + 1;
+			if (wasted >= sampleBits) return false;
+			sampleBits -= wasted;
+		}
+		if (sampleBits > 32) return false;
+
+		if (type == 0) { // constant
+			std::fill(samples, samples + blockSize, bits.readSigned(sampleBits));
+		}
+		else if (type == 1) { // verbatim
+			for (u32 i = 0; i < blockSize; i++)
+				samples[i] = bits.readSigned(sampleBits);
+		}
+		else if (type >= 8 && type <= 8 + flacMaxFixedOrder) {
+			const u32 order = type - 8;
+			if (order > blockSize) return false;
+			for (u32 i = 0; i < order; i++)
+				samples[i] = bits.readSigned(sampleBits);
+			if (!decodeResidual(bits, blockSize, order, samples + order))
+				return false;
+			// the residual sits where its sample goes, so each prediction adds onto it in place
+			for (u32 i = order; i < blockSize; i++) {
+				i64 prediction = 0;
+				switch (order) {
+					case 1: prediction = samples[i - 1]; break;
+					case 2: prediction = 2ll * samples[i - 1] - samples[i - 2]; break;
+					case 3: prediction = 3ll * samples[i - 1] - 3ll * samples[i - 2] + samples[i - 3]; break;
+					case 4: prediction = 4ll * samples[i - 1] - 6ll * samples[i - 2] + 4ll * samples[i - 3] - samples[i - 4]; break;
+					default: break;
+				}
+				samples[i] = static_cast<i32>(prediction + samples[i]);
+			}
+		}
+		else if (type >= 32) { // lpc
+			const u32 order = type - 31;
+			if (order > blockSize) return false;
+			for (u32 i = 0; i < order; i++)
+				samples[i] = bits.readSigned(sampleBits);
+			const u32 precision = bits.read(4) + 1;
+			if (precision == 16) return false; // 0b1111 is reserved
+			const i32 shift = bits.readSigned(5);
+			if (shift < 0) return false;
+			i32 coefficients[flacMaxLpcOrder];
+			for (u32 j = 0; j < order; j++)
+				coefficients[j] = bits.readSigned(precision);
+			if (!decodeResidual(bits, blockSize, order, samples + order))
+				return false;
+			for (u32 i = order; i < blockSize; i++) {
+				i64 sum = 0;
+				for (u32 j = 0; j < order; j++)
+					sum += static_cast<i64>(coefficients[j]) * samples[i - j - 1];
+				samples[i] = static_cast<i32>((sum >> shift) + samples[i]);
+			}
+		}
+		else
+			return false; // reserved types
+
+		if (wasted) {
+			for (u32 i = 0; i < blockSize; i++)
+				samples[i] = static_cast<i32>(static_cast<u32>(samples[i]) << wasted);
+		}
+		return !bits.overrun();
+	}
+
+	// the utf-8 style frame/sample number. only its length matters here, frames are decoded in file order
+	auto skipCodedNumber(BitReader& bits) -> bool {
+		const u32 first = bits.read(8);
+		u32 extra = 0;
+		if ((first & 0x80) == 0) extra = 0;
+		else if ((first & 0xE0) == 0xC0) extra = 1;
+		else if ((first & 0xF0) == 0xE0) extra = 2;
+		else if ((first & 0xF8) == 0xF0) extra = 3;
+		else if ((first & 0xFC) == 0xF8) extra = 4;
+		else if ((first & 0xFE) == 0xFC) extra = 5;
+		else if (first == 0xFE) extra = 6;
+		else return false;
+		for (u32 i = 0; i < extra; i++) {
+			if ((bits.read(8) & 0xC0) != 0x80)
+				return false;
+		}
+		return true;
+	}
+
+	// the frame header's crc-8, polynomial x^8 + x^2 + x + 1 starting from 0. the header's only a handful of bytes
+	auto crc8(std::span<const u8> bytes) -> u8 {
+		u8 crc = 0;
+		for (u8 byte : bytes) {
+			crc ^= byte;
+			for (u32 bit = 0; bit < 8; bit++)
+				crc = static_cast<u8>((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+		}
+		return crc;
+	}
+
+	constexpr const u32 channelLeftSide = 8;
+	constexpr const u32 channelSideRight = 9;
+	constexpr const u32 channelMidSide = 10;
+
+	// one frame starting at a sync code, appended to out. channel holds one block per channel as scratch
+	auto decodeFrame(BitReader& bits, const FlacStream& stream, std::vector<i32>& channel, std::vector<f32>& out) -> bool {
+		const size_t headerStart = bits.bytePosition();
+		if (bits.read(14) != 0x3FFE) return false;
+		bits.read(2); // reserved, blocking strategy
+		const u32 blockCode = bits.read(4);
+		const u32 rateCode = bits.read(4);
+		const u32 assignment = bits.read(4);
+		const u32 sizeCode = bits.read(3);
+		bits.read(1);
+		if (!skipCodedNumber(bits)) return false;
+
+		u32 blockSize = 0;
+		if (blockCode == 1) blockSize = 192;
+		else if (blockCode >= 2 && blockCode <= 5) blockSize = 576u << (blockCode - 2);
+		else if (blockCode == 6) blockSize = bits.read(8) + 1;
+		else if (blockCode == 7) blockSize = bits.read(16) + 1;
+		else if (blockCode >= 8) blockSize = 256u << (blockCode - 8);
+		else return false;
+		if (rateCode == 12) bits.read(8);
+		else if (rateCode == 13 || rateCode == 14) bits.read(16);
+		else if (rateCode == 15) return false;
+		// checked, since after losing sync any 0xFFF8 in the audio looks like a header. the header is all whole bytes
+		const size_t headerEnd = bits.bytePosition();
+		if (bits.read(8) != crc8(bits.bytes(headerStart, headerEnd)))
+			return false;
+
+		static constexpr const i32 sizes[8] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+		const i32 sampleBits = sizeCode == 0 ? stream.bitsPerSample : sizes[sizeCode];
+		const i32 channels = assignment <= 7 ? static_cast<i32>(assignment) + 1 : 2;
+		if (sampleBits == 0 || assignment > channelMidSide || channels != stream.channels)
+			return false;
+
+		channel.resize(static_cast<size_t>(blockSize) * channels);
+		for (i32 c = 0; c < channels; c++) {
+			// the side channel is the difference of two, so it needs one more bit
+			const bool side = (assignment == channelLeftSide && c == 1) || (assignment == channelSideRight && c == 0) || (assignment == channelMidSide && c == 1);
+			if (!decodeSubframe(bits, blockSize, static_cast<u32>(sampleBits) + (side ? 1 : 0), channel.data() + static_cast<size_t>(c) * blockSize))
+				return false;
+		}
+		bits.alignToByte();
+		bits.read(16); // frame crc
+
+		i32* first = channel.data();
+		i32* second = channel.data() + blockSize;
+		for (u32 i = 0; i < blockSize && channels == 2; i++) {
+			if (assignment == channelLeftSide)
+				second[i] = first[i] - second[i];
+			else if (assignment == channelSideRight)
+				first[i] = first[i] + second[i];
+			else if (assignment == channelMidSide) {
+				i32 mid = static_cast<i32>(static_cast<u32>(first[i]) << 1) | (second[i] & 1);
+				first[i] = (mid + second[i]) >> 1;
+				second[i] = (mid - second[i]) >> 1;
+			}
+		}
+		const f32 scale = 1.0f / static_cast<f32>(1ull << (sampleBits - 1));
+		const size_t start = out.size();
+		out.resize(start + static_cast<size_t>(blockSize) * channels);
+		for (u32 i = 0; i < blockSize; i++) {
+			for (i32 c = 0; c < channels; c++)
+				out[start + static_cast<size_t>(i) * channels + c] = channel[static_cast<size_t>(c) * blockSize + i] * scale;
+		}
+		return !bits.overrun();
+	}
+
+	auto decodeFlac(const u8* data, size_t size, size_t start, DecodedSound& out) -> bool {
+		FlacStream stream;
+		size_t at = start + 4; // past "fLaC"
+		for (bool last = false; !last;) {
+			if (at + 4 > size) return false;
+			last = (data[at] & 0x80) != 0;
+			const u32 type = data[at] & 0x7F;
+			const size_t length = (static_cast<size_t>(data[at + 1]) << 16) | (static_cast<size_t>(data[at + 2]) << 8) | data[at + 3];
+			const u8* body = data + at + 4;
+			if (at + 4 + length > size) return false;
+			if (type == 0 && length >= 34) { // streaminfo
+				BitReader info(body, length, 0);
+				info.read(16);
+				stream.maxBlockSize = info.read(16);
+				info.read(24);
+				info.read(24);
+				stream.sampleRate = info.read(20);
+				stream.channels = static_cast<i32>(info.read(3)) + 1;
+				stream.bitsPerSample = static_cast<i32>(info.read(5)) + 1;
+				stream.totalFrames = (static_cast<u64>(info.read(4)) << 32) | info.read(32);
+			}
+			else if (type == 4 && length >= 8) { // vorbis comments, little endian unlike the rest of flac
+				size_t p = 4 + readLE32(body);
+				if (p + 4 <= length) {
+					u32 count = readLE32(body + p);
+					p += 4;
+					for (u32 i = 0; i < count && p + 4 <= length; i++) {
+						const size_t entryLength = std::min<size_t>(readLE32(body + p), length - p - 4);
+						std::string entry(reinterpret_cast<const char*>(body + p + 4), entryLength);
+						p += 4 + entryLength;
+						const size_t equals = entry.find('=');
+						if (equals != std::string::npos && equals > 0)
+							out.tags.emplace(entry.substr(0, equals), entry.substr(equals + 1)); // first one wins, like a single valued tag
+					}
+				}
+			}
+			at += 4 + length;
+		}
+		if (stream.sampleRate == 0 || stream.bitsPerSample < 4 || stream.bitsPerSample > 32)
+			return false;
+
+		out.type = "flac";
+		out.format = formatName(stream.bitsPerSample, false);
+		out.sampleRate = stream.sampleRate;
+		out.channels = stream.channels;
+		out.bitsPerSample = stream.bitsPerSample;
+		// streaminfo's count is 36 bits of whatever the file says, so only trust it as far as the frames could hold.
+		// 4x the bytes left covers real music, anything past that just grows as it decodes
+		const u64 plausibleSamples = static_cast<u64>(size - at) * 8 / static_cast<u64>(stream.bitsPerSample) * 4;
+		if (stream.totalFrames)
+			out.samples.reserve(static_cast<size_t>(std::min(stream.totalFrames * static_cast<u64>(stream.channels), plausibleSamples)));
+		std::vector<i32> channel(static_cast<size_t>(std::max(stream.maxBlockSize, 4096u)) * stream.channels);
+		BitReader bits(data, size, at);
+		while (bits.bytePosition() + 2 <= size) {
+			const size_t frameStart = bits.bytePosition();
+			const size_t decoded = out.samples.size();
+			if (decodeFrame(bits, stream, channel, out.samples))
+				continue;
+			out.samples.resize(decoded);
+			// lost sync, look for the next frame header. anything decoded so far is kept
+			size_t next = frameStart + 1;
+			while (next + 1 < size && !(data[next] == 0xFF && (data[next + 1] & 0xFE) == 0xF8))
+				next++;
+			if (next + 1 >= size) break;
+			bits = BitReader(data, size, next);
+		}
+		out.frames = out.samples.size() / stream.channels;
+		if (stream.totalFrames && out.frames > stream.totalFrames) { // trailing junk that happened to parse
+			out.frames = stream.totalFrames;
+			out.samples.resize(static_cast<size_t>(out.frames) * stream.channels);
+		}
+		return out.frames > 0;
+	}
+
+	// an id3v2 block in front of the flac marker is common enough from taggers to be worth skipping
+	auto skipId3(const u8* data, size_t size) -> size_t {
+		if (size < 10 || std::memcmp(data, "ID3", 3) != 0)
+			return 0;
+		size_t length = (static_cast<size_t>(data[6] & 0x7F) << 21) | (static_cast<size_t>(data[7] & 0x7F) << 14) | (static_cast<size_t>(data[8] & 0x7F) << 7) | (data[9] & 0x7F);
+		return 10 + length + ((data[5] & 0x10) ? 10 : 0); // footer flag
+	}
+};
+
+auto decodeSound(const u8* data, size_t size, DecodedSound& out) -> bool {
+	out = DecodedSound{};
+	if (size >= 12 && std::memcmp(data, "RIFF", 4) == 0 && std::memcmp(data + 8, "WAVE", 4) == 0)
+		return decodeWav(data, size, out);
+	const size_t start = skipId3(data, size);
+	if (start + 4 <= size && std::memcmp(data + start, "fLaC", 4) == 0)
+		return decodeFlac(data, size, start, out);
+	return false;
+}
+
+auto decodeSoundFile(const std::string& path, DecodedSound& out) -> bool {
+	Audio::MappedFile file;
+	if (!file.open(path))
+		return false;
+	return decodeSound(file.data(), file.size(), out);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// a whole file decoded up front, as the native backend keeps it
+struct DecodedSound {
+	std::string type; // "wav" or "flac", the same names SoundInfo uses for fmod's types
+	std::string format; // what the file stored, "pcm16", "pcm_float", ...
+	u32 sampleRate = 0;
+	i32 channels = 0;
+	i32 bitsPerSample = 0;
+	u64 frames = 0;
+	std::vector<f32> samples; // interleaved, every channel the file had, full scale is +-1
+	std::unordered_map<std::string, std::string> tags; // vorbis comments for flac, LIST/INFO ids for wav
+};
+
+/*
+	wav (8/16/24/32 bit int, 32/64 bit float, plain or extensible) and flac (everything the spec allows up to 32 bits,
+	minus the 33 bit side channel a 32 bit stereo stream would need). the format is picked from the header, not the name.
+	false if it isn't either or is broken before the first frame. a flac that goes bad partway keeps what decoded
+*/
+auto decodeSound(const u8* data, size_t size, DecodedSound& out) -> bool;
+auto decodeSoundFile(const std::string& path, DecodedSound& out) -> bool; // maps the file, then decodeSound
@@ -0,0 +1,408 @@
+
+#include "pch.h"
+
+#include "NativeMixer.hpp"
+
+#include "VecMath.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <type_traits>
+
+namespace {
+	constexpr const i32 outputChannels = 2;
+	constexpr const f32 loadSmoothing = 0.05f; // each block moves the load estimate this far towards its own
+
+	// 4 point, 3rd order hermite. y1 and y2 are either side of t, cheap and far cleaner than linear for pitch changes
+	auto hermite(f32 y0, f32 y1, f32 y2, f32 y3, f32 t) -> f32 {
+		const f32 c1 = 0.5f * (y2 - y0);
+		const f32 c2 = y0 - 2.5f * y1 + 2.0f * y2 - 0.5f * y3;
+		const f32 c3 = 0.5f * (y3 - y0) + 1.5f * (y1 - y2);
+		return ((c3 * t + c2) * t + c1) * t + y1;
+	}
+
+	template <typename T>
+	auto writeLE(std::ofstream& out, T value) -> void {
+		static_assert(std::is_trivially_copyable_v<T>);
+		out.write(reinterpret_cast<const char*>(&value), sizeof(value)); // everything we build for is little endian
+	}
+};
+
+NativeMixer::NativeMixer(u32 voiceCapacity) :
+	capacity{std::max(voiceCapacity, 1u)},
+	controls{std::make_unique<VoiceControl[]>(capacity)},
+	voices(capacity),
+	live{},
+	commands{static_cast<size_t>(capacity) * 2},
+	ended{capacity},
+	mainEffects{},
+	bus(static_cast<size_t>(blockFrames) * outputChannels),
+	scratch(static_cast<size_t>(blockFrames) * outputChannels),
+	effectScratch(static_cast<size_t>(blockFrames) * outputChannels),
+	sequence{0},
+	clock{0},
+	load{0.0f},
+	wavFile{},
+	wavFrames{0},
+	thread{}
+{
+	this->live.reserve(this->capacity); // so starting a voice never allocates on the mixer thread
+	this->mainEffects.reserve(maxMainEffects);
+}
+
+NativeMixer::~NativeMixer() {
+	this->stopThread();
+	if (this->wavFile.is_open()) {
+		this->wavFile.seekp(0);
+		this->writeWavHeader(); // now with the real sizes
+	}
+}
+
+auto NativeMixer::openWavFile(const std::string& path) -> bool {
+	this->wavFile.open(path, std::ios::binary | std::ios::trunc);
+	if (!this->wavFile.is_open())
+		return false;
+	this->writeWavHeader(); // sizes are patched on close
+	return true;
+}
+
+// 32 bit float stereo, the mix exactly as it came out of the bus
+auto NativeMixer::writeWavHeader() -> void {
+	const u32 frameBytes = sizeof(f32) * outputChannels;
+	const u64 dataBytes = std::min<u64>(this->wavFrames * frameBytes, 0xFFFFFFFFull - 36);
+	this->wavFile.write("RIFF", 4);
+	writeLE<u32>(this->wavFile, static_cast<u32>(36 + dataBytes));
+	this->wavFile.write("WAVEfmt ", 8);
+	writeLE<u32>(this->wavFile, 16);
+	writeLE<u16>(this->wavFile, 3); // ieee float
+	writeLE<u16>(this->wavFile, outputChannels);
+	writeLE<u32>(this->wavFile, sampleRate);
+	writeLE<u32>(this->wavFile, sampleRate * frameBytes);
+	writeLE<u16>(this->wavFile, frameBytes);
+	writeLE<u16>(this->wavFile, 32);
+	this->wavFile.write("data", 4);
+	writeLE<u32>(this->wavFile, static_cast<u32>(dataBytes));
+}
+
+auto NativeMixer::startThread() -> void {
+	this->thread = std::make_unique<std::jthread>([this](std::stop_token stop) -> void {
+		this->run(stop);
+	});
+}
+
+auto NativeMixer::stopThread() -> void {
+	this->thread.reset(); // jthread asks it to stop and joins
+}
+
+/*
+	there's no device pulling blocks, so the thread stands in for one: a block every blockFrames / sampleRate.
+	if it falls well behind (a debugger, a suspended machine) it picks up from now instead of mixing a burst to catch up
+*/
+auto NativeMixer::run(std::stop_token stop) -> void {
+	typedef std::chrono::steady_clock Clock;
+	const auto period = std::chrono::nanoseconds(static_cast<i64>(blockFrames) * 1000000000 / sampleRate);
+	auto next = Clock::now();
+	while (!stop.stop_requested()) {
+		this->render();
+		next += period;
+		auto now = Clock::now();
+		if (now - next > period * 8)
+			next = now;
+		std::this_thread::sleep_until(next);
+	}
+}
+
+auto NativeMixer::send(Command&& command) -> bool {
+	return this->commands.tryPush(std::move(command));
+}
+
+auto NativeMixer::takeEnded(i32& channelId) -> bool {
+	return this->ended.tryPop(channelId);
+}
+
+auto NativeMixer::indexOf(i32 channelId) -> u32 {
+	return static_cast<u32>(channelId) & 0xFFFF;
+}
+
+auto NativeMixer::control(i32 channelId) -> VoiceControl& {
+	return this->controls[std::min(indexOf(channelId), this->capacity - 1)];
+}
+
+auto NativeMixer::getClock() const -> u64 {
+	return this->clock.load(std::memory_order_acquire);
+}
+
+auto NativeMixer::getPosition(i32 channelId, u64& clock) const -> u64 {
+	const VoiceControl& voice = this->controls[std::min(indexOf(channelId), this->capacity - 1)];
+	for (;;) {
+		u64 before = this->sequence.load(std::memory_order_acquire);
+		clock = this->clock.load(std::memory_order_relaxed);
+		u64 position = voice.position.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if ((before & 1) == 0 && this->sequence.load(std::memory_order_relaxed) == before)
+			return position;
+		std::this_thread::yield(); // the mixer is partway through publishing a block, it's done in microseconds
+	}
+}
+
+auto NativeMixer::getLoad() const -> f32 {
+	return this->load.load(std::memory_order_relaxed);
+}
+
+auto NativeMixer::apply(Command& command) -> void {
+	std::visit([this](auto& cmd) -> void {
+		using T = std::decay_t<decltype(cmd)>;
+		if constexpr (std::is_same_v<T, StartVoice>) {
+			const u32 index = indexOf(cmd.channelId);
+			if (index >= this->capacity || !cmd.sound || this->voices[index].sound)
+				return; // the owner only reuses a slot after seeing it end, so a live voice here would be a bug upstream
+			Voice& voice = this->voices[index];
+			voice = Voice{};
+			voice.channelId = cmd.channelId;
+			voice.sound = std::move(cmd.sound);
+			voice.step = static_cast<f64>(voice.sound->sampleRate) / sampleRate;
+			voice.startClock = cmd.startClock;
+			voice.fadeInEnd = cmd.fadeInEnd;
+			this->live.push_back(index);
+		}
+		else if constexpr (std::is_same_v<T, FadeOutVoice>) {
+			const u32 index = indexOf(cmd.channelId);
+			if (index >= this->capacity || this->voices[index].channelId != cmd.channelId || !this->voices[index].sound)
+				return; // already over
+			this->voices[index].fadeOutStart = cmd.startClock;
+			this->voices[index].fadeOutEnd = std::max<u64>(cmd.endClock, 1);
+		}
+		else if constexpr (std::is_same_v<T, AddEffect>) {
+			if (cmd.channelId == 0) {
+				if (this->mainEffects.size() < maxMainEffects)
+					this->mainEffects.push_back(VoiceEffect{ cmd.effectId, std::move(cmd.unit) });
+				return;
+			}
+			const u32 index = indexOf(cmd.channelId);
+			if (index >= this->capacity) return;
+			Voice& voice = this->voices[index];
+			if (voice.channelId == cmd.channelId && voice.sound && voice.effectCount < maxVoiceEffects)
+				voice.effects[voice.effectCount++] = VoiceEffect{ cmd.effectId, std::move(cmd.unit) };
+		}
+		else if constexpr (std::is_same_v<T, RemoveEffect>) {
+			const auto matches = [&cmd](const VoiceEffect& effect) -> bool { return effect.effectId == cmd.effectId; };
+			if (std::erase_if(this->mainEffects, matches) > 0)
+				return;
+			for (u32 index : this->live) {
+				Voice& voice = this->voices[index];
+				auto* end = voice.effects.data() + voice.effectCount;
+				auto* found = std::find_if(voice.effects.data(), end, matches);
+				if (found == end) continue;
+				std::move(found + 1, end, found);
+				voice.effects[--voice.effectCount] = VoiceEffect{};
+				return;
+			}
+		}
+	}, command);
+}
+
+auto NativeMixer::render() -> void {
+	auto start = std::chrono::steady_clock::now();
+	Command command;
+	while (this->commands.tryPop(command))
+		this->apply(command);
+	command = Command{};
+
+	const u64 blockStart = this->clock.load(std::memory_order_relaxed);
+	const u64 sequence = this->sequence.load(std::memory_order_relaxed);
+	this->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	std::fill(this->bus.begin(), this->bus.end(), 0.0f);
+	for (size_t i = 0; i < this->live.size();) {
+		if (this->mixVoice(this->voices[this->live[i]], blockStart))
+			i++;
+		else
+			this->endVoice(static_cast<u32>(i)); // the last one moves into i
+	}
+	this->clock.store(blockStart + blockFrames, std::memory_order_release);
+	this->sequence.store(sequence + 2, std::memory_order_release);
+
+	f32* mixed = this->bus.data();
+	f32* spare = this->effectScratch.data();
+	for (auto& effect : this->mainEffects) {
+		effect.unit->process(mixed, spare, blockFrames, outputChannels);
+		std::swap(mixed, spare);
+	}
+	if (this->wavFile.is_open()) {
+		this->wavFile.write(reinterpret_cast<const char*>(mixed), static_cast<std::streamsize>(blockFrames) * outputChannels * sizeof(f32));
+		this->wavFrames += blockFrames;
+	}
+
+	const f32 blockNs = static_cast<f32>(blockFrames) * 1e9f / sampleRate;
+	const f32 used = static_cast<f32>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	const f32 previous = this->load.load(std::memory_order_relaxed);
+	this->load.store(previous + (used / blockNs * 100.0f - previous) * loadSmoothing, std::memory_order_relaxed);
+}
+
+/*
+	a voice's part of the block runs from its start (if that lands inside this block) to its end (if a fade out stops
+	it inside this block), so both land on the exact sample they were scheduled for. gains ramp from where the last
+	block left off, so volume and pan changes never click. fades are followed a block at a time, which at 1024 frames
+	is far finer than the curve needs
+*/
+auto NativeMixer::mixVoice(Voice& voice, u64 blockStart) -> bool {
+	VoiceControl& control = this->controls[indexOf(voice.channelId)];
+	if (control.stopRequested.load(std::memory_order_relaxed))
+		return false;
+	const u64 blockEnd = blockStart + blockFrames;
+	if (voice.startClock >= blockEnd)
+		return true; // scheduled for later
+	const u32 begin = voice.startClock > blockStart ? static_cast<u32>(voice.startClock - blockStart) : 0;
+	u32 end = blockFrames;
+	bool last = false;
+	if (voice.fadeOutEnd != 0 && voice.fadeOutEnd <= blockEnd) {
+		end = voice.fadeOutEnd > blockStart + begin ? static_cast<u32>(voice.fadeOutEnd - blockStart) : begin;
+		last = true;
+	}
+	const u32 frames = end - begin;
+	const f32 left = control.left.load(std::memory_order_relaxed);
+	const f32 right = control.right.load(std::memory_order_relaxed);
+	if (voice.fresh) {
+		voice.left = left;
+		voice.right = right;
+		voice.fresh = false;
+	}
+
+	u32 produced = 0;
+	if (control.silent.load(std::memory_order_relaxed))
+		produced = this->skip(voice, frames);
+	else if (frames > 0) {
+		produced = this->resample(voice, this->scratch.data(), frames);
+		std::fill(this->scratch.begin() + static_cast<size_t>(produced) * outputChannels, this->scratch.begin() + static_cast<size_t>(frames) * outputChannels, 0.0f);
+		f32* source = this->scratch.data();
+		f32* spare = this->effectScratch.data();
+		for (u32 e = 0; e < voice.effectCount; e++) {
+			voice.effects[e].unit->process(source, spare, frames, outputChannels);
+			std::swap(source, spare);
+		}
+		const f32 fadeFrom = this->fadeGain(voice, blockStart + begin);
+		const f32 fadeTo = this->fadeGain(voice, blockStart + end);
+		const size_t samples = static_cast<size_t>(frames) * outputChannels;
+		Audio::mixStereo(
+			std::span<const f32>(source, samples),
+			voice.left * fadeFrom, voice.right * fadeFrom, left * fadeTo, right * fadeTo,
+			std::span<f32>(this->bus.data() + static_cast<size_t>(begin) * outputChannels, samples)
+		);
+	}
+	voice.left = left;
+	voice.right = right;
+	control.position.store(static_cast<u64>(voice.cursor), std::memory_order_relaxed);
+	const bool ranOut = produced < frames; // only a one shot runs out, a loop always fills the block
+	return !last && !ranOut;
+}
+
+auto NativeMixer::fadeGain(const Voice& voice, u64 clock) const -> f32 {
+	f32 gain = 1.0f;
+	if (voice.fadeInEnd > voice.startClock && clock < voice.fadeInEnd) {
+		const f64 t = clock <= voice.startClock ? 0.0 : static_cast<f64>(clock - voice.startClock) / static_cast<f64>(voice.fadeInEnd - voice.startClock);
+		gain *= static_cast<f32>(std::sin(std::numbers::pi / 2.0 * t));
+	}
+	if (voice.fadeOutEnd != 0 && clock > voice.fadeOutStart) {
+		const f64 length = static_cast<f64>(voice.fadeOutEnd - std::min(voice.fadeOutStart, voice.fadeOutEnd));
+		const f64 t = length > 0.0 ? std::min(static_cast<f64>(clock - voice.fadeOutStart) / length, 1.0) : 1.0;
+		gain *= static_cast<f32>(std::cos(std::numbers::pi / 2.0 * t));
+	}
+	return gain;
+}
+
+/*
+	stereo out whatever the source is, mono goes to both sides. matching rates with the cursor on a whole frame (the
+	common case, and where every voice starts) is a straight copy. anything else is hermite interpolation, with the
+	neighbours wrapping round for a loop and reading as silence past either end of a one shot
+*/
+auto NativeMixer::resample(Voice& voice, f32* out, u32 frames) -> u32 {
+	const NativeSoundData& sound = *voice.sound;
+	const i64 length = static_cast<i64>(sound.frames);
+	const i32 channels = sound.channels;
+	const f32* samples = sound.samples.data();
+	if (length == 0)
+		return 0;
+
+	if (voice.step == 1.0 && voice.cursor == std::floor(voice.cursor)) {
+		i64 position = static_cast<i64>(voice.cursor);
+		u32 done = 0;
+		while (done < frames) {
+			if (position >= length) {
+				if (!sound.looping) break;
+				position = 0;
+			}
+			const u32 run = static_cast<u32>(std::min<i64>(frames - done, length - position));
+			if (channels == 2)
+				std::memcpy(out + static_cast<size_t>(done) * 2, samples + position * 2, static_cast<size_t>(run) * 2 * sizeof(f32));
+			else {
+				for (u32 i = 0; i < run; i++)
+					out[(done + i) * 2] = out[(done + i) * 2 + 1] = samples[position + i];
+			}
+			done += run;
+			position += run;
+		}
+		voice.cursor = static_cast<f64>(sound.looping && position >= length ? 0 : position);
+		return done;
+	}
+
+	const auto at = [&](i64 frame, i32 channel) -> f32 {
+		if (frame < 0 || frame >= length) {
+			if (!sound.looping) return 0.0f;
+			frame = ((frame % length) + length) % length;
+		}
+		return samples[frame * channels + channel];
+	};
+	for (u32 n = 0; n < frames; n++) {
+		if (voice.cursor >= static_cast<f64>(length)) {
+			if (!sound.looping) return n;
+			voice.cursor = std::fmod(voice.cursor, static_cast<f64>(length));
+		}
+		const i64 whole = static_cast<i64>(voice.cursor);
+		const f32 t = static_cast<f32>(voice.cursor - static_cast<f64>(whole));
+		const bool inside = whole >= 1 && whole + 2 < length; // nearly always, the edges take the slow path
+		for (i32 c = 0; c < channels; c++) {
+			f32 value;
+			if (inside) {
+				const f32* p = samples + (whole - 1) * channels + c;
+				value = hermite(p[0], p[channels], p[2 * channels], p[3 * channels], t);
+			}
+			else
+				value = hermite(at(whole - 1, c), at(whole, c), at(whole + 1, c), at(whole + 2, c), t);
+			out[n * 2 + c] = value;
+		}
+		if (channels == 1)
+			out[n * 2 + 1] = out[n * 2];
+		voice.cursor += voice.step;
+	}
+	return frames;
+}
+
+auto NativeMixer::skip(Voice& voice, u32 frames) -> u32 {
+	const f64 length = static_cast<f64>(voice.sound->frames);
+	if (length == 0.0 || frames == 0)
+		return 0;
+	voice.cursor += voice.step * frames;
+	if (voice.cursor < length)
+		return frames;
+	if (voice.sound->looping) {
+		voice.cursor = std::fmod(voice.cursor, length);
+		return frames;
+	}
+	const u32 produced = static_cast<u32>(std::max(0.0, frames - (voice.cursor - length) / voice.step));
+	voice.cursor = length;
+	return std::min(produced, frames - 1); // ran out somewhere in this block
+}
+
+// drops the voice's references here, the owner keeps its own until it's sure the mixer is done, so nothing gets freed on this thread
+auto NativeMixer::endVoice(u32 liveIndex) -> void {
+	Voice& voice = this->voices[this->live[liveIndex]];
+	this->ended.tryPush(i32{ voice.channelId });
+	voice.sound.reset();
+	for (u32 e = 0; e < voice.effectCount; e++)
+		voice.effects[e] = VoiceEffect{};
+	voice.effectCount = 0;
+	this->live[liveIndex] = this->live.back();
+	this->live.pop_back();
+}
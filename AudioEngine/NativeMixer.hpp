@@ -0,0 +1,142 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "MPSCRing.hpp"
+#include "DspUnit.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+// sample data as the mixer plays it. never changes once it's been handed over, the mixer reads it without locking
+struct NativeSoundData {
+	std::vector<f32> samples; // interleaved, mono or stereo (wider files get folded down on load)
+	u32 sampleRate = 0;
+	i32 channels = 0;
+	u64 frames = 0;
+	bool looping = false;
+};
+
+/*
+	the native backend's mixing half. everything runs in fixed blocks of stereo float at one rate, and the only things
+	shared with the owner are rings and atomics: commands go in through one ring, ended voices come back through
+	another, and per voice gains, stop requests and positions are atomics in a table indexed like the channel table.
+	so the voice list itself belongs to the mixer alone and nothing on the mixing path ever takes a lock.
+	render() mixes one block. in realtime the mixer calls it from its own thread, paced to the wall clock since there's
+	no device behind it. in the nrt modes the owner calls it from update(), same as fmod's nrt outputs
+*/
+class NativeMixer {
+public:
+	static constexpr const u32 sampleRate = 48000;
+	static constexpr const u32 blockFrames = 1024;
+	static constexpr const u32 maxVoiceEffects = 4; // per channel, past that addEffect on it is ignored
+	static constexpr const u32 maxMainEffects = 32;
+
+	// the owner's handles on one voice. the mixer only reads the gains and flags, and only writes position
+	struct VoiceControl {
+		std::atomic<f32> left{0.0f}; // final gains, volume, distance and pan already folded in
+		std::atomic<f32> right{0.0f};
+		std::atomic<bool> stopRequested{false};
+		std::atomic<bool> silent{false}; // virtual: keeps time but isn't mixed
+		std::atomic<u64> position{0}; // source frames from the start, as of the end of the last block
+	};
+
+	// a clock of 0 means as soon as possible. fadeInEnd (if set) gives an equal power fade in from startClock
+	struct StartVoice {
+		i32 channelId = 0;
+		std::shared_ptr<const NativeSoundData> sound;
+		u64 startClock = 0;
+		u64 fadeInEnd = 0;
+	};
+	// equal power fade out over [startClock, endClock), then the voice ends right on endClock
+	struct FadeOutVoice {
+		i32 channelId = 0;
+		u64 startClock = 0;
+		u64 endClock = 0;
+	};
+	struct AddEffect {
+		i32 effectId = 0;
+		i32 channelId = 0; // 0 for the main bus
+		std::shared_ptr<Audio::DspUnit> unit; // prepared already
+	};
+	struct RemoveEffect {
+		i32 effectId = 0;
+	};
+	typedef std::variant<std::monostate, StartVoice, FadeOutVoice, AddEffect, RemoveEffect> Command;
+
+	NativeMixer(u32 voiceCapacity);
+	~NativeMixer();
+	NativeMixer(const NativeMixer&) = delete;
+	void operator=(const NativeMixer&) = delete;
+
+	// owner thread, before anything plays
+	auto openWavFile(const std::string& path) -> bool;
+	auto startThread() -> void;
+	auto stopThread() -> void;
+
+	// owner thread from here down, unless noted
+	auto send(Command&& command) -> bool; // false if the ring is full
+	auto takeEnded(i32& channelId) -> bool;
+	auto control(i32 channelId) -> VoiceControl&; // by table index, so any id that's ever been handed out works
+	auto getClock() const -> u64; // output frames mixed so far. any thread
+	// position and the clock it was true at, read together
+	auto getPosition(i32 channelId, u64& clock) const -> u64;
+	auto getLoad() const -> f32; // time spent mixing as a percent of the time the audio lasts, smoothed. any thread
+	auto render() -> void; // mixer thread (the owner in nrt)
+
+private:
+	struct VoiceEffect {
+		i32 effectId = 0;
+		std::shared_ptr<Audio::DspUnit> unit;
+	};
+	struct Voice {
+		i32 channelId = 0;
+		std::shared_ptr<const NativeSoundData> sound;
+		f64 cursor = 0.0; // in source frames
+		f64 step = 1.0; // source frames per output frame
+		u64 startClock = 0;
+		u64 fadeInEnd = 0;
+		u64 fadeOutStart = 0;
+		u64 fadeOutEnd = 0; // 0 if it isn't fading out
+		f32 left = 0.0f; // gains the last block ended on, the next one ramps from there
+		f32 right = 0.0f;
+		bool fresh = true; // no previous block to ramp from
+		std::array<VoiceEffect, maxVoiceEffects> effects;
+		u32 effectCount = 0;
+	};
+
+	static auto indexOf(i32 channelId) -> u32;
+	auto apply(Command& command) -> void;
+	auto mixVoice(Voice& voice, u64 blockStart) -> bool; // false once it's over
+	auto resample(Voice& voice, f32* out, u32 frames) -> u32; // frames actually produced
+	auto skip(Voice& voice, u32 frames) -> u32; // resample's bookkeeping without the samples, for virtual voices
+	auto fadeGain(const Voice& voice, u64 clock) const -> f32;
+	auto endVoice(u32 liveIndex) -> void;
+	auto writeWavHeader() -> void;
+	auto run(std::stop_token stop) -> void;
+
+	u32 capacity;
+	std::unique_ptr<VoiceControl[]> controls;
+	std::vector<Voice> voices; // by table index, mixer only
+	std::vector<u32> live; // indices of voices that are playing, in no order
+	MPSCRing<Command> commands; // owner to mixer, one producer
+	MPSCRing<i32> ended; // mixer to owner. a voice ends once and its slot isn't reused until the owner sees it, so this never fills
+	std::vector<VoiceEffect> mainEffects; // reserved up front, in the order they run
+	std::vector<f32> bus;
+	std::vector<f32> scratch;
+	std::vector<f32> effectScratch; // units can't work in place, so they bounce between this and scratch (or bus)
+	std::atomic<u64> sequence; // odd while a block's positions and clock are being written, so readers can retry
+	std::atomic<u64> clock;
+	std::atomic<f32> load;
+	std::ofstream wavFile;
+	u64 wavFrames;
+	std::unique_ptr<std::jthread> thread;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "SoundHandle.hpp"
+
+namespace Audio {
+	enum struct PlaybackEventType : i32 {
+		channelEnded = 0, // played to the end, was stopped, got stolen, or was cancelled while waiting on its load
+		playFailed = 1, // never started. the sound failed to load or was already gone, or fmod refused the channel
+		soundLoaded = 2,
+		loadFailed = 3,
+		soundEvicted = 4 // unloaded to get back under AudioEngineConfig::soundMemoryBudget. its handle is dead from here on
+	};
+
+	// things update() noticed, handed out by AudioEngine::pollEvent in the order they happened
+	struct PlaybackEvent {
+		PlaybackEventType type = PlaybackEventType::channelEnded;
+		i32 channelId = 0; // 0 for the load events
+		SoundHandle sound{};
+	};
+};
@@ -0,0 +1,183 @@
+
+#include "pch.h"
+
+#include "PoolAllocator.hpp"
+
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+	// the critical sections are a handful of pointer moves, not worth parking a thread over
+	struct SpinGuard {
+		std::atomic_flag& flag;
+		explicit SpinGuard(std::atomic_flag& flag) : flag{flag} {
+			while (this->flag.test_and_set(std::memory_order_acquire)) {
+				while (this->flag.test(std::memory_order_relaxed)) {}
+			}
+		}
+		~SpinGuard() {
+			this->flag.clear(std::memory_order_release);
+		}
+	};
+};
+
+PoolAllocator::PoolAllocator() :
+	arena{nullptr},
+	arenaBytes{0},
+	pageClasses{},
+	nextPage{0},
+	classes{},
+	usedBytes{0},
+	peakBytes{0},
+	fallbacks{0},
+	fallbackBytes{0},
+	reserved{false}
+{}
+
+PoolAllocator::~PoolAllocator() {
+	delete[] this->arena;
+}
+
+auto PoolAllocator::shared() -> PoolAllocator& {
+	static PoolAllocator* pool = new PoolAllocator();
+	return *pool;
+}
+
+auto PoolAllocator::reserve(u64 arenaBytes) -> bool {
+	const u64 pages = arenaBytes / pageBytes;
+	if (pages == 0 || this->reserved.exchange(true))
+		return false;
+	this->arena = new (std::nothrow) u8[pages * pageBytes];
+	if (!this->arena)
+		return false;
+	this->pageClasses = std::make_unique<std::atomic<u8>[]>(pages);
+	this->arenaBytes = pages * pageBytes;
+	return true;
+}
+
+auto PoolAllocator::classOf(size_t size) -> u32 {
+	return size <= minBlock ? 0 : static_cast<u32>(std::bit_width(size - 1)) - 4;
+}
+
+auto PoolAllocator::classSize(u32 sizeClass) -> size_t {
+	return minBlock << sizeClass;
+}
+
+auto PoolAllocator::inArena(const void* block) const -> bool {
+	const u8* bytes = static_cast<const u8*>(block);
+	return bytes >= this->arena && bytes < this->arena + this->arenaBytes;
+}
+
+auto PoolAllocator::blockSize(const void* block) const -> size_t {
+	if (this->inArena(block))
+		return classSize(this->pageClasses[(static_cast<const u8*>(block) - this->arena) / pageBytes].load(std::memory_order_relaxed));
+	return (static_cast<const FallbackHeader*>(block) - 1)->size;
+}
+
+auto PoolAllocator::carvePage() -> u8* {
+	const u64 page = this->nextPage.fetch_add(1, std::memory_order_relaxed);
+	if (page >= this->arenaBytes / pageBytes)
+		return nullptr; // left past the end, so the count tops out instead of wrapping
+	return this->arena + page * pageBytes;
+}
+
+auto PoolAllocator::noteUsed(size_t bytes) -> void {
+	const u64 used = this->usedBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	u64 peak = this->peakBytes.load(std::memory_order_relaxed);
+	while (used > peak && !this->peakBytes.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {}
+}
+
+auto PoolAllocator::allocate(size_t size) -> void* {
+	if (size > pageBytes || !this->arena)
+		return this->allocateFallback(size);
+	const u32 sizeClass = classOf(size);
+	const size_t bytes = classSize(sizeClass);
+	SizeClass& slot = this->classes[sizeClass];
+	void* block = nullptr;
+	{
+		SpinGuard guard(slot.lock);
+		if (slot.freeList) {
+			block = slot.freeList;
+			slot.freeList = slot.freeList->next;
+		}
+		else {
+			if (slot.bumpStart == slot.bumpEnd) { // classes divide a page evenly, so it's either full or has room
+				u8* page = this->carvePage();
+				if (page) {
+					this->pageClasses[(page - this->arena) / pageBytes].store(static_cast<u8>(sizeClass), std::memory_order_relaxed);
+					slot.bumpStart = page;
+					slot.bumpEnd = page + pageBytes;
+				}
+			}
+			if (slot.bumpStart != slot.bumpEnd) {
+				block = slot.bumpStart;
+				slot.bumpStart += bytes;
+			}
+		}
+	}
+	if (!block)
+		return this->allocateFallback(size); // arena's used up
+	this->noteUsed(bytes);
+	return block;
+}
+
+auto PoolAllocator::allocateFallback(size_t size) -> void* {
+	auto* header = static_cast<FallbackHeader*>(std::malloc(sizeof(FallbackHeader) + size));
+	if (!header)
+		return nullptr;
+	header->size = size;
+	this->fallbacks.fetch_add(1, std::memory_order_relaxed);
+	this->fallbackBytes.fetch_add(size, std::memory_order_relaxed);
+	return header + 1;
+}
+
+auto PoolAllocator::reallocate(void* block, size_t size) -> void* {
+	if (!block)
+		return this->allocate(size);
+	const size_t oldSize = this->blockSize(block);
+	if (this->inArena(block) && size <= pageBytes && classOf(size) == classOf(oldSize))
+		return block; // still the same class, nothing to move
+	void* moved = this->allocate(size);
+	if (!moved)
+		return nullptr; // like realloc, the old block is still good
+	std::memcpy(moved, block, oldSize < size ? oldSize : size);
+	this->deallocate(block);
+	return moved;
+}
+
+auto PoolAllocator::deallocate(void* block) -> void {
+	if (!block)
+		return;
+	if (!this->inArena(block)) {
+		auto* header = static_cast<FallbackHeader*>(block) - 1;
+		this->fallbackBytes.fetch_sub(header->size, std::memory_order_relaxed);
+		std::free(header);
+		return;
+	}
+	const u32 sizeClass = this->pageClasses[(static_cast<u8*>(block) - this->arena) / pageBytes].load(std::memory_order_relaxed);
+	SizeClass& slot = this->classes[sizeClass];
+	{
+		SpinGuard guard(slot.lock);
+		auto* freed = static_cast<FreeBlock*>(block);
+		freed->next = slot.freeList;
+		slot.freeList = freed;
+	}
+	this->usedBytes.fetch_sub(classSize(sizeClass), std::memory_order_relaxed);
+}
+
+auto PoolAllocator::getStats() const -> Stats {
+	Stats stats{};
+	const u64 pages = this->arenaBytes / pageBytes;
+	const u64 carvedPages = this->nextPage.load(std::memory_order_relaxed);
+	stats.arenaBytes = this->arenaBytes;
+	stats.carvedBytes = (carvedPages < pages ? carvedPages : pages) * pageBytes;
+	stats.usedBytes = this->usedBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = this->peakBytes.load(std::memory_order_relaxed);
+	stats.fallbacks = this->fallbacks.load(std::memory_order_relaxed);
+	stats.fallbackBytes = this->fallbackBytes.load(std::memory_order_relaxed);
+	// the untouched rest of each class's newest page counts as free here too, it's just as stuck
+	if (stats.carvedBytes > 0 && stats.usedBytes <= stats.carvedBytes)
+		stats.fragmentation = static_cast<f32>(stats.carvedBytes - stats.usedBytes) / static_cast<f32>(stats.carvedBytes);
+	return stats;
+}
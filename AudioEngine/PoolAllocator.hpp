@@ -0,0 +1,110 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+/*
+	general purpose allocator over one arena reserved up front, for fmod (through Memory_Initialize) and the engine's
+	own bookkeeping. requests round up to a power of 2 size class from 16 bytes to a whole page. pages get carved off
+	the arena as a class needs them and stay with that class for good, and freed blocks go on their class's free list,
+	so steady state allocation is a pop under a spinlock that's only ever held for a few instructions.
+	anything bigger than a page, or anything once the arena is used up, falls back to the system heap.
+	with no arena (reserve never called) everything falls back, which still keeps the stats.
+	safe from any thread
+*/
+class PoolAllocator {
+public:
+	static constexpr const size_t pageBytes = 64 * 1024;
+	static constexpr const size_t minBlock = 16; // also the alignment of everything handed out
+	static constexpr const u32 classCount = 13; // 16 bytes to 64kb
+
+	struct Stats {
+		u64 arenaBytes = 0;
+		u64 carvedBytes = 0; // arena pages given to size classes so far
+		u64 usedBytes = 0; // live blocks in the arena, at their class sizes
+		u64 peakBytes = 0; // high water mark of usedBytes
+		u64 fallbacks = 0; // allocations that went to the system heap instead
+		u64 fallbackBytes = 0; // live ones
+		// share of the carved arena sitting in free lists, where only its own size class can ever use it again
+		f32 fragmentation = 0.0f;
+	};
+
+	PoolAllocator();
+	~PoolAllocator();
+	PoolAllocator(const PoolAllocator&) = delete;
+	void operator=(const PoolAllocator&) = delete;
+
+	// only the first call does anything, the arena can't move once blocks are out. false if it couldn't be allocated
+	auto reserve(u64 arenaBytes) -> bool;
+	auto allocate(size_t size) -> void*; // null only if the system heap is out too
+	auto reallocate(void* block, size_t size) -> void*; // block may be null
+	auto deallocate(void* block) -> void; // block may be null
+	auto getStats() const -> Stats;
+
+	// the engine's, never destroyed so late frees during static destruction still have somewhere to go
+	static auto shared() -> PoolAllocator&;
+
+private:
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+	struct SizeClass {
+		std::atomic_flag lock = ATOMIC_FLAG_INIT;
+		FreeBlock* freeList = nullptr;
+		u8* bumpStart = nullptr; // the rest of the newest page, before any of it's been handed out
+		u8* bumpEnd = nullptr;
+	};
+	// heap fallbacks carry this in front so frees and reallocs know their size
+	struct alignas(minBlock) FallbackHeader {
+		size_t size;
+	};
+
+	static auto classOf(size_t size) -> u32;
+	static auto classSize(u32 sizeClass) -> size_t;
+	auto inArena(const void* block) const -> bool;
+	auto blockSize(const void* block) const -> size_t; // usable size, class size or the fallback's size
+	auto allocateFallback(size_t size) -> void*;
+	auto carvePage() -> u8*; // null once the arena is used up
+	auto noteUsed(size_t bytes) -> void;
+
+	u8* arena;
+	u64 arenaBytes;
+	std::unique_ptr<std::atomic<u8>[]> pageClasses; // size class of every arena page, written once when it's carved
+	std::atomic<u64> nextPage;
+	std::array<SizeClass, classCount> classes;
+	std::atomic<u64> usedBytes;
+	std::atomic<u64> peakBytes;
+	std::atomic<u64> fallbacks;
+	std::atomic<u64> fallbackBytes;
+	std::atomic<bool> reserved;
+};
+
+// routes a standard container's nodes through PoolAllocator::shared()
+template<typename T>
+struct PoolStlAllocator {
+	typedef T value_type;
+
+	PoolStlAllocator() noexcept = default;
+	template<typename U>
+	PoolStlAllocator(const PoolStlAllocator<U>&) noexcept {}
+
+	auto allocate(size_t count) -> T* {
+		static_assert(alignof(T) <= PoolAllocator::minBlock, "pool blocks are only 16 byte aligned");
+		void* block = PoolAllocator::shared().allocate(count * sizeof(T));
+		if (!block)
+			throw std::bad_alloc();
+		return static_cast<T*>(block);
+	}
+	auto deallocate(T* block, size_t) noexcept -> void {
+		PoolAllocator::shared().deallocate(block);
+	}
+	template<typename U>
+	auto operator==(const PoolStlAllocator<U>&) const noexcept -> bool {
+		return true;
+	}
+};
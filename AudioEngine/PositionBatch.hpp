@@ -0,0 +1,69 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "Vec.hpp"
+
+#include <span>
+#include <mutex>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+/*
+	3d position updates collected between update()s, one array per field. callers on any thread append whole
+	spans under one short lock (vectors go in with a memcpy, a Vec3<f32> is just three floats, which is also all an FMOD_VECTOR is),
+	and the owner swaps the pending arrays out once per update() and walks them in one pass.
+*/
+class PositionBatch {
+public:
+	struct Entries {
+		std::vector<i32> channelIds;
+		std::vector<Audio::Vec3<f32>> positions;
+		std::vector<Audio::Vec3<f32>> velocities; // only meaningful where hasVelocity is set
+		std::vector<u8> hasVelocity;
+		std::vector<u32> sequences; // the write sequence of the append each entry came in with
+
+		auto size() const -> size_t {
+			return this->channelIds.size();
+		}
+		auto clear() -> void { // keeps capacity, so steady state appends don't allocate
+			this->channelIds.clear();
+			this->positions.clear();
+			this->velocities.clear();
+			this->hasVelocity.clear();
+			this->sequences.clear();
+		}
+	};
+
+	// any thread. entries past the shorter of channelIds/positions are ignored, and velocities are only used
+	// if there's one for every entry
+	auto append(std::span<const i32> channelIds, std::span<const Audio::Vec3<f32>> positions, std::span<const Audio::Vec3<f32>> velocities, u32 sequence) -> void {
+		const size_t count = std::min(channelIds.size(), positions.size());
+		if (count == 0) return;
+		const bool withVelocity = velocities.size() >= count;
+		std::lock_guard<std::mutex> guard(this->lock);
+		const size_t start = this->pending.size();
+		this->pending.channelIds.insert(this->pending.channelIds.end(), channelIds.begin(), channelIds.begin() + count);
+		this->pending.positions.resize(start + count);
+		std::memcpy(this->pending.positions.data() + start, positions.data(), count * sizeof(Audio::Vec3<f32>));
+		this->pending.velocities.resize(start + count); // zeroed when there aren't any, hasVelocity says to skip them
+		if (withVelocity)
+			std::memcpy(this->pending.velocities.data() + start, velocities.data(), count * sizeof(Audio::Vec3<f32>));
+		this->pending.hasVelocity.resize(start + count, withVelocity ? 1 : 0);
+		this->pending.sequences.resize(start + count, sequence);
+	}
+
+	// owner thread. everything appended so far, valid until the next take()
+	auto take() -> const Entries& {
+		this->applying.clear();
+		std::lock_guard<std::mutex> guard(this->lock);
+		std::swap(this->pending, this->applying);
+		return this->applying;
+	}
+
+private:
+	std::mutex lock;
+	Entries pending;
+	Entries applying;
+};
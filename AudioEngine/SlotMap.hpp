@@ -0,0 +1,117 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <vector>
+#include <mutex>
+#include <utility>
+
+// index into a SlotMap plus the generation it was handed out with. generation 0 is never valid
+struct SlotKey {
+	u32 index = 0;
+	u32 generation = 0;
+
+	auto operator==(const SlotKey&) const -> bool = default;
+};
+
+/*
+	hands out SlotKeys. lives apart from the SlotMap so keys can be given to a caller on any thread
+	while only the owning thread ever touches the stored values. released indices get their generation
+	bumped, so anyone still holding an old key just misses instead of finding whatever moved in after.
+*/
+class SlotKeyAllocator {
+public:
+	auto acquire() -> SlotKey {
+		std::lock_guard<std::mutex> lock(this->modificationLock);
+		if (!this->freeIndices.empty()) {
+			u32 index = this->freeIndices.back();
+			this->freeIndices.pop_back();
+			return SlotKey{ index, this->generations[index] };
+		}
+		this->generations.push_back(1);
+		return SlotKey{ static_cast<u32>(this->generations.size() - 1), 1 };
+	}
+
+	auto release(SlotKey key) -> void {
+		std::lock_guard<std::mutex> lock(this->modificationLock);
+		if (key.index >= this->generations.size() || this->generations[key.index] != key.generation)
+			return; // already released
+		if (++this->generations[key.index] == 0)
+			this->generations[key.index] = 1; // skip 0 on wrap so it stays invalid
+		this->freeIndices.push_back(key.index);
+	}
+
+private:
+	std::mutex modificationLock;
+	std::vector<u32> generations;
+	std::vector<u32> freeIndices;
+};
+
+/*
+	dense, index addressed storage. lookups are an index and a generation compare, no hashing or
+	string compares, and nothing allocates once the vector has grown to fit. not thread safe,
+	only the thread that owns the engine should touch it.
+*/
+template <typename T>
+class SlotMap {
+public:
+	auto insert(SlotKey key, T&& value) -> T& {
+		if (key.index >= this->slots.size())
+			this->slots.resize(key.index + 1);
+		Slot& slot = this->slots[key.index];
+		if (!slot.occupied)
+			this->count++;
+		slot.value = std::move(value);
+		slot.generation = key.generation;
+		slot.occupied = true;
+		return slot.value;
+	}
+
+	auto get(SlotKey key) -> T* {
+		if (key.index >= this->slots.size()) return nullptr;
+		Slot& slot = this->slots[key.index];
+		if (!slot.occupied || slot.generation != key.generation) return nullptr;
+		return &slot.value;
+	}
+
+	auto get(SlotKey key) const -> const T* {
+		return const_cast<SlotMap*>(this)->get(key);
+	}
+
+	auto erase(SlotKey key) -> bool {
+		T* value = this->get(key);
+		if (!value) return false;
+		*value = T{}; // let go of anything the value owns now instead of when the slot gets reused
+		this->slots[key.index].occupied = false;
+		this->count--;
+		return true;
+	}
+
+	// func(SlotKey, T&) for every occupied slot
+	template <typename Func>
+	auto forEach(Func&& func) -> void {
+		for (u32 i = 0; i < this->slots.size(); i++) {
+			if (this->slots[i].occupied)
+				func(SlotKey{ i, this->slots[i].generation }, this->slots[i].value);
+		}
+	}
+
+	auto clear() -> void {
+		this->slots.clear();
+		this->count = 0;
+	}
+
+	auto size() const -> size_t {
+		return this->count;
+	}
+
+private:
+	struct Slot {
+		T value{};
+		u32 generation = 0;
+		bool occupied = false;
+	};
+
+	std::vector<Slot> slots;
+	size_t count = 0;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+namespace Audio {
+	// returned by loadSound/loadSoundAsync. copying it around is free and using it skips the name lookup.
+	// handles to unloaded (or failed) sounds just stop working, they never point at a different sound
+	struct SoundHandle {
+		u32 index = 0;
+		u32 generation = 0; // 0 is never handed out
+
+		auto isValid() const -> bool {
+			return this->generation != 0;
+		}
+		auto operator==(const SoundHandle&) const -> bool = default;
+	};
+};
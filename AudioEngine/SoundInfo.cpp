@@ -15,34 +15,40 @@ namespace Audio {
 		to the sound map and channel map.
 	*/
 	SoundInfo::SoundInfo(void* sound, void* channel) {
+#ifndef AUDIOENGINE_NATIVE_ONLY
 		FMOD::Sound* s = reinterpret_cast<FMOD::Sound*>(sound); // gotta pull out the big guns i think
 		FMOD::Channel* c = nullptr;
 		if (channel)
 			c = reinterpret_cast<FMOD::Channel*>(channel);
 		this->impl = new SoundInfoImpl(s, c);
+#else
+		this->impl = new SoundInfoImpl(); // only the fmod backend hands out raw sounds
+#endif
 	}
 
+	SoundInfo::SoundInfo(SoundInfoImpl* details) : impl{details} {}
+
 	SoundInfo::~SoundInfo() {
 		delete (static_cast<SoundInfoImpl*>(this->impl));
 	}
 
-	auto SoundInfo::getName() -> const std::string& {
+	auto SoundInfo::getName() const -> const std::string& {
 		return static_cast<SoundInfoImpl*>(this->impl)->name;
 	}
 
-	auto SoundInfo::getFormat() -> const std::string& {
+	auto SoundInfo::getFormat() const -> const std::string& {
 		return static_cast<SoundInfoImpl*>(this->impl)->format;
 	}
 
-	auto SoundInfo::getDuration() -> std::chrono::milliseconds {
+	auto SoundInfo::getDuration() const -> std::chrono::milliseconds {
 		return static_cast<SoundInfoImpl*>(this->impl)->duration;
 	}
 
-	auto SoundInfo::getDurationPlayed() -> std::chrono::milliseconds {
+	auto SoundInfo::getDurationPlayed() const -> std::chrono::milliseconds {
 		return static_cast<SoundInfoImpl*>(this->impl)->durationPlayed;
 	}
 
-	auto SoundInfo::getTags() -> const std::unordered_map<std::string, std::string>& {
+	auto SoundInfo::getTags() const -> const std::unordered_map<std::string, std::string>& {
 		return static_cast<SoundInfoImpl*>(this->impl)->tags;
 	}
 };
@@ -2,7 +2,10 @@
 #include "pch.h"
 
 #include "SoundInfoImpl.hpp"
+#include "PoolAllocator.hpp"
 
+#include <algorithm>
+#include <cctype>
 
 constexpr const static auto stringEndTrim = [](std::string& s) {
 	s.erase(std::find_if(s.rbegin(), s.rend(), [](unsigned char ch) {
@@ -10,17 +13,35 @@ constexpr const static auto stringEndTrim = [](std::string& s) {
 	}).base(), s.end());
 };
 
+SoundInfoImpl::SoundInfoImpl() :
+	channels{0},
+	bitsPerSample{0},
+	duration{std::chrono::milliseconds::zero()},
+	durationPlayed{std::chrono::milliseconds::zero()},
+	tags{}
+{}
+
+auto SoundInfoImpl::operator new(size_t size) -> void* {
+	void* block = PoolAllocator::shared().allocate(size);
+	if (!block)
+		throw std::bad_alloc();
+	return block;
+}
+
+auto SoundInfoImpl::operator delete(void* block) -> void {
+	PoolAllocator::shared().deallocate(block);
+}
+
+// everything from here down reads an fmod sound
+#ifndef AUDIOENGINE_NATIVE_ONLY
 SoundInfoImpl::SoundInfoImpl(FMOD::Sound* sound, FMOD::Channel* channel) : tags{} {
 	constexpr const static auto nameBufferLength = 100;
 	// get name
-	char* nameBuffer = new char[nameBufferLength];
-	for (auto i = 0; i < nameBufferLength; i++) {
-		nameBuffer[i] = ' ';
-	}
+	char nameBuffer[nameBufferLength]; // fmod null terminates, no need to heap allocate or pre-fill this
+	nameBuffer[0] = '\0';
 	sound->getName(nameBuffer, nameBufferLength);
 	this->name = std::string(nameBuffer);
 	stringEndTrim(this->name);
-	delete[] nameBuffer;
 
 	// get format
 	FMOD_SOUND_TYPE typeEnum;
@@ -220,3 +241,4 @@ auto SoundInfoImpl::setTagData(FMOD_TAG t) -> void {
 	}
 	this->tags[tagName] = tagData;
 }
+#endif
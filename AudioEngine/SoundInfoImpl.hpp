@@ -2,7 +2,9 @@
 
 #include "PrimitiveTypes.hpp"
 
+#ifndef AUDIOENGINE_NATIVE_ONLY
 #include "fmod.hpp"
+#endif
 
 #include <string>
 #include <chrono>
@@ -18,10 +20,19 @@ struct SoundInfoImpl {
 	std::chrono::milliseconds durationPlayed;
 	std::unordered_map<std::string, std::string> tags;
 
+	SoundInfoImpl(); // empty, for the native backend to fill in
+#ifndef AUDIOENGINE_NATIVE_ONLY
 	SoundInfoImpl(FMOD::Sound* sound, FMOD::Channel* channel = nullptr);
+#endif
 
+	// one of these per loaded sound and per getSoundInfo call, small and churned, so they come out of the engine's pool
+	static auto operator new(size_t size) -> void*;
+	static auto operator delete(void* block) -> void;
+
+#ifndef AUDIOENGINE_NATIVE_ONLY
 private:
 	auto setFormat(FMOD_SOUND_FORMAT f) -> void;
 	auto setType(FMOD_SOUND_TYPE t) -> void;
 	auto setTagData(FMOD_TAG t) -> void;
+#endif
 };
@@ -0,0 +1,146 @@
+
+#include "pch.h"
+
+#include "SoundMetadata.hpp"
+
+#include "SoundInfoImpl.hpp"
+#include "LoudnessMeter.hpp"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+	constexpr const u32 decodeFrames = 16384; // per readData call
+
+	auto bytesPerSample(FMOD_SOUND_FORMAT format) -> u32 {
+		switch (format) {
+			case FMOD_SOUND_FORMAT_PCM8: return 1;
+			case FMOD_SOUND_FORMAT_PCM16: return 2;
+			case FMOD_SOUND_FORMAT_PCM24: return 3;
+			case FMOD_SOUND_FORMAT_PCM32:
+			case FMOD_SOUND_FORMAT_PCMFLOAT: return 4;
+			default: return 0; // bitstream and friends, nothing we can measure
+		}
+	}
+
+	// readData hands back the decoder's own format, little endian signed ints or floats
+	auto toFloat(const u8* raw, FMOD_SOUND_FORMAT format, size_t samples, f32* out) -> void {
+		for (size_t i = 0; i < samples; i++) {
+			switch (format) {
+				case FMOD_SOUND_FORMAT_PCM8:
+					out[i] = static_cast<i8>(raw[i]) / 128.0f;
+					break;
+				case FMOD_SOUND_FORMAT_PCM16: {
+					i16 value;
+					std::memcpy(&value, raw + i * 2, sizeof(value));
+					out[i] = value / 32768.0f;
+					break;
+				}
+				case FMOD_SOUND_FORMAT_PCM24: {
+					const u8* b = raw + i * 3;
+					i32 value = static_cast<i32>((static_cast<u32>(b[0]) << 8) | (static_cast<u32>(b[1]) << 16) | (static_cast<u32>(b[2]) << 24)) >> 8;
+					out[i] = value / 8388608.0f;
+					break;
+				}
+				case FMOD_SOUND_FORMAT_PCM32: {
+					i32 value;
+					std::memcpy(&value, raw + i * 4, sizeof(value));
+					out[i] = static_cast<f32>(value / 2147483648.0);
+					break;
+				}
+				default:
+					std::memcpy(out + i, raw + i * 4, sizeof(f32));
+					break;
+			}
+		}
+	}
+};
+
+namespace Audio {
+	MetadataReader::MetadataReader() : system{nullptr} {
+		FMOD::System* s = nullptr;
+		if (FMOD::System_Create(&s) != FMOD_OK)
+			return;
+		// nothing ever plays through this system, so skip the output device entirely
+		if (s->setOutput(FMOD_OUTPUTTYPE_NOSOUND) != FMOD_OK || s->init(1, FMOD_INIT_NORMAL, nullptr) != FMOD_OK) {
+			s->release();
+			return;
+		}
+		this->system = s;
+	}
+
+	MetadataReader::~MetadataReader() {
+		if (this->system)
+			static_cast<FMOD::System*>(this->system)->release();
+	}
+
+	auto MetadataReader::isValid() const -> bool {
+		return this->system != nullptr;
+	}
+
+	auto MetadataReader::read(const std::string& path, SoundMetadata& out) -> bool {
+		if (!this->system)
+			return false;
+		FMOD::Sound* sound = nullptr;
+		// openonly parses the header and tags but never creates a decoder or reads sample data
+		auto result = static_cast<FMOD::System*>(this->system)->createSound(path.c_str(), FMOD_OPENONLY, nullptr, &sound);
+		if (result != FMOD_OK || !sound)
+			return false;
+		SoundInfoImpl info(sound);
+		out.type = std::move(info.type);
+		out.format = std::move(info.format);
+		out.channels = info.channels;
+		out.bitsPerSample = info.bitsPerSample;
+		out.duration = info.duration;
+		out.tags = std::move(info.tags);
+		f32 frequency = 0.0f;
+		sound->getDefaults(&frequency, nullptr);
+		out.sampleRate = frequency;
+		sound->release();
+		return true;
+	}
+
+	auto MetadataReader::analyzeLoudness(const std::string& path, LoudnessInfo& out) -> bool {
+		if (!this->system)
+			return false;
+		FMOD::Sound* sound = nullptr;
+		auto result = static_cast<FMOD::System*>(this->system)->createSound(path.c_str(), FMOD_OPENONLY, nullptr, &sound);
+		if (result != FMOD_OK || !sound)
+			return false;
+		FMOD_SOUND_FORMAT format = FMOD_SOUND_FORMAT_NONE;
+		i32 channels = 0;
+		f32 frequency = 0.0f;
+		sound->getFormat(nullptr, &format, &channels, nullptr);
+		sound->getDefaults(&frequency, nullptr);
+		const u32 sampleBytes = bytesPerSample(format);
+		if (sampleBytes == 0 || channels <= 0 || frequency <= 0.0f) {
+			sound->release();
+			return false;
+		}
+
+		LoudnessMeter meter(static_cast<u32>(frequency), channels);
+		const u32 frameBytes = sampleBytes * channels;
+		std::vector<u8> raw(static_cast<size_t>(decodeFrames) * frameBytes);
+		std::vector<f32> pcm(static_cast<size_t>(decodeFrames) * channels);
+		bool decoded = true;
+		while (true) {
+			u32 read = 0;
+			result = sound->readData(raw.data(), static_cast<u32>(raw.size()), &read);
+			const u32 frames = read / frameBytes;
+			toFloat(raw.data(), format, static_cast<size_t>(frames) * channels, pcm.data());
+			meter.add(pcm.data(), frames);
+			if (result == FMOD_ERR_FILE_EOF || (result == FMOD_OK && read == 0))
+				break;
+			if (result != FMOD_OK) {
+				decoded = false; // corrupt partway through, a partial answer would just be wrong
+				break;
+			}
+		}
+		sound->release();
+		if (!decoded)
+			return false;
+		out.integratedLufs = meter.integratedLoudness();
+		out.truePeakdB = meter.truePeakdB();
+		return true;
+	}
+};
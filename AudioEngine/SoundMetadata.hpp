@@ -0,0 +1,55 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <string>
+#include <chrono>
+#include <limits>
+#include <unordered_map>
+
+#ifndef _WIN32
+#define AUDIOENGINE_API
+#elif defined(AUDIOENGINE_EXPORTS)
+#define AUDIOENGINE_API __declspec(dllexport)
+#else
+#define AUDIOENGINE_API __declspec(dllimport)
+#endif
+
+namespace Audio {
+	// everything we can learn about a file from its header without decoding any audio
+	struct SoundMetadata {
+		std::string type; // container/codec, same strings as SoundInfo
+		std::string format;
+		i32 channels = 0;
+		i32 bitsPerSample = 0;
+		f32 sampleRate = 0.0f;
+		std::chrono::milliseconds duration = std::chrono::milliseconds::zero();
+		std::unordered_map<std::string, std::string> tags;
+	};
+
+	// from decoding a whole file, see analyzeLoudness. -inf for silence
+	struct LoudnessInfo {
+		f32 integratedLufs = -std::numeric_limits<f32>::infinity(); // ITU-R BS.1770 / EBU R128 integrated loudness
+		f32 truePeakdB = -std::numeric_limits<f32>::infinity(); // dBTP, from 4x oversampling
+	};
+
+	// opens files in FMOD_OPENONLY mode on a private, silent fmod system. each reader owns its own
+	// system so readers on different threads never contend on the engine's api lock (or the engine at all),
+	// which is what lets a library-wide metadata pass run one reader per worker thread.
+	// a single reader is not thread safe.
+	class MetadataReader {
+	public:
+		AUDIOENGINE_API MetadataReader();
+		AUDIOENGINE_API ~MetadataReader();
+		MetadataReader(const MetadataReader&) = delete;
+		void operator=(const MetadataReader&) = delete;
+
+		AUDIOENGINE_API auto isValid() const -> bool;
+		AUDIOENGINE_API auto read(const std::string& path, SoundMetadata& out) -> bool;
+		// decodes the whole file with Sound::readData, so this costs as much as the codec does (a few seconds per song
+		// for mp3 on one core). meant for a one time pass over a library with the results cached
+		AUDIOENGINE_API auto analyzeLoudness(const std::string& path, LoudnessInfo& out) -> bool;
+	private:
+		void* system; // FMOD::System*, see SoundInfo for why this is a void*
+	};
+};
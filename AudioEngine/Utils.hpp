@@ -2,7 +2,9 @@
 
 #include "PrimitiveTypes.hpp"
 
-#ifdef AUDIOENGINE_EXPORTS
+#ifndef _WIN32
+#define AUDIOENGINE_API
+#elif defined(AUDIOENGINE_EXPORTS)
 #define AUDIOENGINE_API __declspec(dllexport)
 #else
 #define AUDIOENGINE_API __declspec(dllimport)
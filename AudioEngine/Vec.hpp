@@ -1,8 +1,58 @@
 #pragma once
 
+#include <cmath>
+
 namespace Audio {
 	template <typename T>
 	struct Vec3 {
 		T x, y, z;
 	};
-};
\ No newline at end of file
+
+	// plain per-vector math. for many vectors at once, see the span kernels in VecMath.hpp
+	template <typename T>
+	constexpr auto operator+(const Vec3<T>& a, const Vec3<T>& b) -> Vec3<T> {
+		return Vec3<T>{ a.x + b.x, a.y + b.y, a.z + b.z };
+	}
+	template <typename T>
+	constexpr auto operator-(const Vec3<T>& a, const Vec3<T>& b) -> Vec3<T> {
+		return Vec3<T>{ a.x - b.x, a.y - b.y, a.z - b.z };
+	}
+	template <typename T>
+	constexpr auto operator*(const Vec3<T>& v, T s) -> Vec3<T> {
+		return Vec3<T>{ v.x * s, v.y * s, v.z * s };
+	}
+	template <typename T>
+	constexpr auto operator*(T s, const Vec3<T>& v) -> Vec3<T> {
+		return v * s;
+	}
+	template <typename T>
+	constexpr auto operator==(const Vec3<T>& a, const Vec3<T>& b) -> bool {
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	template <typename T>
+	constexpr auto dot(const Vec3<T>& a, const Vec3<T>& b) -> T {
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+	template <typename T>
+	constexpr auto cross(const Vec3<T>& a, const Vec3<T>& b) -> Vec3<T> {
+		return Vec3<T>{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+	template <typename T>
+	constexpr auto lengthSquared(const Vec3<T>& v) -> T {
+		return dot(v, v);
+	}
+	template <typename T>
+	auto length(const Vec3<T>& v) -> T {
+		return std::sqrt(lengthSquared(v));
+	}
+	template <typename T>
+	auto distance(const Vec3<T>& a, const Vec3<T>& b) -> T {
+		return length(a - b);
+	}
+	template <typename T>
+	auto normalized(const Vec3<T>& v) -> Vec3<T> { // zero stays zero instead of turning into nans
+		T len = length(v);
+		return len > T{} ? v * (T{1} / len) : v;
+	}
+};
@@ -0,0 +1,399 @@
+
+#include "pch.h"
+
+#include "VecMath.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__AVX2__)
+#define AUDIO_SIMD_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AUDIO_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+	constexpr const f32 log2Of10Over20 = 0.166096404744368f; // 10^(dB/20) == 2^(dB * this)
+	constexpr const f32 twentyLog10Of2 = 6.020599913279624f; // 20*log10(v) == this * log2(v)
+	constexpr const f32 exp2Limit = 126.0f; // keeps the exponent bits in range, 2^126 is way past any real gain
+	constexpr const f32 sqrt2 = 1.41421356237f;
+	constexpr const f32 twoOverLn2 = 2.88539008178f;
+
+	// 2^f for f in [-0.5, 0.5] (cephes exp2f). shared by every width so the tails match the vector part exactly
+	constexpr const f32 exp2c5 = 1.535336188319500e-4f;
+	constexpr const f32 exp2c4 = 1.339887440266574e-3f;
+	constexpr const f32 exp2c3 = 9.618437357674640e-3f;
+	constexpr const f32 exp2c2 = 5.550332471162809e-2f;
+	constexpr const f32 exp2c1 = 2.402264791363012e-1f;
+	constexpr const f32 exp2c0 = 6.931472028550421e-1f;
+
+	auto exp2Approx(f32 x) -> f32 {
+		x = std::clamp(x, -exp2Limit, exp2Limit);
+		f32 whole = std::nearbyint(x);
+		f32 f = x - whole;
+		f32 p = ((((((exp2c5 * f + exp2c4) * f + exp2c3) * f + exp2c2) * f + exp2c1) * f + exp2c0) * f) + 1.0f;
+		u32 bits = static_cast<u32>(static_cast<i32>(whole) + 127) << 23;
+		f32 scale;
+		std::memcpy(&scale, &bits, sizeof(scale));
+		return p * scale;
+	}
+
+	// splits into exponent and a mantissa in [sqrt(1/2), sqrt(2)), then atanh series: log2(m) = 2/ln2 * atanh((m-1)/(m+1))
+	auto log2Approx(f32 x) -> f32 {
+		if (!(x > 0.0f))
+			return -std::numeric_limits<f32>::infinity();
+		x = std::max(x, std::numeric_limits<f32>::min()); // denormals would throw the exponent off
+		u32 bits;
+		std::memcpy(&bits, &x, sizeof(bits));
+		f32 exponent = static_cast<f32>(static_cast<i32>(bits >> 23) - 127);
+		bits = (bits & 0x007FFFFFu) | 0x3F800000u;
+		f32 m;
+		std::memcpy(&m, &bits, sizeof(m));
+		if (m > sqrt2) {
+			m *= 0.5f;
+			exponent += 1.0f;
+		}
+		f32 t = (m - 1.0f) / (m + 1.0f);
+		f32 t2 = t * t;
+		f32 series = t * (1.0f + t2 * (1.0f / 3.0f + t2 * (1.0f / 5.0f + t2 * (1.0f / 7.0f))));
+		return exponent + twoOverLn2 * series;
+	}
+
+	auto rolloff(f32 distance, f32 minDistance, f32 maxDistance) -> f32 {
+		return minDistance / std::clamp(distance, minDistance, maxDistance);
+	}
+
+#if AUDIO_SIMD_AVX2
+	constexpr const size_t width = 8;
+	typedef __m256 Floats;
+
+	auto exp2Wide(__m256 x) -> __m256 {
+		x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-exp2Limit)), _mm256_set1_ps(exp2Limit));
+		__m256 whole = _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256 f = _mm256_sub_ps(x, whole);
+		__m256 p = _mm256_set1_ps(exp2c5);
+		p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(exp2c4));
+		p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(exp2c3));
+		p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(exp2c2));
+		p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(exp2c1));
+		p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(exp2c0));
+		p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+		__m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23);
+		return _mm256_mul_ps(p, _mm256_castsi256_ps(bits));
+	}
+
+	auto log2Wide(__m256 x) -> __m256 {
+		__m256 nonPositive = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_NGT_UQ); // also catches nan
+		x = _mm256_max_ps(x, _mm256_set1_ps(std::numeric_limits<f32>::min()));
+		__m256i bits = _mm256_castps_si256(x);
+		__m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+		__m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000)));
+		__m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(sqrt2), _CMP_GT_OQ);
+		m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+		exponent = _mm256_add_ps(exponent, _mm256_and_ps(big, _mm256_set1_ps(1.0f)));
+		__m256 one = _mm256_set1_ps(1.0f);
+		__m256 t = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+		__m256 t2 = _mm256_mul_ps(t, t);
+		__m256 series = _mm256_add_ps(_mm256_mul_ps(t2, _mm256_set1_ps(1.0f / 7.0f)), _mm256_set1_ps(1.0f / 5.0f));
+		series = _mm256_add_ps(_mm256_mul_ps(t2, series), _mm256_set1_ps(1.0f / 3.0f));
+		series = _mm256_add_ps(_mm256_mul_ps(t2, series), one);
+		series = _mm256_mul_ps(t, series);
+		__m256 result = _mm256_add_ps(exponent, _mm256_mul_ps(_mm256_set1_ps(twoOverLn2), series));
+		return _mm256_blendv_ps(result, _mm256_set1_ps(-std::numeric_limits<f32>::infinity()), nonPositive);
+	}
+
+	auto load(const f32* p) -> Floats { return _mm256_loadu_ps(p); }
+	auto store(f32* p, Floats v) -> void { _mm256_storeu_ps(p, v); }
+	auto splat(f32 v) -> Floats { return _mm256_set1_ps(v); }
+	auto add(Floats a, Floats b) -> Floats { return _mm256_add_ps(a, b); }
+	auto sub(Floats a, Floats b) -> Floats { return _mm256_sub_ps(a, b); }
+	auto mul(Floats a, Floats b) -> Floats { return _mm256_mul_ps(a, b); }
+	auto div(Floats a, Floats b) -> Floats { return _mm256_div_ps(a, b); }
+	auto min(Floats a, Floats b) -> Floats { return _mm256_min_ps(a, b); }
+	auto max(Floats a, Floats b) -> Floats { return _mm256_max_ps(a, b); }
+	auto sqrt(Floats a) -> Floats { return _mm256_sqrt_ps(a); }
+	auto absolute(Floats a) -> Floats { return _mm256_and_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF))); }
+
+	// 8 stereo frames from two loads of [l r l r ...], one peak per frame in frame order
+	auto stereoPeaks(Floats a, Floats b) -> Floats {
+		a = absolute(a);
+		b = absolute(b);
+		Floats peaks = _mm256_max_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		// the shuffles work per 128 bit lane, which leaves frames 0 1 4 5 2 3 6 7
+		return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(peaks), _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+	// 8 gains spread over 16 interleaved stereo samples, as two registers of [g0 g0 g1 g1 ...]
+	auto stereoGains(Floats gains, Floats& first, Floats& second) -> void {
+		Floats low = _mm256_unpacklo_ps(gains, gains); // g0 g0 g1 g1 | g4 g4 g5 g5
+		Floats high = _mm256_unpackhi_ps(gains, gains); // g2 g2 g3 g3 | g6 g6 g7 g7
+		first = _mm256_permute2f128_ps(low, high, 0x20);
+		second = _mm256_permute2f128_ps(low, high, 0x31);
+	}
+	auto alternate(f32 a, f32 b) -> Floats { return _mm256_setr_ps(a, b, a, b, a, b, a, b); }
+	// which frame each float of a stereo register belongs to
+	auto stereoFrameOffsets() -> Floats { return _mm256_setr_ps(0, 0, 1, 1, 2, 2, 3, 3); }
+#elif AUDIO_SIMD_SSE2
+	constexpr const size_t width = 4;
+	typedef __m128 Floats;
+
+	auto exp2Wide(__m128 x) -> __m128 {
+		x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-exp2Limit)), _mm_set1_ps(exp2Limit));
+		__m128i wholeInt = _mm_cvtps_epi32(x); // rounds to nearest under the default mxcsr
+		__m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(wholeInt));
+		__m128 p = _mm_set1_ps(exp2c5);
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(exp2c4));
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(exp2c3));
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(exp2c2));
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(exp2c1));
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(exp2c0));
+		p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+		__m128i bits = _mm_slli_epi32(_mm_add_epi32(wholeInt, _mm_set1_epi32(127)), 23);
+		return _mm_mul_ps(p, _mm_castsi128_ps(bits));
+	}
+
+	auto log2Wide(__m128 x) -> __m128 {
+		__m128 nonPositive = _mm_cmpngt_ps(x, _mm_setzero_ps()); // also catches nan
+		x = _mm_max_ps(x, _mm_set1_ps(std::numeric_limits<f32>::min()));
+		__m128i bits = _mm_castps_si128(x);
+		__m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+		__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+		__m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(sqrt2));
+		m = _mm_or_ps(_mm_andnot_ps(big, m), _mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5f)))); // no blendv before sse4.1
+		exponent = _mm_add_ps(exponent, _mm_and_ps(big, _mm_set1_ps(1.0f)));
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+		__m128 t2 = _mm_mul_ps(t, t);
+		__m128 series = _mm_add_ps(_mm_mul_ps(t2, _mm_set1_ps(1.0f / 7.0f)), _mm_set1_ps(1.0f / 5.0f));
+		series = _mm_add_ps(_mm_mul_ps(t2, series), _mm_set1_ps(1.0f / 3.0f));
+		series = _mm_add_ps(_mm_mul_ps(t2, series), one);
+		series = _mm_mul_ps(t, series);
+		__m128 result = _mm_add_ps(exponent, _mm_mul_ps(_mm_set1_ps(twoOverLn2), series));
+		__m128 negativeInfinity = _mm_set1_ps(-std::numeric_limits<f32>::infinity());
+		return _mm_or_ps(_mm_andnot_ps(nonPositive, result), _mm_and_ps(nonPositive, negativeInfinity));
+	}
+
+	auto load(const f32* p) -> Floats { return _mm_loadu_ps(p); }
+	auto store(f32* p, Floats v) -> void { _mm_storeu_ps(p, v); }
+	auto splat(f32 v) -> Floats { return _mm_set1_ps(v); }
+	auto add(Floats a, Floats b) -> Floats { return _mm_add_ps(a, b); }
+	auto sub(Floats a, Floats b) -> Floats { return _mm_sub_ps(a, b); }
+	auto mul(Floats a, Floats b) -> Floats { return _mm_mul_ps(a, b); }
+	auto div(Floats a, Floats b) -> Floats { return _mm_div_ps(a, b); }
+	auto min(Floats a, Floats b) -> Floats { return _mm_min_ps(a, b); }
+	auto max(Floats a, Floats b) -> Floats { return _mm_max_ps(a, b); }
+	auto sqrt(Floats a) -> Floats { return _mm_sqrt_ps(a); }
+	auto absolute(Floats a) -> Floats { return _mm_and_ps(a, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF))); }
+
+	// 4 stereo frames from two loads of [l r l r], one peak per frame
+	auto stereoPeaks(Floats a, Floats b) -> Floats {
+		a = absolute(a);
+		b = absolute(b);
+		return _mm_max_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+	// 4 gains spread over 8 interleaved stereo samples
+	auto stereoGains(Floats gains, Floats& first, Floats& second) -> void {
+		first = _mm_unpacklo_ps(gains, gains);
+		second = _mm_unpackhi_ps(gains, gains);
+	}
+	auto alternate(f32 a, f32 b) -> Floats { return _mm_setr_ps(a, b, a, b); }
+	auto stereoFrameOffsets() -> Floats { return _mm_setr_ps(0, 0, 1, 1); }
+#endif
+
+	auto framePeaksScalar(const f32* interleaved, i32 channels, size_t start, size_t frames, f32* peaks) -> void {
+		for (size_t f = start; f < frames; f++) {
+			f32 peak = 0.0f;
+			for (i32 c = 0; c < channels; c++)
+				peak = std::max(peak, std::fabs(interleaved[f * channels + c]));
+			peaks[f] = peak;
+		}
+	}
+
+	auto applyFrameGainsScalar(const f32* interleaved, i32 channels, const f32* gains, size_t start, size_t frames, f32* out) -> void {
+		for (size_t f = start; f < frames; f++) {
+			for (i32 c = 0; c < channels; c++)
+				out[f * channels + c] = interleaved[f * channels + c] * gains[f];
+		}
+	}
+
+	auto mixStereoScalar(const f32* stereo, f32 leftFrom, f32 rightFrom, f32 leftStep, f32 rightStep, size_t start, size_t frames, f32* bus) -> void {
+		for (size_t f = start; f < frames; f++) {
+			bus[f * 2] += stereo[f * 2] * (leftFrom + leftStep * f);
+			bus[f * 2 + 1] += stereo[f * 2 + 1] * (rightFrom + rightStep * f);
+		}
+	}
+};
+
+namespace Audio {
+	auto getSimdLevel() -> SimdLevel {
+#if AUDIO_SIMD_AVX2
+		return SimdLevel::avx2;
+#elif AUDIO_SIMD_SSE2
+		return SimdLevel::sse2;
+#else
+		return SimdLevel::scalar;
+#endif
+	}
+
+	// each kernel runs full vectors first and finishes the last few floats with the matching scalar approximation
+	auto dBToVolume(std::span<const f32> dB, std::span<f32> volume) -> void {
+		const size_t count = std::min(dB.size(), volume.size());
+		size_t i = 0;
+#if AUDIO_SIMD_AVX2 || AUDIO_SIMD_SSE2
+		for (; i + width <= count; i += width)
+			store(&volume[i], exp2Wide(mul(load(&dB[i]), splat(log2Of10Over20))));
+#endif
+		for (; i < count; i++)
+			volume[i] = exp2Approx(dB[i] * log2Of10Over20);
+	}
+
+	auto volumeTodB(std::span<const f32> volume, std::span<f32> dB) -> void {
+		const size_t count = std::min(volume.size(), dB.size());
+		size_t i = 0;
+#if AUDIO_SIMD_AVX2 || AUDIO_SIMD_SSE2
+		for (; i + width <= count; i += width)
+			store(&dB[i], mul(log2Wide(load(&volume[i])), splat(twentyLog10Of2)));
+#endif
+		for (; i < count; i++)
+			dB[i] = log2Approx(volume[i]) * twentyLog10Of2;
+	}
+
+	auto distances(const Vec3<f32>& from, std::span<const f32> xs, std::span<const f32> ys, std::span<const f32> zs, std::span<f32> out) -> void {
+		const size_t count = std::min({ xs.size(), ys.size(), zs.size(), out.size() });
+		size_t i = 0;
+#if AUDIO_SIMD_AVX2 || AUDIO_SIMD_SSE2
+		const Floats fx = splat(from.x), fy = splat(from.y), fz = splat(from.z);
+		for (; i + width <= count; i += width) {
+			Floats dx = sub(load(&xs[i]), fx);
+			Floats dy = sub(load(&ys[i]), fy);
+			Floats dz = sub(load(&zs[i]), fz);
+			store(&out[i], sqrt(add(add(mul(dx, dx), mul(dy, dy)), mul(dz, dz))));
+		}
+#endif
+		for (; i < count; i++)
+			out[i] = distance(from, Vec3<f32>{ xs[i], ys[i], zs[i] });
+	}
+
+	auto inverseRolloff(std::span<const f32> distances, f32 minDistance, f32 maxDistance, std::span<f32> gains) -> void {
+		const size_t count = std::min(distances.size(), gains.size());
+		minDistance = std::max(minDistance, std::numeric_limits<f32>::min()); // fmod requires > 0 too
+		maxDistance = std::max(maxDistance, minDistance);
+		size_t i = 0;
+#if AUDIO_SIMD_AVX2 || AUDIO_SIMD_SSE2
+		const Floats low = splat(minDistance), high = splat(maxDistance);
+		for (; i + width <= count; i += width)
+			store(&gains[i], div(low, min(max(load(&distances[i]), low), high)));
+#endif
+		for (; i < count; i++)
+			gains[i] = rolloff(distances[i], minDistance, maxDistance);
+	}
+
+	auto framePeaks(std::span<const f32> interleaved, i32 channels, std::span<f32> peaks) -> void {
+		if (channels <= 0) return;
+		const size_t frames = std::min(interleaved.size() / channels, peaks.size());
+		size_t f = 0;
+#if AUDIO_SIMD_AVX2 || AUDIO_SIMD_SSE2
+		if (channels == 1) {
+			for (; f + width <= frames; f += width)
+				store(&peaks[f], absolute(load(&interleaved[f])));
+		}
+		else if (channels == 2) {
+			for (; f + width <= frames; f += width)
+				store(&peaks[f], stereoPeaks(load(&interleaved[f * 2]), load(&interleaved[f * 2 + width])));
+		}
+#endif
+		framePeaksScalar(interleaved.data(), channels, f, frames, peaks.data());
+	}
+
+	auto applyFrameGains(std::span<const f32> interleaved, i32 channels, std::span<const f32> gains, std::span<f32> out) -> void {
+		if (channels <= 0) return;
+		const size_t frames = std::min({ interleaved.size() / channels, out.size() / channels, gains.size() });
+		size_t f = 0;
+#if AUDIO_SIMD_AVX2 || AUDIO_SIMD_SSE2
+		if (channels == 1) {
+			for (; f + width <= frames; f += width)
+				store(&out[f], mul(load(&interleaved[f]), load(&gains[f])));
+		}
+		else if (channels == 2) {
+			for (; f + width <= frames; f += width) {
+				Floats first, second;
+				stereoGains(load(&gains[f]), first, second);
+				store(&out[f * 2], mul(load(&interleaved[f * 2]), first));
+				store(&out[f * 2 + width], mul(load(&interleaved[f * 2 + width]), second));
+			}
+		}
+#endif
+		applyFrameGainsScalar(interleaved.data(), channels, gains.data(), f, frames, out.data());
+	}
+
+	// gain per frame is from + step * f, same formula as the scalar tail so the two halves meet exactly
+	auto mixStereo(std::span<const f32> stereo, f32 leftFrom, f32 rightFrom, f32 leftTo, f32 rightTo, std::span<f32> bus) -> void {
+		const size_t frames = std::min(stereo.size(), bus.size()) / 2;
+		if (frames == 0) return;
+		const f32 leftStep = (leftTo - leftFrom) / frames, rightStep = (rightTo - rightFrom) / frames;
+		size_t f = 0;
+#if AUDIO_SIMD_AVX2 || AUDIO_SIMD_SSE2
+		const Floats from = alternate(leftFrom, rightFrom), step = alternate(leftStep, rightStep), offsets = stereoFrameOffsets();
+		constexpr const size_t framesPerVector = width / 2;
+		if (leftStep == 0.0f && rightStep == 0.0f) { // steady gain, the usual case once a voice has settled
+			for (; f + framesPerVector <= frames; f += framesPerVector)
+				store(&bus[f * 2], add(load(&bus[f * 2]), mul(load(&stereo[f * 2]), from)));
+		}
+		else {
+			for (; f + framesPerVector <= frames; f += framesPerVector) {
+				Floats gain = add(from, mul(step, add(splat(static_cast<f32>(f)), offsets)));
+				store(&bus[f * 2], add(load(&bus[f * 2]), mul(load(&stereo[f * 2]), gain)));
+			}
+		}
+#endif
+		mixStereoScalar(stereo.data(), leftFrom, rightFrom, leftStep, rightStep, f, frames, bus.data());
+	}
+
+	namespace Scalar {
+		auto dBToVolume(std::span<const f32> dB, std::span<f32> volume) -> void {
+			const size_t count = std::min(dB.size(), volume.size());
+			for (size_t i = 0; i < count; i++)
+				volume[i] = Audio::dBToVolume(dB[i]);
+		}
+
+		auto volumeTodB(std::span<const f32> volume, std::span<f32> dB) -> void {
+			const size_t count = std::min(volume.size(), dB.size());
+			for (size_t i = 0; i < count; i++)
+				dB[i] = Audio::volumeTodB(volume[i]);
+		}
+
+		auto distances(const Vec3<f32>& from, std::span<const f32> xs, std::span<const f32> ys, std::span<const f32> zs, std::span<f32> out) -> void {
+			const size_t count = std::min({ xs.size(), ys.size(), zs.size(), out.size() });
+			for (size_t i = 0; i < count; i++)
+				out[i] = distance(from, Vec3<f32>{ xs[i], ys[i], zs[i] });
+		}
+
+		auto inverseRolloff(std::span<const f32> distances, f32 minDistance, f32 maxDistance, std::span<f32> gains) -> void {
+			const size_t count = std::min(distances.size(), gains.size());
+			minDistance = std::max(minDistance, std::numeric_limits<f32>::min());
+			maxDistance = std::max(maxDistance, minDistance);
+			for (size_t i = 0; i < count; i++)
+				gains[i] = rolloff(distances[i], minDistance, maxDistance);
+		}
+
+		auto framePeaks(std::span<const f32> interleaved, i32 channels, std::span<f32> peaks) -> void {
+			if (channels <= 0) return;
+			framePeaksScalar(interleaved.data(), channels, 0, std::min(interleaved.size() / channels, peaks.size()), peaks.data());
+		}
+
+		auto applyFrameGains(std::span<const f32> interleaved, i32 channels, std::span<const f32> gains, std::span<f32> out) -> void {
+			if (channels <= 0) return;
+			const size_t frames = std::min({ interleaved.size() / channels, out.size() / channels, gains.size() });
+			applyFrameGainsScalar(interleaved.data(), channels, gains.data(), 0, frames, out.data());
+		}
+
+		auto mixStereo(std::span<const f32> stereo, f32 leftFrom, f32 rightFrom, f32 leftTo, f32 rightTo, std::span<f32> bus) -> void {
+			const size_t frames = std::min(stereo.size(), bus.size()) / 2;
+			if (frames == 0) return;
+			mixStereoScalar(stereo.data(), leftFrom, rightFrom, (leftTo - leftFrom) / frames, (rightTo - rightFrom) / frames, 0, frames, bus.data());
+		}
+	};
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "Vec.hpp"
+
+#include <span>
+
+#ifndef _WIN32
+#define AUDIOENGINE_API
+#elif defined(AUDIOENGINE_EXPORTS)
+#define AUDIOENGINE_API __declspec(dllexport)
+#else
+#define AUDIOENGINE_API __declspec(dllimport)
+#endif
+
+/*
+	bulk math over spans, for work that touches many channels at once (gain ramps, attenuation for a few thousand
+	emitters). positions come in as separate x/y/z spans so the kernels can load them straight into registers.
+	the widest path the dll was compiled for is used: avx2 (8 floats, needs /arch:AVX2), sse2 (4 floats, any x64),
+	or plain loops. input and output spans must be the same length, and an output may alias its input.
+	the dB conversions use polynomial exp2/log2 approximations, good to ~1e-6 relative, far below anything audible.
+	Audio::Scalar has the straightforward one-at-a-time versions, exact to libm, for checking and benchmarking.
+*/
+namespace Audio {
+	enum struct SimdLevel : i32 {
+		scalar = 0,
+		sse2 = 1,
+		avx2 = 2
+	};
+
+	AUDIOENGINE_API auto getSimdLevel() -> SimdLevel;
+
+	AUDIOENGINE_API auto dBToVolume(std::span<const f32> dB, std::span<f32> volume) -> void;
+	AUDIOENGINE_API auto volumeTodB(std::span<const f32> volume, std::span<f32> dB) -> void; // anything <= 0 (or nan) gives -inf
+	AUDIOENGINE_API auto distances(const Vec3<f32>& from, std::span<const f32> xs, std::span<const f32> ys, std::span<const f32> zs, std::span<f32> out) -> void;
+	// fmod's default (inverse) rolloff: 1 inside minDistance, minDistance / distance out to maxDistance, flat past that
+	AUDIOENGINE_API auto inverseRolloff(std::span<const f32> distances, f32 minDistance, f32 maxDistance, std::span<f32> gains) -> void;
+	// for dynamics over interleaved audio, one value per frame. mono and stereo get the vector paths, wider layouts loop
+	AUDIOENGINE_API auto framePeaks(std::span<const f32> interleaved, i32 channels, std::span<f32> peaks) -> void; // max |sample| per frame
+	AUDIOENGINE_API auto applyFrameGains(std::span<const f32> interleaved, i32 channels, std::span<const f32> gains, std::span<f32> out) -> void;
+	// bus += stereo * gain, both interleaved stereo. each side's gain ramps linearly from its from value on the first frame
+	// to its to value one frame past the last, so back to back blocks join up without a step. the native mixer's inner loop
+	AUDIOENGINE_API auto mixStereo(std::span<const f32> stereo, f32 leftFrom, f32 rightFrom, f32 leftTo, f32 rightTo, std::span<f32> bus) -> void;
+
+	namespace Scalar {
+		AUDIOENGINE_API auto dBToVolume(std::span<const f32> dB, std::span<f32> volume) -> void;
+		AUDIOENGINE_API auto volumeTodB(std::span<const f32> volume, std::span<f32> dB) -> void;
+		AUDIOENGINE_API auto distances(const Vec3<f32>& from, std::span<const f32> xs, std::span<const f32> ys, std::span<const f32> zs, std::span<f32> out) -> void;
+		AUDIOENGINE_API auto inverseRolloff(std::span<const f32> distances, f32 minDistance, f32 maxDistance, std::span<f32> gains) -> void;
+		AUDIOENGINE_API auto framePeaks(std::span<const f32> interleaved, i32 channels, std::span<f32> peaks) -> void;
+		AUDIOENGINE_API auto applyFrameGains(std::span<const f32> interleaved, i32 channels, std::span<const f32> gains, std::span<f32> out) -> void;
+		AUDIOENGINE_API auto mixStereo(std::span<const f32> stereo, f32 leftFrom, f32 rightFrom, f32 leftTo, f32 rightTo, std::span<f32> bus) -> void;
+	};
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "VecMath.hpp"
+
+#include <span>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+/*
+	channel volume changes collected between update()s, same shape as PositionBatch. callers append dB values
+	under one short lock, and take() converts everything that piled up to linear gain in one bulk dBToVolume
+	pass before the owner walks it, instead of a pow per channel.
+*/
+class VolumeBatch {
+public:
+	struct Entries {
+		std::vector<i32> channelIds;
+		std::vector<f32> volumes; // dB while pending, linear once taken
+		std::vector<u32> sequences;
+
+		auto size() const -> size_t {
+			return this->channelIds.size();
+		}
+		auto clear() -> void {
+			this->channelIds.clear();
+			this->volumes.clear();
+			this->sequences.clear();
+		}
+	};
+
+	// any thread. entries past the shorter of the two spans are ignored
+	auto append(std::span<const i32> channelIds, std::span<const f32> volumesdB, u32 sequence) -> void {
+		const size_t count = std::min(channelIds.size(), volumesdB.size());
+		if (count == 0) return;
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->pending.channelIds.insert(this->pending.channelIds.end(), channelIds.begin(), channelIds.begin() + count);
+		this->pending.volumes.insert(this->pending.volumes.end(), volumesdB.begin(), volumesdB.begin() + count);
+		this->pending.sequences.insert(this->pending.sequences.end(), count, sequence);
+	}
+
+	// owner thread. everything appended so far with volumes already linear, valid until the next take()
+	auto take() -> const Entries& {
+		this->applying.clear();
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+			std::swap(this->pending, this->applying);
+		}
+		Audio::dBToVolume(this->applying.volumes, this->applying.volumes); // outside the lock, appenders don't wait on it
+		return this->applying;
+	}
+
+private:
+	std::mutex lock;
+	Entries pending;
+	Entries applying;
+};
@@ -25,6 +25,9 @@
 #include <cstdint>
 #include <cstddef>
 
+// AUDIOENGINE_NATIVE_ONLY builds leave the fmod backend out, and don't need fmod's headers or library at all
+#ifndef AUDIOENGINE_NATIVE_ONLY
 #include "fmod.hpp"
+#endif
 
 #endif //PCH_H
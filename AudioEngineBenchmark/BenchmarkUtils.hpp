@@ -0,0 +1,90 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <numbers>
+#include <string>
+#include <vector>
+
+namespace Benchmark {
+	typedef std::chrono::steady_clock Clock;
+
+	// one json object per line on stdout, so a run can be diffed against a saved baseline with any json tool.
+	// everything meant for humans goes to stderr
+	struct Result {
+		std::string benchmark;
+		std::string variant;
+		u64 iterations;
+		f64 meanNs;
+		f64 p50Ns;
+		f64 p99Ns;
+		f64 minNs;
+		f64 maxNs;
+	};
+
+	inline auto report(const Result& result) -> void {
+		std::cout << std::format(
+			"{{\"benchmark\":\"{}\",\"variant\":\"{}\",\"iterations\":{},\"meanNs\":{:.1f},\"p50Ns\":{:.1f},\"p99Ns\":{:.1f},\"minNs\":{:.1f},\"maxNs\":{:.1f}}}\n",
+			result.benchmark, result.variant, result.iterations,
+			result.meanNs, result.p50Ns, result.p99Ns, result.minNs, result.maxNs
+		);
+	}
+
+	// samples are per operation. for calls too cheap to time one by one, time a batch and divide before adding
+	inline auto summarize(const std::string& benchmark, const std::string& variant, std::vector<f64>& samplesNs, u64 operationsPerSample = 1) -> void {
+		if (samplesNs.empty())
+			return;
+		std::sort(samplesNs.begin(), samplesNs.end());
+		f64 total = 0;
+		for (auto sample : samplesNs)
+			total += sample;
+		const auto percentile = [&samplesNs](f64 p) -> f64 {
+			size_t index = static_cast<size_t>(p * static_cast<f64>(samplesNs.size() - 1) + 0.5);
+			return samplesNs[index];
+		};
+		report(Result{
+			benchmark, variant, samplesNs.size() * operationsPerSample,
+			total / static_cast<f64>(samplesNs.size()), percentile(0.5), percentile(0.99),
+			samplesNs.front(), samplesNs.back()
+		});
+	}
+
+	inline auto elapsedNs(Clock::time_point start, Clock::time_point end) -> f64 {
+		return static_cast<f64>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	}
+
+	// 16 bit mono sine. lets the suite run without any assets checked in
+	inline auto writeTestWav(const std::filesystem::path& path, u32 sampleRate, f32 seconds) -> bool {
+		const u32 sampleCount = static_cast<u32>(sampleRate * seconds);
+		const u32 dataBytes = sampleCount * sizeof(i16);
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+		const auto write = [&out](const auto& value) {
+			out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+		};
+		out.write("RIFF", 4);
+		write(static_cast<u32>(36 + dataBytes));
+		out.write("WAVEfmt ", 8);
+		write(static_cast<u32>(16)); // fmt chunk size
+		write(static_cast<u16>(1)); // pcm
+		write(static_cast<u16>(1)); // mono
+		write(sampleRate);
+		write(static_cast<u32>(sampleRate * sizeof(i16))); // byte rate
+		write(static_cast<u16>(sizeof(i16))); // block align
+		write(static_cast<u16>(16)); // bits per sample
+		out.write("data", 4);
+		write(dataBytes);
+		for (u32 i = 0; i < sampleCount; i++) {
+			f64 value = std::sin(2.0 * std::numbers::pi * 440.0 * i / sampleRate);
+			write(static_cast<i16>(value * 8000.0));
+		}
+		return static_cast<bool>(out);
+	}
+};
@@ -0,0 +1,397 @@
+
+#include "PrimitiveTypes.hpp"
+
+#include "AudioEngine.hpp"
+#include "AssetPack.hpp"
+#include "VecMath.hpp"
+
+#include "BenchmarkUtils.hpp"
+
+#include <array>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+	hot path numbers for AudioEngine. runs on the no-sound nrt output so it works on machines without a sound card,
+	and so update() measures one full mix per call instead of whatever the realtime mixer thread was up to.
+	usage: AudioEngineBenchmark [--native] [--pool megabytes] [--io threads] [folder]
+	every file in folder gets its own loadSound case (by extension), timed from the file and then out of an asset pack.
+	a generated wav is always included.
+	--native runs everything on the native backend instead of fmod. it only reads wav and flac, anything else in folder just fails to load
+	--pool gives the engine (and fmod) a memory pool that size, to compare against the system heap. its usage gets printed at the end
+	--io has fmod's file reads go through that many engine i/o threads with read-ahead. per file stats get printed at the end
+*/
+
+namespace {
+	constexpr const u32 loadIterations = 50;
+	constexpr const u32 registeredSounds = 10000;
+	constexpr const u32 playBatch = 1000; // channels started per timed sample, then stopped again
+	constexpr const u32 playSamples = 20;
+	constexpr const auto liveChannelCounts = std::array<u32, 6>{ 0, 16, 64, 256, 1024, 4000 };
+	static_assert(liveChannelCounts.back() < 4095, "has to fit in virtualVoices");
+	constexpr const u32 updateIterations = 200;
+	constexpr const u32 positionBatch = 10000;
+	constexpr const u32 positionSamples = 50;
+	constexpr const u32 infoIterations = 2000;
+	constexpr const u32 kernelElements = 4096; // a big game's worth of emitters, still fits in l1/l2
+	constexpr const u32 kernelSamples = 200;
+
+	constexpr const auto loadModes = std::array<std::pair<Audio::LoadMode, std::string_view>, 4>{ {
+		{ Audio::LoadMode::stream, "stream" },
+		{ Audio::LoadMode::compressed, "compressed" },
+		{ Audio::LoadMode::decompressed, "decompressed" },
+		{ Audio::LoadMode::automatic, "automatic" } // whichever the default policy picks. nothing gets played, so it goes by size and length
+	} };
+
+	// source just labels the case, whether the load reads the file or a mounted pack depends on what's mounted
+	auto benchLoadSound(Audio::AudioEngine& engine, const std::filesystem::path& file, std::string_view source) -> void {
+		const auto extension = file.extension().string();
+		for (const auto& [mode, modeName] : loadModes) {
+			std::vector<f64> samples;
+			samples.reserve(loadIterations);
+			for (u32 i = 0; i < loadIterations; i++) {
+				auto start = Benchmark::Clock::now();
+				auto handle = engine.loadSound(file.string(), "load", false, false, mode);
+				auto end = Benchmark::Clock::now();
+				if (!handle.isValid()) {
+					std::cerr << std::format("loadSound failed for {}\n", file.string());
+					return;
+				}
+				samples.push_back(Benchmark::elapsedNs(start, end));
+				engine.unloadSound(handle);
+			}
+			Benchmark::summarize("loadSound", std::format("{}/{}/{}", extension, modeName, source), samples);
+		}
+	}
+
+	auto stopEverything(Audio::AudioEngine& engine) -> void {
+		engine.stopAllChannels();
+		engine.update(); // end callbacks retire the channels in here
+	}
+
+	auto benchPlaySound(Audio::AudioEngine& engine, const std::filesystem::path& wav) -> void {
+		std::vector<Audio::SoundHandle> handles;
+		std::vector<std::string> names; // built up front so the timed loop doesn't include formatting them
+		handles.reserve(registeredSounds);
+		names.reserve(registeredSounds);
+		for (u32 i = 0; i < registeredSounds; i++) {
+			names.push_back(std::format("registered{}", i));
+			handles.push_back(engine.loadSound(wav.string(), names.back(), false));
+		}
+
+		std::vector<f64> byHandle, byName;
+		for (u32 sample = 0; sample < playSamples; sample++) {
+			auto start = Benchmark::Clock::now();
+			for (u32 i = 0; i < playBatch; i++)
+				engine.playSound(handles[(sample * playBatch + i) % registeredSounds]);
+			auto end = Benchmark::Clock::now();
+			byHandle.push_back(Benchmark::elapsedNs(start, end) / playBatch);
+			stopEverything(engine);
+
+			start = Benchmark::Clock::now();
+			for (u32 i = 0; i < playBatch; i++)
+				engine.playSound(names[(sample * playBatch + i) % registeredSounds]);
+			end = Benchmark::Clock::now();
+			byName.push_back(Benchmark::elapsedNs(start, end) / playBatch);
+			stopEverything(engine);
+		}
+		Benchmark::summarize("playSound", std::format("handle/{}registered", registeredSounds), byHandle, playBatch);
+		Benchmark::summarize("playSound", std::format("name/{}registered", registeredSounds), byName, playBatch);
+
+		for (auto handle : handles)
+			engine.unloadSound(handle);
+		engine.update();
+	}
+
+	auto benchUpdate(Audio::AudioEngine& engine, Audio::SoundHandle loop) -> void {
+		for (auto liveChannels : liveChannelCounts) {
+			for (u32 i = 0; i < liveChannels; i++)
+				engine.playSound(loop, Audio::Vec3<f32>{ static_cast<f32>(i % 100), 0, 0 });
+			engine.update();
+			std::vector<f64> samples;
+			samples.reserve(updateIterations);
+			for (u32 i = 0; i < updateIterations; i++) {
+				auto start = Benchmark::Clock::now();
+				engine.update();
+				auto end = Benchmark::Clock::now();
+				samples.push_back(Benchmark::elapsedNs(start, end));
+			}
+			Benchmark::summarize("update", std::format("{}channels", liveChannels), samples);
+			stopEverything(engine);
+		}
+	}
+
+	auto benchSetPosition(Audio::AudioEngine& engine, Audio::SoundHandle loop) -> void {
+		constexpr const u32 liveChannels = 1024;
+		std::vector<i32> channelIds;
+		for (u32 i = 0; i < liveChannels; i++)
+			channelIds.push_back(engine.playSound(loop));
+		engine.update();
+
+		std::vector<f64> samples;
+		for (u32 sample = 0; sample < positionSamples; sample++) {
+			auto start = Benchmark::Clock::now();
+			for (u32 i = 0; i < positionBatch; i++)
+				engine.setChannel3dPosition(channelIds[i % liveChannels], Audio::Vec3<f32>{ static_cast<f32>(i), 1.0f, static_cast<f32>(sample) });
+			auto end = Benchmark::Clock::now();
+			samples.push_back(Benchmark::elapsedNs(start, end) / positionBatch);
+		}
+		Benchmark::summarize("setChannel3dPosition", std::format("{}channels", liveChannels), samples, positionBatch);
+
+		// the same moves through the batch api: the append per channel, then the update() that applies it
+		std::vector<Audio::Vec3<f32>> positions(liveChannels);
+		std::vector<f64> appendSamples, applySamples;
+		for (u32 sample = 0; sample < positionSamples; sample++) {
+			for (u32 i = 0; i < liveChannels; i++)
+				positions[i] = Audio::Vec3<f32>{ static_cast<f32>(i), 1.0f, static_cast<f32>(sample) };
+			auto start = Benchmark::Clock::now();
+			engine.setChannel3dPositions(channelIds, positions);
+			auto end = Benchmark::Clock::now();
+			appendSamples.push_back(Benchmark::elapsedNs(start, end) / liveChannels);
+			start = Benchmark::Clock::now();
+			engine.update();
+			end = Benchmark::Clock::now();
+			applySamples.push_back(Benchmark::elapsedNs(start, end));
+		}
+		Benchmark::summarize("setChannel3dPositions", std::format("append/{}channels", liveChannels), appendSamples, liveChannels);
+		Benchmark::summarize("setChannel3dPositions", std::format("update/{}channels", liveChannels), applySamples);
+		stopEverything(engine);
+	}
+
+	auto simdLevelName() -> const char* {
+		switch (Audio::getSimdLevel()) {
+			case Audio::SimdLevel::avx2: return "avx2";
+			case Audio::SimdLevel::sse2: return "sse2";
+			default: return "scalar";
+		}
+	}
+
+	// times fn over the whole array, reported per element
+	template <typename Kernel>
+	auto benchKernel(const std::string& benchmark, const std::string& variant, Kernel&& kernel) -> void {
+		std::vector<f64> samples;
+		samples.reserve(kernelSamples);
+		for (u32 sample = 0; sample < kernelSamples; sample++) {
+			auto start = Benchmark::Clock::now();
+			kernel();
+			auto end = Benchmark::Clock::now();
+			samples.push_back(Benchmark::elapsedNs(start, end) / kernelElements);
+		}
+		Benchmark::summarize(benchmark, variant, samples, kernelElements);
+	}
+
+	// the span kernels against their one-at-a-time versions on the same data
+	auto benchVecMath() -> void {
+		std::vector<f32> dB(kernelElements), volume(kernelElements), out(kernelElements);
+		std::vector<f32> xs(kernelElements), ys(kernelElements), zs(kernelElements);
+		for (u32 i = 0; i < kernelElements; i++) {
+			dB[i] = -60.0f + static_cast<f32>(i % 720) * 0.1f;
+			volume[i] = static_cast<f32>(i + 1) / kernelElements;
+			xs[i] = static_cast<f32>(i % 64);
+			ys[i] = static_cast<f32>(i % 7);
+			zs[i] = static_cast<f32>(i / 64);
+		}
+		const Audio::Vec3<f32> listener{ 10.0f, 2.0f, 5.0f };
+		const std::string simd = simdLevelName();
+		const auto size = std::format("/{}", kernelElements);
+
+		benchKernel("dBToVolume", simd + size, [&] { Audio::dBToVolume(dB, out); });
+		benchKernel("dBToVolume", "scalar" + size, [&] { Audio::Scalar::dBToVolume(dB, out); });
+		benchKernel("volumeTodB", simd + size, [&] { Audio::volumeTodB(volume, out); });
+		benchKernel("volumeTodB", "scalar" + size, [&] { Audio::Scalar::volumeTodB(volume, out); });
+		benchKernel("distances", simd + size, [&] { Audio::distances(listener, xs, ys, zs, out); });
+		benchKernel("distances", "scalar" + size, [&] { Audio::Scalar::distances(listener, xs, ys, zs, out); });
+		Audio::distances(listener, xs, ys, zs, volume);
+		benchKernel("inverseRolloff", simd + size, [&] { Audio::inverseRolloff(volume, 1.0f, 100.0f, out); });
+		benchKernel("inverseRolloff", "scalar" + size, [&] { Audio::Scalar::inverseRolloff(volume, 1.0f, 100.0f, out); });
+
+		// stereo blocks through the dynamics kernels, kernelElements / 2 frames
+		std::vector<f32> stereo(kernelElements), frameValues(kernelElements / 2);
+		for (u32 i = 0; i < kernelElements; i++)
+			stereo[i] = dB[i] / -60.0f;
+		benchKernel("framePeaks", simd + "/stereo" + size, [&] { Audio::framePeaks(stereo, 2, frameValues); });
+		benchKernel("framePeaks", "scalar/stereo" + size, [&] { Audio::Scalar::framePeaks(stereo, 2, frameValues); });
+		benchKernel("applyFrameGains", simd + "/stereo" + size, [&] { Audio::applyFrameGains(stereo, 2, frameValues, out); });
+		benchKernel("applyFrameGains", "scalar/stereo" + size, [&] { Audio::Scalar::applyFrameGains(stereo, 2, frameValues, out); });
+		// the native backend's per voice kernel, once ramping between blocks and once on steady gains
+		benchKernel("mixStereo", simd + "/ramp" + size, [&] { Audio::mixStereo(stereo, 0.2f, 0.9f, 0.7f, 0.4f, out); });
+		benchKernel("mixStereo", "scalar/ramp" + size, [&] { Audio::Scalar::mixStereo(stereo, 0.2f, 0.9f, 0.7f, 0.4f, out); });
+		benchKernel("mixStereo", simd + "/steady" + size, [&] { Audio::mixStereo(stereo, 0.7f, 0.4f, 0.7f, 0.4f, out); });
+		benchKernel("mixStereo", "scalar/steady" + size, [&] { Audio::Scalar::mixStereo(stereo, 0.7f, 0.4f, 0.7f, 0.4f, out); });
+	}
+
+	auto benchSetVolume(Audio::AudioEngine& engine, Audio::SoundHandle loop) -> void {
+		constexpr const u32 liveChannels = 1024;
+		std::vector<i32> channelIds;
+		for (u32 i = 0; i < liveChannels; i++)
+			channelIds.push_back(engine.playSound(loop));
+		engine.update();
+
+		std::vector<f32> volumes(liveChannels);
+		std::vector<f64> single, batch;
+		for (u32 sample = 0; sample < positionSamples; sample++) {
+			for (u32 i = 0; i < liveChannels; i++)
+				volumes[i] = -static_cast<f32>((i + sample) % 40);
+			auto start = Benchmark::Clock::now();
+			for (u32 i = 0; i < liveChannels; i++)
+				engine.setChannelVolume(channelIds[i], volumes[i]);
+			auto end = Benchmark::Clock::now();
+			single.push_back(Benchmark::elapsedNs(start, end) / liveChannels);
+
+			// append plus the update() that converts and applies it, so the two are comparable
+			start = Benchmark::Clock::now();
+			engine.setChannelVolumes(channelIds, volumes);
+			engine.update();
+			end = Benchmark::Clock::now();
+			batch.push_back(Benchmark::elapsedNs(start, end) / liveChannels);
+		}
+		Benchmark::summarize("setChannelVolume", std::format("{}channels", liveChannels), single, liveChannels);
+		Benchmark::summarize("setChannelVolumes", std::format("append+update/{}channels", liveChannels), batch, liveChannels);
+		stopEverything(engine);
+	}
+
+	auto benchSoundInfo(Audio::AudioEngine& engine, Audio::SoundHandle loop) -> void {
+		i32 channelId = engine.playSound(loop);
+		engine.update();
+
+		std::vector<f64> playing, cached, position;
+		for (u32 i = 0; i < infoIterations; i++) {
+			auto start = Benchmark::Clock::now();
+			{
+				auto info = engine.getPlayingSound(channelId); // builds and tears down a whole SoundInfo
+			}
+			auto end = Benchmark::Clock::now();
+			playing.push_back(Benchmark::elapsedNs(start, end));
+
+			start = Benchmark::Clock::now();
+			const auto* info = engine.getSoundInfo(loop);
+			end = Benchmark::Clock::now();
+			cached.push_back(Benchmark::elapsedNs(start, end));
+			if (!info) break;
+
+			start = Benchmark::Clock::now();
+			bool stillPlaying = engine.getPlaybackPosition(channelId).has_value();
+			end = Benchmark::Clock::now();
+			position.push_back(Benchmark::elapsedNs(start, end));
+			if (!stillPlaying) break;
+		}
+		Benchmark::summarize("soundInfo", "getPlayingSound", playing);
+		Benchmark::summarize("soundInfo", "getSoundInfo", cached);
+		Benchmark::summarize("soundInfo", "getPlaybackPosition", position);
+		stopEverything(engine);
+	}
+};
+
+auto main(int argc, char** argv) -> int {
+	bool native = false;
+	u64 poolBytes = 0;
+	u32 ioThreads = 0;
+	while (argc > 1 && std::string_view(argv[1]).starts_with("--")) {
+		const std::string_view flag = argv[1];
+		if (flag == "--native")
+			native = true;
+		else if (flag == "--pool" && argc > 2) {
+			poolBytes = std::stoull(argv[2]) * 1024 * 1024;
+			argc--;
+			argv++;
+		}
+		else if (flag == "--io" && argc > 2) {
+			ioThreads = static_cast<u32>(std::stoul(argv[2]));
+			argc--;
+			argv++;
+		}
+		else {
+			std::cerr << std::format("Unknown option {}\n", flag);
+			return 1;
+		}
+		argc--;
+		argv++;
+	}
+	Audio::AudioEngine::init(Audio::AudioEngineConfig{
+		.backend = native ? Audio::Backend::native : Audio::Backend::fmod,
+		.threading = Audio::ThreadingMode::callerThread, // measure the engine, not the queue
+		.maxChannelHandles = 2 * liveChannelCounts.back(),
+		.virtualVoices = 4095, // above the most live channels, so none of them get stolen mid benchmark
+		.memoryPoolBytes = poolBytes,
+		.ioThreads = ioThreads,
+		.output = Audio::OutputMode::noSoundNRT
+	});
+	Audio::AudioEngine engine{};
+
+	const auto workDirectory = std::filesystem::temp_directory_path() / "AudioEngineBenchmark";
+	std::filesystem::create_directories(workDirectory);
+	const auto wav = workDirectory / "sine.wav";
+	if (!Benchmark::writeTestWav(wav, 48000, 0.25f)) {
+		std::cerr << std::format("Couldn't write {}\n", wav.string());
+		return 1;
+	}
+
+	std::vector<std::filesystem::path> loadCases{ wav };
+	if (argc > 1) {
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(argv[1], error)) {
+			if (entry.is_regular_file())
+				loadCases.push_back(entry.path());
+		}
+		if (error)
+			std::cerr << std::format("Couldn't read {}, only using the generated wav\n", argv[1]);
+	}
+
+	std::cerr << "vecMath...\n";
+	benchVecMath();
+
+	std::cerr << "loadSound...\n";
+	for (const auto& file : loadCases)
+		benchLoadSound(engine, file, "file");
+	// the same files again out of one mapped pack. mounting is for the engine's whole life, so this has to come after
+	std::vector<std::string> packFiles;
+	for (const auto& file : loadCases)
+		packFiles.push_back(file.string());
+	const auto pack = workDirectory / "cases.pack";
+	if (Audio::AssetPack::write(pack.string(), packFiles) && engine.mountPack(pack.string())) {
+		for (const auto& file : loadCases)
+			benchLoadSound(engine, file, "pack");
+	}
+	else
+		std::cerr << std::format("Couldn't build {}, skipping the pack loads\n", pack.string());
+
+	std::cerr << "playSound...\n";
+	benchPlaySound(engine, wav);
+
+	auto loop = engine.loadSound(wav.string(), "loop", true, true);
+	if (!loop.isValid()) {
+		std::cerr << "Couldn't load the looping test sound\n";
+		return 1;
+	}
+	std::cerr << "update...\n";
+	benchUpdate(engine, loop);
+	std::cerr << "setChannel3dPosition...\n";
+	benchSetPosition(engine, loop);
+	std::cerr << "setChannelVolume...\n";
+	benchSetVolume(engine, loop);
+	std::cerr << "soundInfo...\n";
+	benchSoundInfo(engine, loop);
+
+	engine.unloadSound(loop);
+	if (poolBytes != 0) {
+		const auto stats = engine.getStats();
+		std::cerr << std::format(
+			"pool: {} of {} bytes in use, peak {}, {} carved, {:.1f}% fragmented, {} heap fallbacks\n",
+			stats.poolUsedBytes, stats.poolBytes, stats.poolPeakBytes, stats.poolCarvedBytes, stats.poolFragmentation * 100.0f, stats.poolFallbacks
+		);
+	}
+	for (const auto& file : engine.getFileStats()) {
+		std::cerr << std::format(
+			"{}: {} opens, {} reads ({} read ahead, {} failed), {} bytes served, {} off disk, mean {}us max {}us\n",
+			file.path, file.opens, file.reads, file.readAheadHits, file.failedReads, file.bytesServed, file.diskBytes,
+			file.meanLatencyNs / 1000, file.maxLatencyNs / 1000
+		);
+	}
+	Audio::AudioEngine::shutdown();
+	return 0;
+}
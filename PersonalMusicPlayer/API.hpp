@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Song.hpp"
+#include "PlayerSettings.hpp"
+#include "LibraryIndex.hpp"
+#include "MetadataStore.hpp"
 
 #include "json.hpp"
 
@@ -14,6 +17,7 @@
 #include <random>
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 
 namespace PersonalMusicPlayer {
 	constexpr const auto validFormats = std::array{
@@ -52,7 +56,11 @@ namespace PersonalMusicPlayer {
 		u32* alreadyLoaded = nullptr,
 		u32* failedToLoad = nullptr
 	) -> i8 {
-		i8 statusCode = engine.loadSound(song.path, song.name);
+		i8 statusCode = 1;
+		if (engine.findSound(song.name).isValid())
+			statusCode = 0;
+		else if (!engine.loadSound(song.path, song.name).isValid())
+			statusCode = -1;
 		switch (statusCode) {
 			case -1: 
 				std::cerr << std::format(
@@ -90,6 +98,7 @@ namespace PersonalMusicPlayer {
 	/*
 	reads from config.json
 	result should be vec<Song> only containing existing files (at call time) that also have valid extensions
+	folders come from the library index (see LibraryIndex.hpp), so only directories that changed since last run get listed
 	*/
 	auto getSongsFromConfigFile() -> std::vector<Song> {
 		std::ifstream f("config.json");
@@ -98,33 +107,24 @@ namespace PersonalMusicPlayer {
 		std::vector<std::string> folders = config["musicLibrary"]["folders"];
 		std::vector<std::string> recusiveFolders = config["musicLibrary"]["recusiveFolders"];
 		std::vector<std::string> individualSongs = config["musicLibrary"]["individualFiles"];
+		std::string indexFile = config["musicLibrary"].value("indexFile", std::string("library.index"));
 
-		std::vector<Song> loadedSongs;
+		const auto classify = [](const std::filesystem::path& path) -> i32 {
+			auto extension = path.extension().string();
+			auto foundIter = std::ranges::find(validFormats, extension);
+			if (foundIter == validFormats.end())
+				return -1;
+			return static_cast<i32>(foundIter - validFormats.begin());
+		};
 
-		u32 invalidPath = 0, wrongFileExtension = 0;
+		auto index = LibraryIndex::load(indexFile);
+		auto stats = index.refresh(folders, recusiveFolders, classify);
+		if (!index.save(indexFile))
+			std::cerr << std::format("Couldn't write library index to {}\n", indexFile);
+
+		std::vector<Song> loadedSongs = index.getSongs();
+		u32 invalidPath = stats.invalidPaths, wrongFileExtension = stats.rejectedFiles;
 
-		for (const auto& folder : folders) {
-			for (const auto& file : std::filesystem::directory_iterator(folder)) {
-				const auto path = file.path();
-				if (!file.exists()) // if invalid, invalid case
-					invalidPath++;
-				else if (!validExtension(path)) // else if invalid, invalid case
-					wrongFileExtension++;
-				else // otherwise success case. kinda cool structure
-					loadedSongs.emplace_back(path.string(), path.stem().string());
-			}
-		}
-		for (const auto& folder : recusiveFolders) {
-			for (const auto& file : std::filesystem::recursive_directory_iterator(folder)) {
-				const auto path = file.path();
-				if (!file.exists())
-					invalidPath++;
-				else if (!validExtension(path))
-					wrongFileExtension++;
-				else
-					loadedSongs.emplace_back(path.string(), path.stem().string());
-			}
-		}
 		for (const std::string& filePath : individualSongs) {
 			const auto path = std::filesystem::path(filePath);
 			const auto file = std::filesystem::directory_entry(path);
@@ -132,18 +132,113 @@ namespace PersonalMusicPlayer {
 				invalidPath++;
 			else if (!validExtension(path))
 				wrongFileExtension++;
-			else
-				loadedSongs.emplace_back(path.string(), path.stem().string());
+			else {
+				std::error_code error; // size and mtime are only used to spot changed files, zero is fine if they fail
+				u64 size = file.file_size(error);
+				i64 mtime = static_cast<i64>(file.last_write_time(error).time_since_epoch().count());
+				loadedSongs.emplace_back(path.string(), path.stem().string(), size, mtime);
+			}
 		}
 
 		std::cout << std::format(
-			"Songs loaded: {}, invalid paths: {}, invalid file extension: {}\n",
-			loadedSongs.size(), invalidPath, wrongFileExtension
+			"Songs loaded: {}, invalid paths: {}, invalid file extension: {}, folders reused: {}, folders rescanned: {}\n",
+			loadedSongs.size(), invalidPath, wrongFileExtension, stats.directoriesReused, stats.directoriesScanned
 		);
 
 		return loadedSongs;
 	}
 
+	// reads metadata for every song the store doesn't have yet, or whose file changed since it was read
+	auto getLibraryMetadata(const std::vector<Song>& songs, bool analyzeLoudness) -> MetadataStore {
+		std::ifstream f("config.json");
+		nlohmann::json config = nlohmann::json::parse(f);
+		std::string metadataFile = config["musicLibrary"].value("metadataFile", std::string("library.metadata"));
+
+		MetadataStore::RefreshStats stats{};
+		if (analyzeLoudness)
+			std::cout << "Checking library loudness, songs that haven't been measured yet get decoded once...\n";
+		auto metadata = MetadataStore::refresh(songs, metadataFile, analyzeLoudness, &stats);
+		if (metadata.size() == 0 && !songs.empty())
+			std::cerr << std::format("Couldn't write library metadata to {}\n", metadataFile);
+
+		std::cout << std::format(
+			"Metadata reused: {}, read: {}, unreadable: {}, loudness measured: {}\n",
+			stats.reused, stats.extracted, stats.failed, stats.analyzed
+		);
+
+		return metadata;
+	}
+
+	// reads the optional "player" section of config.json
+	auto getPlayerSettingsFromConfigFile() -> PlayerSettings {
+		std::ifstream f("config.json");
+		nlohmann::json config = nlohmann::json::parse(f);
+
+		PlayerSettings settings{};
+		if (config.contains("player")) {
+			const auto& player = config["player"];
+			settings.prefetchCount = player.value("prefetchCount", settings.prefetchCount);
+			settings.cacheBytes = player.value("cacheMegabytes", settings.cacheBytes / (1024 * 1024)) * 1024 * 1024;
+			settings.engineMemoryBytes = player.value("engineMemoryMegabytes", settings.engineMemoryBytes / (1024 * 1024)) * 1024 * 1024;
+			settings.memoryPoolBytes = player.value("memoryPoolMegabytes", settings.memoryPoolBytes / (1024 * 1024)) * 1024 * 1024;
+			settings.ioThreads = player.value("ioThreads", settings.ioThreads);
+			settings.readAheadBytes = player.value("readAheadKilobytes", settings.readAheadBytes / 1024) * 1024;
+			settings.loadPolicy.streamAboveBytes = player.value("streamAboveMegabytes", settings.loadPolicy.streamAboveBytes / (1024 * 1024)) * 1024 * 1024;
+			settings.loadPolicy.streamAboveSeconds = player.value("streamAboveSeconds", settings.loadPolicy.streamAboveSeconds);
+			settings.loadPolicy.streamFileBufferBytes = player.value("streamBufferKilobytes", settings.loadPolicy.streamFileBufferBytes / 1024) * 1024;
+			std::string output = player.value("output", std::string("realtime"));
+			if (output == "nosound")
+				settings.output = Audio::OutputMode::noSoundNRT;
+			else if (output == "wav")
+				settings.output = Audio::OutputMode::wavWriterNRT;
+			else if (output != "realtime")
+				std::cerr << std::format("Unknown output \"{}\", using realtime\n", output);
+			settings.wavPath = player.value("wavPath", settings.wavPath);
+			settings.eqGainsdB = player.value("eq", settings.eqGainsdB);
+			settings.limiter = player.value("limiter", settings.limiter);
+			settings.normalizeLoudness = player.value("normalizeLoudness", settings.normalizeLoudness);
+			settings.loudnessTarget = player.value("loudnessTarget", settings.loudnessTarget);
+			settings.crossfadeMs = player.value("crossfadeMs", settings.crossfadeMs);
+			settings.updateTickMs = player.value("updateTickMs", settings.updateTickMs);
+			settings.packFile = player.value("packFile", settings.packFile);
+		}
+		return settings;
+	}
+
+	/*
+		replaygain style: move the song's integrated loudness to the target, but never so far up that its true peak
+		goes past -1 dBTP, since that would clip (or lean on the limiter). unmeasured songs play as they are
+	*/
+	auto normalizationGaindB(const MetadataStore& metadata, const Song& song, const PlayerSettings& settings) -> f32 {
+		constexpr const f32 peakCeilingdB = -1.0f;
+		constexpr const f32 maxBoostdB = 12.0f;
+		if (!settings.normalizeLoudness)
+			return 0.0f;
+		auto row = metadata.find(song);
+		if (!row.has_value())
+			return 0.0f;
+		auto loudness = metadata.getLoudness(row.value());
+		if (!loudness.has_value() || !std::isfinite(loudness->integratedLufs))
+			return 0.0f;
+		f32 gain = settings.loudnessTarget - loudness->integratedLufs;
+		if (std::isfinite(loudness->truePeakdB))
+			gain = std::min(gain, peakCeilingdB - loudness->truePeakdB);
+		return std::min(gain, maxBoostdB);
+	}
+
+	// on the main group, so they hold across songs and cost the same however many channels are playing
+	auto addOutputEffects(Audio::AudioEngine& engine, const PlayerSettings& settings) -> void {
+		if (settings.eqGainsdB != std::array<f32, 3>{}) {
+			auto equalizer = Audio::makeEqualizer();
+			equalizer->setParameter(Audio::EqualizerParameter::lowGaindB, settings.eqGainsdB[0]);
+			equalizer->setParameter(Audio::EqualizerParameter::midGaindB, settings.eqGainsdB[1]);
+			equalizer->setParameter(Audio::EqualizerParameter::highGaindB, settings.eqGainsdB[2]);
+			engine.addEffect(equalizer);
+		}
+		if (settings.limiter)
+			engine.addEffect(Audio::makeLimiter()); // after the eq, so it catches what the eq boosted
+	}
+
 	auto loadEntireLibrary(Audio::AudioEngine& engine) -> std::vector<Song> {
 		auto songs = getSongsFromConfigFile();
 
@@ -171,16 +266,27 @@ namespace PersonalMusicPlayer {
 	}
 
 	// returns number of lines printed
-	auto printPlayingSongInfo(Audio::AudioEngine& engine, i32 channelId) -> i32 {
-		auto soundInfo = engine.getPlayingSound(channelId);
-		if (soundInfo.has_value()) {
+	auto printPlayingSongInfo(Audio::AudioEngine& engine, const MetadataStore& metadata, const Song& song, i32 channelId) -> i32 {
+		// polled every second, so only cheap lookups here. nothing in the engine allocates or rereads tags
+		auto playback = engine.getPlaybackPosition(channelId);
+		if (playback.has_value()) {
+			std::string_view title = song.name;
+			std::string_view artist;
+			const auto* soundInfo = engine.getSoundInfo(playback.value().sound);
+			if (soundInfo && !soundInfo->getName().empty()) // fmod has no file name to fall back on for sounds opened from a pack
+				title = soundInfo->getName();
+			auto row = metadata.find(song);
+			if (row.has_value() && !metadata.getTitle(row.value()).empty()) {
+				title = metadata.getTitle(row.value());
+				artist = metadata.getArtist(row.value());
+			}
 			std::cout << std::format(
-				"Song: {}\n\t{}:{}\\{}:{}\n",
-				soundInfo.value().getName(),
-				std::chrono::duration_cast<std::chrono::minutes>(soundInfo.value().getDurationPlayed()).count(),
-				std::chrono::duration_cast<std::chrono::seconds>(soundInfo.value().getDurationPlayed()).count() % 60,
-				std::chrono::duration_cast<std::chrono::minutes>(soundInfo.value().getDuration()).count(),
-				std::chrono::duration_cast<std::chrono::seconds>(soundInfo.value().getDuration()).count() % 60
+				"Song: {}{}{}\n\t{}:{}\\{}:{}\n",
+				artist, artist.empty() ? "" : " - ", title,
+				std::chrono::duration_cast<std::chrono::minutes>(playback.value().position).count(),
+				std::chrono::duration_cast<std::chrono::seconds>(playback.value().position).count() % 60,
+				std::chrono::duration_cast<std::chrono::minutes>(playback.value().duration).count(),
+				std::chrono::duration_cast<std::chrono::seconds>(playback.value().duration).count() % 60
 			);
 			return 2;
 		}
@@ -190,6 +296,50 @@ namespace PersonalMusicPlayer {
 		}
 	}
 
+	// returns number of lines printed
+	auto printEngineStats(Audio::AudioEngine& engine) -> i32 {
+		const auto stats = engine.getStats();
+		constexpr const auto megabyte = 1024.0 * 1024.0;
+		std::cout << std::format(
+			"Engine: channels {} real, {} virtual, {} active | cpu dsp {:.1f}%, stream {:.1f}%, update {:.1f}%\n",
+			stats.channelsReal, stats.channelsVirtual, stats.channelsActive, stats.cpuDsp, stats.cpuStream, stats.cpuUpdate
+		);
+		std::cout << std::format(
+			"\tmemory: fmod {:.1f}MB (peak {:.1f}MB), {} sounds ~{:.1f}MB, packs {:.1f}MB mapped | dropped commands: {}\n",
+			stats.fmodMemoryBytes / megabyte, stats.fmodMemoryPeakBytes / megabyte,
+			stats.soundsLoaded, stats.soundMemoryBytes / megabyte, stats.mappedPackBytes / megabyte, stats.commandsDropped
+		);
+		std::cout << std::format(
+			"\tloads: {} streamed, {} compressed, {} decompressed\n",
+			stats.streamedLoads, stats.compressedLoads, stats.decompressedLoads
+		);
+		std::cout << std::format(
+			"\tupdate p50 {}us p99 {}us | load p50 {}ms p99 {}ms, {} failed | play p50 {}us p99 {}us, {} failed\n",
+			stats.update.percentileNs(0.5) / 1000, stats.update.percentileNs(0.99) / 1000,
+			stats.loadSound.percentileNs(0.5) / 1000000, stats.loadSound.percentileNs(0.99) / 1000000, stats.loadsFailed,
+			stats.playSound.percentileNs(0.5) / 1000, stats.playSound.percentileNs(0.99) / 1000, stats.playsFailed
+		);
+		i32 lines = 4;
+		if (stats.poolBytes != 0) {
+			std::cout << std::format(
+				"\tpool: {:.1f}MB of {:.1f}MB in use (peak {:.1f}MB), {:.1f}MB carved, {:.0f}% fragmented, {} heap fallbacks\n",
+				stats.poolUsedBytes / megabyte, stats.poolBytes / megabyte, stats.poolPeakBytes / megabyte,
+				stats.poolCarvedBytes / megabyte, stats.poolFragmentation * 100.0f, stats.poolFallbacks
+			);
+			lines++;
+		}
+		if (stats.fileRead.count != 0) {
+			std::cout << std::format(
+				"\tfile reads: {}, {:.0f}% read ahead, p50 {}us p99 {}us max {}ms | {:.1f}MB off disk\n",
+				stats.fileRead.count, 100.0 * stats.fileReadAheadHits / stats.fileRead.count,
+				stats.fileRead.percentileNs(0.5) / 1000, stats.fileRead.percentileNs(0.99) / 1000, stats.fileRead.maxNs / 1000000,
+				stats.fileDiskBytes / megabyte
+			);
+			lines++;
+		}
+		return lines;
+	}
+
 	auto printLibraryPositionInfo(const std::vector<Song>& library, i32 currentSongIndex) -> int {
 		std::cout << std::format("Song {}\\{}\n", currentSongIndex + 1, library.size());
 		return 1;
@@ -3,20 +3,15 @@
 
 #include <ranges>
 #include <algorithm>
-#include <iostream>
-#include <format>
-
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
-#include <windef.h>
 
 Input::Input() :
-	keyCallbacks{},
-	keyMap{},
+	bindings{std::make_shared<const Bindings>()},
 	heldKeysMemory{},
-	shutdown{false}
+	reader{},
+	nextCallbackId{0}
 {
-	heldKeysMemory.fill(false);
+	for (auto& held : this->heldKeysMemory)
+		held.store(false, std::memory_order_relaxed);
 
 	this->inputThread = std::make_unique<std::jthread>(
 		[this]() {
@@ -24,181 +19,97 @@ Input::Input() :
 		}
 	);
 }
+Input::~Input() {
+	this->shutdownInput(); // the thread is most likely asleep in the reader, it has to be woken before the join
+}
 auto Input::isPressed(i32 keycode) -> bool {
 	keycode = std::toupper(keycode);
-	std::lock_guard<std::mutex> lock(this->modificationLock);
-	auto foundIter = this->keyMap.find(keycode);
-	if (foundIter != this->keyMap.end()) {
-		if (this->heldKeysMemory[static_cast<i32>(foundIter->second)])
-			return true;
-	}
+	auto current = this->bindings.load();
+	auto foundIter = current->keyMap.find(keycode);
+	if (foundIter != current->keyMap.end())
+		return this->heldKeysMemory[static_cast<i32>(foundIter->second)].load(std::memory_order_relaxed);
 	return false;
 }
 auto Input::registerKeyToAction(i32 keycode, KeyActions action) -> bool {
 	keycode = std::toupper(keycode);
-	std::lock_guard<std::mutex> lock(this->modificationLock);
-	auto foundIter = this->keyMap.find(keycode);
-	if (foundIter != this->keyMap.end())
-		return false;
-	this->keyMap[keycode] = action;
-	return true;
+	return this->modifyBindings([keycode, action](Bindings& next) -> bool {
+		return next.keyMap.emplace(keycode, action).second;
+	});
 }
 auto Input::subscribeToKeypress(std::function<void()> callback, KeyActions action) -> i64 {
-	std::lock_guard<std::mutex> lock(this->modificationLock);
-	this->keyCallbacks[action].push_back(callback);
-	i32 key = -1;
-	for (auto [k, act] : this->keyMap) {
-		if (act == action)
-			key = k;
-	}
-	return this->generateCallbackId(this->keyCallbacks[action].size() - 1, key);
+	return this->modifyBindings([this, &callback, action](Bindings& next) -> i64 {
+		i64 id = this->nextCallbackId++;
+		next.keyCallbacks[action].push_back(Subscription{ id, std::move(callback) });
+		return id;
+	});
 }
 auto Input::unsubscribeCallback(i64 callbackId) -> bool {
-	auto decodedId = this->decodeCallbackId(callbackId);
-	std::lock_guard<std::mutex> lock(this->modificationLock);
-	auto actionIter = this->keyMap.find(decodedId.first);
-	if (actionIter != this->keyMap.end()) {
-		auto foundIter = this->keyCallbacks.find(actionIter->second);
-		if (
-			foundIter != this->keyCallbacks.end() &&
-			decodedId.second < foundIter->second.size()
-		) {
-			foundIter->second.erase(foundIter->second.begin() + decodedId.second);
-			return true;
+	return this->modifyBindings([callbackId](Bindings& next) -> bool {
+		for (auto& [action, subscriptions] : next.keyCallbacks) {
+			if (std::erase_if(subscriptions, [callbackId](const Subscription& s) { return s.id == callbackId; }) > 0)
+				return true;
 		}
-	}
-	
-	return false; // failed to delete
+		return false; // failed to delete
+	});
 }
 auto Input::unsubscribeAllCallbacks() -> void {
-	std::lock_guard<std::mutex> lock(this->modificationLock);
-	this->keyCallbacks.clear();
+	this->modifyBindings([](Bindings& next) -> void {
+		next.keyCallbacks.clear();
+	});
 }
 
+// a callback unsubscribed while this runs may still get this one last call, the snapshot was taken before it left
 auto Input::triggerCallbacks(KeyActions action) -> void {
-	std::lock_guard<std::mutex> lock(this->modificationLock);
-	auto foundIter = this->keyCallbacks.find(action);
-	if (foundIter != this->keyCallbacks.end()) {
-		for (auto keyFunc : (*foundIter).second)
-			keyFunc();
+	auto current = this->bindings.load();
+	auto foundIter = current->keyCallbacks.find(action);
+	if (foundIter != current->keyCallbacks.end()) {
+		for (const auto& subscription : foundIter->second)
+			subscription.callback();
 	}
 }
 
 auto Input::shutdownInput() -> void {
-	this->shutdown = true;
-}
-
-auto Input::generateCallbackId(i32 position, i32 keycode) -> i64 {
-	i64 id = 0; // id is packed keycode and position. if no keycode associated, -1
-	id |= (static_cast<i64>(keycode) << 32);
-	id |= position;
-	return id;
-}
-auto Input::decodeCallbackId(i64 id) -> std::pair<i32, i32> {
-	return std::make_pair<i32, i32>(
-		static_cast<i32>((id & 0xFFFFFFFF00000000) >> 32),
-		static_cast<i32>(id & 0x00000000FFFFFFFF)
-	);
+	if (!this->inputThread)
+		return;
+	this->reader.interrupt();
+	this->inputThread.reset(); // joins
 }
-/*
-checkIfKeyPressed uses GetAsyncKeyState which can tell you if a key is pressed
-and if that key press is new since the last call. However, the second behavior, being
-able to tell if the key press is new, depends on which process calls GetAsyncKeyState first.
-So that second behavior is unreliable. Instead I can hold a bool array for each key I want to keep track of
-and use it to tell if a key press is unique. Each unique one is caught in KeyboardActions, which
-let's it be moved around easily so it can get handled.
-*/
-auto Input::checkKeyboardInput() -> KeyboardActions {
-	constexpr const auto checkIfKeyPressed = [](const int keycode) -> bool {
-		HWND con = GetConsoleWindow(); // console window handle (kinda deprecated but works for now)
-		HWND fore = GetForegroundWindow(); // whatever window has focus (if con == fore, we have focus)
-		return (GetAsyncKeyState(keycode) & 0x8000) && con == fore && con != NULL; // only want focused inputs
-	};
 
+// copies the current snapshot, lets modify change the copy, then publishes it
+template <typename Func>
+auto Input::modifyBindings(Func&& modify) -> decltype(modify(std::declval<Bindings&>())) {
 	std::lock_guard<std::mutex> lock(this->modificationLock);
-	KeyboardActions curr{};
-	for (auto [keyCode, action] : this->keyMap) {
-		if (checkIfKeyPressed(keyCode)) {
-			bool& associatedHeldMem = this->heldKeysMemory[static_cast<i32>(action)];
-			if (associatedHeldMem)
-				curr.held.push_back(action);
-			else {
-				curr.pressed.push_back(action);
-				associatedHeldMem = true;
-			}
-		}
+	auto next = std::make_shared<Bindings>(*this->bindings.load());
+	if constexpr (std::is_void_v<decltype(modify(*next))>) {
+		modify(*next);
+		this->bindings.store(std::move(next));
 	}
-
-	for (auto i = 0; i < this->heldKeysMemory.size(); i++) {
-		bool& associatedHeldMem = this->heldKeysMemory[i];
-		if (associatedHeldMem) {
-			bool pressed = std::any_of(
-				curr.pressed.cbegin(),
-				curr.pressed.cend(),
-				[i](KeyActions k) {
-					return i == static_cast<i32>(k);
-				}
-			);
-			bool held = std::any_of(
-				curr.held.cbegin(),
-				curr.held.cend(),
-				[i](KeyActions k) {
-					return i == static_cast<i32>(k);
-				}
-			);
-			if (!(pressed || held)) {
-				associatedHeldMem = false;
-				curr.released.push_back(static_cast<KeyActions>(i));
-			}
-		}
+	else {
+		auto result = modify(*next);
+		this->bindings.store(std::move(next));
+		return result;
 	}
-
-	return curr;
 }
-auto Input::inputThreadFunction() -> void {
-	while (!this->shutdown) {
-		auto keyboardActions = this->checkKeyboardInput();
 
-		for (auto i = 0; i < keyboardActions.pressed.size(); i++) {
-			//std::cout << std::format(
-			//	"Key Action Pressed: {}, Active == Foreground: {}, Non-Null: {}\n",
-			//	static_cast<i32>(keyboardActions.pressed[i]),
-			//	(GetConsoleWindow() == GetForegroundWindow() ? "same" : "different"),
-			//	(GetConsoleWindow() != NULL ? "not null" : "null")
-			//);
-			this->triggerCallbacks(keyboardActions.pressed[i]);
-		}
-		
-		/*
-		for (auto i = 0; i < keyboardActions.held.size(); i++) {
-			std::cout << std::format(
-				"Key Action Held: {}\n",
-				static_cast<i32>(keyboardActions.held[i])
-			);
-		}
-		for (auto i = 0; i < keyboardActions.released.size(); i++) {
-			std::cout << std::format(
-				"Key Action Released: {}\n",
-				static_cast<i32>(keyboardActions.released[i])
-			);
-		}
-		*/
-
-		
-
-		/*
-		if (keyboardActions.nextSong || keyboardActions.prevSong ||
-			keyboardActions.togglePaused || keyboardActions.shuffleSongs ||
-			keyboardActions.quitApplication) {
-			std::cout << std::format(
-				"nextSong: {}, prevSong: {}, togglePaused: {}, shuffleSongs: {}, quit: {}\n",
-				(keyboardActions.nextSong ? "true" : "false"),
-				(keyboardActions.prevSong ? "true" : "false"),
-				(keyboardActions.togglePaused ? "true" : "false"),
-				(keyboardActions.shuffleSongs ? "true" : "false"),
-				(keyboardActions.quitApplication ? "true" : "false")
-			);
+/*
+	the reader hands over key downs and ups as they happen, so a press is just a down on a key that wasn't
+	already held. holding a key down makes windows repeat the down without an up in between, and
+	heldKeysMemory keeps those from counting as new presses
+*/
+auto Input::inputThreadFunction() -> void {
+	KeyReader::KeyEvent key{};
+	while (this->reader.waitForKey(key)) {
+		auto current = this->bindings.load();
+		auto foundIter = current->keyMap.find(std::toupper(key.keycode));
+		if (foundIter == current->keyMap.end())
+			continue;
+		KeyActions action = foundIter->second;
+		auto& held = this->heldKeysMemory[static_cast<i32>(action)];
+		if (!key.down) {
+			held.store(false, std::memory_order_relaxed);
+			continue;
 		}
-		*/
+		if (!held.exchange(true, std::memory_order_relaxed))
+			this->triggerCallbacks(action);
 	}
 }
@@ -2,10 +2,13 @@
 
 #include "PrimitiveTypes.hpp"
 
+#include "KeyReader.hpp"
+
 #include <unordered_map>
 #include <functional>
 #include <vector>
 #include <mutex>
+#include <atomic>
 #include <thread>
 #include <memory>
 #include <type_traits>
@@ -17,15 +20,17 @@ const enum struct KeyActions : i32 {
 	togglePaused = 2,
 	shuffleSongs = 3,
 	quitApplication = 4,
-	MAX_SIZE = 5
-};
-
-struct KeyboardActions {
-	std::vector<KeyActions> pressed;
-	std::vector<KeyActions> held;
-	std::vector<KeyActions> released;
+	toggleStats = 5,
+	MAX_SIZE = 6
 };
 
+/*
+	key presses come from a KeyReader on the input thread, which sleeps until there is one.
+	the key map and the callbacks live in one immutable Bindings snapshot. changing them copies the snapshot
+	under modificationLock and swaps the new one in, so dispatch just grabs the current pointer and runs callbacks
+	without holding any lock. a callback can (un)subscribe or take whatever locks it likes without deadlocking input.
+	callbacks run on the input thread, one at a time, in the order they subscribed.
+*/
 class Input {
 public:
 	static Input& getInstance() {
@@ -37,27 +42,36 @@ private:
 public:
 	Input(const Input&) = delete;
 	void operator=(const Input&) = delete;
+	~Input();
 
 private:
-	std::unordered_map<i32, KeyActions> keyMap;
-	std::unordered_map<KeyActions, std::vector<std::function<void()>>> keyCallbacks;
-	std::array<bool, static_cast<i32>(KeyActions::MAX_SIZE)> heldKeysMemory;
+	struct Subscription {
+		i64 id;
+		std::function<void()> callback;
+	};
+	struct Bindings {
+		std::unordered_map<i32, KeyActions> keyMap;
+		std::unordered_map<KeyActions, std::vector<Subscription>> keyCallbacks;
+	};
+
+	std::atomic<std::shared_ptr<const Bindings>> bindings; // never modified once published
+	std::array<std::atomic<bool>, static_cast<i32>(KeyActions::MAX_SIZE)> heldKeysMemory; // written by the input thread only
+	KeyReader reader;
 	std::unique_ptr<std::jthread> inputThread;
-	std::mutex modificationLock;
-	bool shutdown;
+	std::mutex modificationLock; // only keeps writers from losing each other's changes, dispatch never takes it
+	i64 nextCallbackId; // guarded by modificationLock
 
 public:
-	auto isPressed(i32 keycode) -> bool;
+	auto isPressed(i32 keycode) -> bool; // key down and not yet released. terminal keys are only down for an instant
 	auto registerKeyToAction(i32 keycode, KeyActions action) -> bool;
 	auto subscribeToKeypress(std::function<void()> callback, KeyActions action) -> i64;
 	auto unsubscribeCallback(i64 callbackId) -> bool;
 	auto unsubscribeAllCallbacks() -> void;
 	auto triggerCallbacks(KeyActions action) -> void;
-	auto shutdownInput() -> void;
+	auto shutdownInput() -> void; // stops and joins the input thread. don't call it from a callback
 
 private:
-	auto generateCallbackId(i32 position, i32 keycode = -1) -> i64;
-	auto decodeCallbackId(i64 id) -> std::pair<i32, i32>;
-	auto checkKeyboardInput() -> KeyboardActions;
+	template <typename Func>
+	auto modifyBindings(Func&& modify) -> decltype(modify(std::declval<Bindings&>()));
 	auto inputThreadFunction() -> void;
 };
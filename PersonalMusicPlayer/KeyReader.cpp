@@ -0,0 +1,131 @@
+
+#include "KeyReader.hpp"
+
+#include <cctype>
+#include <deque>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#ifdef _WIN32
+struct KeyReader::Platform {
+	HANDLE console = INVALID_HANDLE_VALUE;
+	HANDLE wakeEvent = nullptr; // manual reset, so once it's set every wait after sees it too
+	std::deque<KeyEvent> pending; // a single read can hand back several records
+};
+
+KeyReader::KeyReader(i32) : platform{std::make_unique<Platform>()} {
+	this->platform->console = GetStdHandle(STD_INPUT_HANDLE);
+	this->platform->wakeEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+}
+
+KeyReader::~KeyReader() {
+	if (this->platform->wakeEvent)
+		CloseHandle(this->platform->wakeEvent);
+}
+
+auto KeyReader::waitForKey(KeyEvent& out) -> bool {
+	Platform& p = *this->platform;
+	while (p.pending.empty()) {
+		HANDLE handles[2] = { p.wakeEvent, p.console };
+		DWORD signaled = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+		if (signaled != WAIT_OBJECT_0 + 1)
+			return false; // interrupted, or the wait itself failed
+		INPUT_RECORD records[16];
+		DWORD read = 0;
+		if (!ReadConsoleInputW(p.console, records, 16, &read))
+			return false;
+		for (DWORD i = 0; i < read; i++) { // mouse, focus and resize records wake us up too, they just get dropped
+			if (records[i].EventType != KEY_EVENT)
+				continue;
+			const KEY_EVENT_RECORD& key = records[i].Event.KeyEvent;
+			p.pending.push_back(KeyEvent{ static_cast<i32>(key.wVirtualKeyCode), key.bKeyDown != FALSE });
+		}
+	}
+	out = p.pending.front();
+	p.pending.pop_front();
+	return true;
+}
+
+auto KeyReader::interrupt() -> void {
+	SetEvent(this->platform->wakeEvent);
+}
+#else
+struct KeyReader::Platform {
+	i32 fd = 0;
+	i32 wakePipe[2] = { -1, -1 }; // interrupt() writes a byte, poll() wakes up on the read end
+	bool restoreTerminal = false;
+	termios saved{};
+	std::deque<KeyEvent> pending;
+};
+
+KeyReader::KeyReader(i32 fd) : platform{std::make_unique<Platform>()} {
+	Platform& p = *this->platform;
+	p.fd = fd;
+	if (pipe(p.wakePipe) != 0)
+		p.wakePipe[0] = p.wakePipe[1] = -1;
+	if (isatty(fd) && tcgetattr(fd, &p.saved) == 0) {
+		termios raw = p.saved;
+		raw.c_lflag &= ~static_cast<tcflag_t>(ICANON | ECHO); // keys as they're typed, without printing them
+		raw.c_cc[VMIN] = 1;
+		raw.c_cc[VTIME] = 0;
+		p.restoreTerminal = tcsetattr(fd, TCSANOW, &raw) == 0;
+	}
+}
+
+KeyReader::~KeyReader() {
+	Platform& p = *this->platform;
+	if (p.restoreTerminal)
+		tcsetattr(p.fd, TCSANOW, &p.saved);
+	for (i32 end : p.wakePipe) {
+		if (end >= 0)
+			close(end);
+	}
+}
+
+auto KeyReader::waitForKey(KeyEvent& out) -> bool {
+	Platform& p = *this->platform;
+	while (p.pending.empty()) {
+		pollfd fds[2] = {
+			pollfd{ p.wakePipe[0], POLLIN, 0 },
+			pollfd{ p.fd, POLLIN, 0 }
+		};
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		if (fds[0].revents != 0)
+			return false; // interrupted
+		if (fds[1].revents == 0)
+			continue;
+		unsigned char bytes[16];
+		ssize_t read = ::read(p.fd, bytes, sizeof(bytes));
+		if (read < 0 && errno == EINTR)
+			continue;
+		if (read <= 0)
+			return false; // closed (or broken), nothing more is coming
+		// an escape sequence (arrows, function keys) shows up in one read. its trailing letters aren't key presses
+		for (ssize_t i = 0; i < read && bytes[i] != 0x1b; i++) {
+			p.pending.push_back(KeyEvent{ std::toupper(bytes[i]), true });
+			p.pending.push_back(KeyEvent{ std::toupper(bytes[i]), false }); // no releases from a terminal, so each one is a tap
+		}
+	}
+	out = p.pending.front();
+	p.pending.pop_front();
+	return true;
+}
+
+auto KeyReader::interrupt() -> void {
+	const unsigned char wake = 1;
+	if (this->platform->wakePipe[1] >= 0)
+		[[maybe_unused]] auto written = write(this->platform->wakePipe[1], &wake, 1); // the pipe only needs to be non empty
+}
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <memory>
+
+/*
+	blocks until a key actually comes in instead of polling for one. on windows that's the console's input
+	queue (only gets keys while the console has focus), everywhere else it's poll() on a file descriptor.
+	a terminal gets switched out of line mode (no echo, no waiting for enter) while the reader lives,
+	anything else (a pipe, a file) is just read a byte at a time, so keys can be fed in without a tty.
+*/
+class KeyReader {
+public:
+	struct KeyEvent {
+		i32 keycode; // uppercase ascii for letters and digits, same as the windows virtual key codes
+		bool down; // terminals only report presses, they come through as a down right before an up
+	};
+
+	explicit KeyReader(i32 fd = 0); // fd is ignored on windows
+	~KeyReader();
+	KeyReader(const KeyReader&) = delete;
+	void operator=(const KeyReader&) = delete;
+
+	// sleeps until there's a key. false once interrupt() was called or the input closed
+	auto waitForKey(KeyEvent& out) -> bool;
+	auto interrupt() -> void; // any thread, wakes waitForKey for good
+
+private:
+	struct Platform; // os handles and saved terminal state, kept out of the header
+	std::unique_ptr<Platform> platform;
+};
@@ -0,0 +1,246 @@
+
+#include "LibraryIndex.hpp"
+
+#include <fstream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <array>
+
+namespace {
+	constexpr const std::array<char, 4> indexMagic = { 'P', 'M', 'P', 'I' };
+	constexpr const u32 indexVersion = 1;
+
+	auto toTicks(std::filesystem::file_time_type time) -> i64 {
+		return static_cast<i64>(time.time_since_epoch().count());
+	}
+
+	// tiny binary helpers. everything is written in native byte order, the index never leaves the machine
+	template <typename T>
+	auto writeValue(std::ofstream& out, const T& value) -> void {
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+	auto writeString(std::ofstream& out, const std::string& str) -> void {
+		writeValue(out, static_cast<u32>(str.size()));
+		out.write(str.data(), str.size());
+	}
+	template <typename T>
+	auto readValue(std::ifstream& in, T& value) -> bool {
+		return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+	auto readString(std::ifstream& in, std::string& str) -> bool {
+		u32 size;
+		if (!readValue(in, size)) return false;
+		str.resize(size);
+		return static_cast<bool>(in.read(str.data(), size));
+	}
+};
+
+auto LibraryIndex::load(const std::filesystem::path& indexPath) -> LibraryIndex {
+	LibraryIndex index{};
+	std::ifstream in(indexPath, std::ios::binary);
+	if (!in) return index;
+
+	std::array<char, 4> magic;
+	u32 version, directoryCount;
+	if (!readValue(in, magic) || magic != indexMagic) return index;
+	if (!readValue(in, version) || version != indexVersion) return index;
+	if (!readValue(in, directoryCount)) return index;
+
+	index.directories.reserve(directoryCount);
+	for (u32 i = 0; i < directoryCount; i++) {
+		std::string path;
+		IndexedDirectory directory{};
+		u32 fileCount, subdirectoryCount;
+		if (!readString(in, path) || !readValue(in, directory.mtime) || !readValue(in, directory.rejectedFiles))
+			return LibraryIndex{};
+		if (!readValue(in, fileCount)) return LibraryIndex{};
+		directory.files.resize(fileCount);
+		for (auto& file : directory.files) {
+			if (!readString(in, file.name) || !readValue(in, file.size) || !readValue(in, file.mtime) || !readValue(in, file.type))
+				return LibraryIndex{}; // truncated, start over rather than trust half of it
+		}
+		if (!readValue(in, subdirectoryCount)) return LibraryIndex{};
+		directory.subdirectories.resize(subdirectoryCount);
+		for (auto& subdirectory : directory.subdirectories) {
+			if (!readString(in, subdirectory)) return LibraryIndex{};
+		}
+		index.directories.emplace(std::move(path), std::move(directory));
+	}
+	return index;
+}
+
+auto LibraryIndex::save(const std::filesystem::path& indexPath) const -> bool {
+	auto tempPath = indexPath;
+	tempPath += ".tmp"; // write aside and swap so a crash mid-write can't leave a broken index
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+		writeValue(out, indexMagic);
+		writeValue(out, indexVersion);
+		writeValue(out, static_cast<u32>(this->directories.size()));
+		for (const auto& [path, directory] : this->directories) {
+			writeString(out, path);
+			writeValue(out, directory.mtime);
+			writeValue(out, directory.rejectedFiles);
+			writeValue(out, static_cast<u32>(directory.files.size()));
+			for (const auto& file : directory.files) {
+				writeString(out, file.name);
+				writeValue(out, file.size);
+				writeValue(out, file.mtime);
+				writeValue(out, file.type);
+			}
+			writeValue(out, static_cast<u32>(directory.subdirectories.size()));
+			for (const auto& subdirectory : directory.subdirectories)
+				writeString(out, subdirectory);
+		}
+		if (!out) return false;
+	}
+	std::error_code error;
+	std::filesystem::rename(tempPath, indexPath, error);
+	return !error;
+}
+
+auto LibraryIndex::refresh(
+	const std::vector<std::string>& folders,
+	const std::vector<std::string>& recursiveFolders,
+	const FileClassifier& classify
+) -> RefreshStats {
+	struct Job {
+		std::string path;
+		bool recursive;
+	};
+
+	std::mutex lock; // guards everything below plus stats
+	std::condition_variable workAvailable;
+	std::vector<Job> jobs;
+	u32 outstanding = 0; // queued + in progress, workers quit once it hits 0
+	std::unordered_map<std::string, IndexedDirectory> refreshed;
+	RefreshStats stats{};
+
+	for (const auto& folder : folders)
+		jobs.push_back(Job{ folder, false });
+	for (const auto& folder : recursiveFolders)
+		jobs.push_back(Job{ folder, true });
+	outstanding = static_cast<u32>(jobs.size());
+
+	// runs without the lock held. only reads this->directories, which nobody writes during refresh
+	const auto visit = [this, &classify](const Job& job, IndexedDirectory& result, bool& reused) -> bool {
+		std::error_code error;
+		auto mtime = std::filesystem::last_write_time(job.path, error);
+		if (error) return false;
+
+		auto cachedIter = this->directories.find(job.path);
+		if (cachedIter != this->directories.end() && cachedIter->second.mtime == toTicks(mtime)) {
+			result = cachedIter->second;
+			reused = true;
+			// the listing is still good, but editing a file in place (retagging) doesn't touch its directory's mtime.
+			// a stat per file is still much cheaper than walking the directory again
+			std::erase_if(result.files, [&job](IndexedFile& file) {
+				const auto filePath = std::filesystem::path(job.path) / file.name;
+				std::error_code fileError;
+				u64 size = std::filesystem::file_size(filePath, fileError);
+				if (fileError)
+					return true; // gone since the listing, the next real scan would drop it too
+				auto fileTime = std::filesystem::last_write_time(filePath, fileError);
+				if (fileError)
+					return true;
+				file.size = size;
+				file.mtime = toTicks(fileTime);
+				return false;
+			});
+			return true;
+		}
+
+		reused = false;
+		result = IndexedDirectory{ toTicks(mtime), 0, {}, {} };
+		for (std::filesystem::directory_iterator iter(job.path, error), end; !error && iter != end; iter.increment(error)) {
+			const auto& entry = *iter;
+			std::error_code entryError;
+			if (entry.is_directory(entryError)) {
+				if (entry.is_symlink(entryError))
+					continue; // not followed, a link back up the tree would have the walk going round forever
+				result.subdirectories.push_back(entry.path().filename().string());
+				continue;
+			}
+			i32 type = classify(entry.path());
+			if (type < 0) {
+				result.rejectedFiles++;
+				continue;
+			}
+			u64 size = entry.file_size(entryError);
+			auto fileTime = entry.last_write_time(entryError);
+			if (entryError) { // vanished between listing and stat
+				result.rejectedFiles++;
+				continue;
+			}
+			result.files.push_back(IndexedFile{ entry.path().filename().string(), size, toTicks(fileTime), static_cast<u8>(type) });
+		}
+		return !error;
+	};
+
+	const auto worker = [&]() -> void {
+		std::unique_lock<std::mutex> guard(lock);
+		for (;;) {
+			workAvailable.wait(guard, [&]() { return !jobs.empty() || outstanding == 0; });
+			if (jobs.empty())
+				return; // outstanding == 0, nothing left anywhere
+			Job job = std::move(jobs.back());
+			jobs.pop_back();
+			guard.unlock();
+
+			IndexedDirectory result{};
+			bool reused = false;
+			bool valid = visit(job, result, reused);
+
+			guard.lock();
+			if (!valid)
+				stats.invalidPaths++;
+			else {
+				(reused ? stats.directoriesReused : stats.directoriesScanned)++;
+				stats.rejectedFiles += result.rejectedFiles;
+				if (job.recursive) {
+					for (const auto& subdirectory : result.subdirectories) {
+						jobs.push_back(Job{ (std::filesystem::path(job.path) / subdirectory).string(), true });
+						outstanding++;
+					}
+				}
+				refreshed.insert_or_assign(job.path, std::move(result));
+			}
+			outstanding--;
+			workAvailable.notify_all();
+		}
+	};
+
+	{
+		u32 workerCount = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<std::jthread> workers;
+		for (u32 i = 0; i < workerCount; i++)
+			workers.emplace_back(worker);
+	} // jthreads join here
+
+	this->directories = std::move(refreshed);
+	return stats;
+}
+
+auto LibraryIndex::getSongs() const -> std::vector<Song> {
+	std::vector<const std::string*> paths;
+	paths.reserve(this->directories.size());
+	size_t fileCount = 0;
+	for (const auto& [path, directory] : this->directories) {
+		paths.push_back(&path);
+		fileCount += directory.files.size();
+	}
+	std::sort(paths.begin(), paths.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+
+	std::vector<Song> songs;
+	songs.reserve(fileCount);
+	for (const auto* path : paths) {
+		for (const auto& file : this->directories.at(*path).files) {
+			const auto filePath = std::filesystem::path(*path) / file.name;
+			songs.emplace_back(filePath.string(), filePath.stem().string(), file.size, file.mtime);
+		}
+	}
+	return songs;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "Song.hpp"
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/*
+	on-disk cache of what's in the configured music folders, so startup doesn't have to list every directory.
+	a directory's mtime only changes when entries are added, removed or renamed, so if it matches what we saved
+	last time, the saved file list (and subdirectory list) is reused without touching the directory's contents.
+	only directories whose mtime moved get listed again. directories are checked on a pool of threads since
+	on a network share it's all waiting on round trips anyway.
+*/
+class LibraryIndex {
+public:
+	// returns an index into whatever type table the caller uses, or -1 to skip the file
+	typedef std::function<i32(const std::filesystem::path&)> FileClassifier;
+
+	struct IndexedFile {
+		std::string name; // file name only, the directory is the map key
+		u64 size;
+		i64 mtime;
+		u8 type; // from the classifier
+	};
+	struct IndexedDirectory {
+		i64 mtime;
+		u32 rejectedFiles; // entries the classifier skipped, kept so the stats stay right on reuse
+		std::vector<IndexedFile> files;
+		std::vector<std::string> subdirectories; // names only
+	};
+	struct RefreshStats {
+		u32 directoriesReused;
+		u32 directoriesScanned;
+		u32 invalidPaths;
+		u32 rejectedFiles;
+	};
+
+	// an empty index if the file is missing, unreadable or from an older version
+	static auto load(const std::filesystem::path& indexPath) -> LibraryIndex;
+	auto save(const std::filesystem::path& indexPath) const -> bool;
+
+	// revalidates against the filesystem. directories no longer reachable from these roots are dropped
+	auto refresh(
+		const std::vector<std::string>& folders,
+		const std::vector<std::string>& recursiveFolders,
+		const FileClassifier& classify
+	) -> RefreshStats;
+
+	auto getSongs() const -> std::vector<Song>; // sorted by directory so the order is stable across runs
+
+private:
+	std::unordered_map<std::string, IndexedDirectory> directories;
+};
@@ -0,0 +1,421 @@
+#include "MetadataStore.hpp"
+
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_set>
+
+namespace {
+	constexpr const std::array<char, 4> storeMagic = { 'P', 'M', 'P', 'M' };
+	constexpr const u32 storeVersion = 2; // 2 added loudness
+	constexpr const u32 columnAlignment = 8; // so every fixed width column can be read in place
+
+	enum struct ColumnId : u32 {
+		fileSize = 0,
+		fileMtime,
+		duration,
+		sampleRate,
+		channels,
+		bitsPerSample,
+		readable,
+		type,
+		pathOffsets,
+		pathChars,
+		titleOffsets,
+		titleChars,
+		artistOffsets,
+		artistChars,
+		albumOffsets,
+		albumChars,
+		genreOffsets,
+		genreChars,
+		typeNameOffsets,
+		typeNameChars,
+		loudness,
+		truePeak,
+		count
+	};
+
+	struct FileHeader {
+		std::array<char, 4> magic;
+		u32 version;
+		u32 rowCount;
+		u32 columnCount;
+	};
+	struct ColumnEntry {
+		u32 id;
+		u32 reserved;
+		u64 offset; // from the start of the file
+		u64 bytes;
+	};
+
+	// a row while it's being built, owns its strings
+	struct Row {
+		std::string path;
+		u64 fileSize = 0;
+		i64 fileMtime = 0;
+		u32 duration = 0;
+		u32 sampleRate = 0;
+		u8 channels = 0;
+		u8 bitsPerSample = 0;
+		bool readable = false;
+		std::string type;
+		std::string title;
+		std::string artist;
+		std::string album;
+		std::string genre;
+		f32 loudness = std::numeric_limits<f32>::quiet_NaN(); // nan: not analyzed yet
+		f32 truePeak = std::numeric_limits<f32>::quiet_NaN();
+	};
+
+	// id3v2 frames, vorbis comments and asf/wma attributes all name the same things differently
+	auto tagField(Row& row, const std::string& tagName) -> std::string* {
+		std::string upper(tagName);
+		std::ranges::transform(upper, upper.begin(), [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+		if (upper == "TITLE" || upper == "TIT2" || upper == "TT2")
+			return &row.title;
+		if (upper == "ARTIST" || upper == "TPE1" || upper == "TP1" || upper == "AUTHOR")
+			return &row.artist;
+		if (upper == "ALBUM" || upper == "TALB" || upper == "TAL" || upper == "WM/ALBUMTITLE")
+			return &row.album;
+		if (upper == "GENRE" || upper == "TCON" || upper == "TCO" || upper == "WM/GENRE")
+			return &row.genre;
+		return nullptr;
+	}
+
+	auto extract(Audio::MetadataReader& reader, Row& row) -> void {
+		Audio::SoundMetadata metadata{};
+		if (!reader.read(row.path, metadata))
+			return; // row.readable stays false
+		row.readable = true;
+		row.duration = static_cast<u32>(metadata.duration.count());
+		row.sampleRate = static_cast<u32>(metadata.sampleRate);
+		row.channels = static_cast<u8>(std::clamp(metadata.channels, 0, 255));
+		row.bitsPerSample = static_cast<u8>(std::clamp(metadata.bitsPerSample, 0, 255));
+		row.type = std::move(metadata.type);
+		for (auto& [name, value] : metadata.tags) {
+			auto* field = tagField(row, name);
+			if (field && field->empty())
+				*field = std::move(value);
+		}
+	}
+
+	auto analyze(Audio::MetadataReader& reader, Row& row) -> void {
+		Audio::LoudnessInfo loudness{};
+		reader.analyzeLoudness(row.path, loudness); // on failure it keeps -inf, which means no gain and isn't retried
+		row.loudness = loudness.integratedLufs;
+		row.truePeak = loudness.truePeakdB;
+	}
+
+	// column bytes are built in memory first so the column table can be written ahead of them
+	struct ColumnBuffer {
+		ColumnId id;
+		std::vector<u8> bytes;
+	};
+
+	template <typename T, typename Func>
+	auto fixedColumn(ColumnId id, const std::vector<Row>& rows, Func&& get) -> ColumnBuffer {
+		ColumnBuffer column{ id, std::vector<u8>(rows.size() * sizeof(T)) };
+		for (size_t i = 0; i < rows.size(); i++) {
+			T value = get(rows[i]);
+			std::memcpy(column.bytes.data() + i * sizeof(T), &value, sizeof(T));
+		}
+		return column;
+	}
+
+	template <typename Func>
+	auto stringColumns(ColumnId offsetsId, ColumnId charsId, size_t count, Func&& get, std::vector<ColumnBuffer>& out) -> void {
+		ColumnBuffer offsets{ offsetsId, std::vector<u8>((count + 1) * sizeof(u32)) };
+		ColumnBuffer chars{ charsId, {} };
+		for (size_t i = 0; i <= count; i++) {
+			u32 offset = static_cast<u32>(chars.bytes.size());
+			std::memcpy(offsets.bytes.data() + i * sizeof(u32), &offset, sizeof(u32));
+			if (i < count) {
+				std::string_view value = get(i);
+				chars.bytes.insert(chars.bytes.end(), value.begin(), value.end());
+			}
+		}
+		out.push_back(std::move(offsets));
+		out.push_back(std::move(chars));
+	}
+
+	auto write(const std::vector<Row>& rows, const std::filesystem::path& storePath) -> bool {
+		std::vector<std::string> typeNames; // a handful of distinct values, so store an index per row
+		std::vector<u8> typeIndices(rows.size());
+		for (size_t i = 0; i < rows.size(); i++) {
+			auto found = std::ranges::find(typeNames, rows[i].type);
+			if (found == typeNames.end() && typeNames.size() < 256)
+				found = typeNames.insert(typeNames.end(), rows[i].type);
+			typeIndices[i] = found == typeNames.end() ? 0 : static_cast<u8>(found - typeNames.begin());
+		}
+
+		std::vector<ColumnBuffer> columns;
+		columns.reserve(static_cast<size_t>(ColumnId::count));
+		columns.push_back(fixedColumn<u64>(ColumnId::fileSize, rows, [](const Row& r) { return r.fileSize; }));
+		columns.push_back(fixedColumn<i64>(ColumnId::fileMtime, rows, [](const Row& r) { return r.fileMtime; }));
+		columns.push_back(fixedColumn<u32>(ColumnId::duration, rows, [](const Row& r) { return r.duration; }));
+		columns.push_back(fixedColumn<u32>(ColumnId::sampleRate, rows, [](const Row& r) { return r.sampleRate; }));
+		columns.push_back(fixedColumn<u8>(ColumnId::channels, rows, [](const Row& r) { return r.channels; }));
+		columns.push_back(fixedColumn<u8>(ColumnId::bitsPerSample, rows, [](const Row& r) { return r.bitsPerSample; }));
+		columns.push_back(fixedColumn<u8>(ColumnId::readable, rows, [](const Row& r) { return static_cast<u8>(r.readable); }));
+		columns.push_back(ColumnBuffer{ ColumnId::type, std::move(typeIndices) });
+		columns.push_back(fixedColumn<f32>(ColumnId::loudness, rows, [](const Row& r) { return r.loudness; }));
+		columns.push_back(fixedColumn<f32>(ColumnId::truePeak, rows, [](const Row& r) { return r.truePeak; }));
+		stringColumns(ColumnId::pathOffsets, ColumnId::pathChars, rows.size(), [&rows](size_t i) -> std::string_view { return rows[i].path; }, columns);
+		stringColumns(ColumnId::titleOffsets, ColumnId::titleChars, rows.size(), [&rows](size_t i) -> std::string_view { return rows[i].title; }, columns);
+		stringColumns(ColumnId::artistOffsets, ColumnId::artistChars, rows.size(), [&rows](size_t i) -> std::string_view { return rows[i].artist; }, columns);
+		stringColumns(ColumnId::albumOffsets, ColumnId::albumChars, rows.size(), [&rows](size_t i) -> std::string_view { return rows[i].album; }, columns);
+		stringColumns(ColumnId::genreOffsets, ColumnId::genreChars, rows.size(), [&rows](size_t i) -> std::string_view { return rows[i].genre; }, columns);
+		stringColumns(ColumnId::typeNameOffsets, ColumnId::typeNameChars, typeNames.size(), [&typeNames](size_t i) -> std::string_view { return typeNames[i]; }, columns);
+
+		const auto align = [](u64 offset) -> u64 { return (offset + columnAlignment - 1) & ~static_cast<u64>(columnAlignment - 1); };
+		std::vector<ColumnEntry> entries;
+		u64 offset = align(sizeof(FileHeader) + columns.size() * sizeof(ColumnEntry));
+		for (const auto& column : columns) {
+			entries.push_back(ColumnEntry{ static_cast<u32>(column.id), 0, offset, column.bytes.size() });
+			offset = align(offset + column.bytes.size());
+		}
+
+		auto tempPath = storePath;
+		tempPath += ".tmp";
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			if (!out) return false;
+			FileHeader header{ storeMagic, storeVersion, static_cast<u32>(rows.size()), static_cast<u32>(columns.size()) };
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ColumnEntry));
+			for (size_t i = 0; i < columns.size(); i++) {
+				const std::array<char, columnAlignment> padding{};
+				out.write(padding.data(), entries[i].offset - static_cast<u64>(out.tellp()));
+				out.write(reinterpret_cast<const char*>(columns[i].bytes.data()), columns[i].bytes.size());
+			}
+			if (!out) return false;
+		}
+		std::error_code error;
+		std::filesystem::rename(tempPath, storePath, error);
+		return !error;
+	}
+};
+
+auto MetadataStore::refresh(const std::vector<Song>& songs, const std::filesystem::path& storePath, bool analyzeLoudness, RefreshStats* stats) -> MetadataStore {
+	RefreshStats counts{};
+	std::vector<Row> rows;
+	std::vector<size_t> missing; // rows that need reading
+	std::vector<size_t> unmeasured; // reused rows that only need their loudness
+	{
+		auto previous = MetadataStore::open(storePath);
+		std::unordered_set<std::string_view> seen;
+		rows.reserve(songs.size());
+		for (const auto& song : songs) {
+			if (!seen.insert(song.path).second)
+				continue; // individual files can repeat a folder's songs
+			auto row = previous.find(song);
+			if (row.has_value()) {
+				u32 r = row.value();
+				rows.push_back(Row{
+					song.path, song.size, song.mtime,
+					previous.durations[r], previous.sampleRates[r], previous.channels[r], previous.bitsPerSample[r], previous.readable[r] != 0,
+					std::string(previous.getType(r)), std::string(previous.getTitle(r)), std::string(previous.getArtist(r)),
+					std::string(previous.getAlbum(r)), std::string(previous.getGenre(r)),
+					previous.loudness[r], previous.truePeaks[r]
+				});
+				counts.reused++;
+				if (analyzeLoudness && rows.back().readable && std::isnan(rows.back().loudness))
+					unmeasured.push_back(rows.size() - 1);
+			}
+			else {
+				rows.push_back(Row{ song.path, song.size, song.mtime });
+				missing.push_back(rows.size() - 1);
+			}
+		}
+		if (missing.empty() && unmeasured.empty() && rows.size() == previous.size()) { // nothing changed, keep the mapping we already have
+			if (stats) *stats = counts;
+			return previous;
+		}
+	} // previous is unmapped here, windows won't replace a file that's mapped
+
+	{
+		// one shared list so a worker stuck decoding a long song doesn't hold up the rest
+		std::atomic<size_t> next = 0;
+		const size_t taskCount = missing.size() + unmeasured.size();
+		const auto worker = [&rows, &missing, &unmeasured, &next, taskCount, analyzeLoudness]() -> void {
+			Audio::MetadataReader reader{};
+			if (!reader.isValid())
+				return; // the other workers pick up the slack
+			for (size_t i = next++; i < taskCount; i = next++) {
+				Row& row = rows[i < missing.size() ? missing[i] : unmeasured[i - missing.size()]];
+				if (i < missing.size())
+					extract(reader, row);
+				if (analyzeLoudness && row.readable)
+					analyze(reader, row);
+			}
+		};
+		// nothing to read when songs were only removed, and clamp's bounds have to stay ordered
+		const u32 workerCount = taskCount == 0 ? 0 : static_cast<u32>(std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), taskCount));
+		std::vector<std::jthread> workers;
+		for (u32 i = 0; i < workerCount; i++)
+			workers.emplace_back(worker);
+	} // jthreads join here
+
+	for (size_t i : missing)
+		(rows[i].readable ? counts.extracted : counts.failed)++;
+	if (analyzeLoudness)
+		counts.analyzed = static_cast<u32>(std::ranges::count_if(missing, [&rows](size_t i) { return rows[i].readable; }) + unmeasured.size());
+	if (stats) *stats = counts;
+
+	if (!write(rows, storePath))
+		return MetadataStore{};
+	return MetadataStore::open(storePath);
+}
+
+auto MetadataStore::open(const std::filesystem::path& storePath) -> MetadataStore {
+	MetadataStore store{};
+	if (!store.file.open(storePath.string()))
+		return store;
+	const u8* base = store.file.data();
+	const size_t length = store.file.size();
+
+	FileHeader header;
+	if (length < sizeof(header)) return MetadataStore{};
+	std::memcpy(&header, base, sizeof(header));
+	if (header.magic != storeMagic || header.version != storeVersion) return MetadataStore{};
+	if (length < sizeof(header) + static_cast<u64>(header.columnCount) * sizeof(ColumnEntry)) return MetadataStore{};
+
+	const u64 rowCount = header.rowCount;
+	std::array<const ColumnEntry*, static_cast<size_t>(ColumnId::count)> found{};
+	const auto* entries = reinterpret_cast<const ColumnEntry*>(base + sizeof(header));
+	for (u32 i = 0; i < header.columnCount; i++) {
+		const auto& entry = entries[i];
+		if (entry.offset % columnAlignment != 0 || entry.offset > length || entry.bytes > length - entry.offset)
+			return MetadataStore{};
+		if (entry.id < found.size()) // unknown ids are skipped, newer writers may add columns
+			found[entry.id] = &entry;
+	}
+	if (std::ranges::any_of(found, [](const ColumnEntry* entry) { return entry == nullptr; }))
+		return MetadataStore{};
+
+	const auto fixed = [&]<typename T>(ColumnId id, const T*& column) -> bool {
+		const auto* entry = found[static_cast<size_t>(id)];
+		if (entry->bytes != rowCount * sizeof(T)) return false;
+		column = reinterpret_cast<const T*>(base + entry->offset);
+		return true;
+	};
+	const auto strings = [&](ColumnId offsetsId, ColumnId charsId, u64 count, StringColumn& column) -> bool {
+		const auto* offsets = found[static_cast<size_t>(offsetsId)];
+		const auto* chars = found[static_cast<size_t>(charsId)];
+		if (offsets->bytes != (count + 1) * sizeof(u32)) return false;
+		column.offsets = reinterpret_cast<const u32*>(base + offsets->offset);
+		column.chars = reinterpret_cast<const char*>(base + chars->offset);
+		for (u64 i = 0; i < count; i++) { // a bad offset would turn into a wild string_view later
+			if (column.offsets[i] > column.offsets[i + 1]) return false;
+		}
+		return column.offsets[0] == 0 && column.offsets[count] <= chars->bytes;
+	};
+
+	const auto* typeNameOffsets = found[static_cast<size_t>(ColumnId::typeNameOffsets)];
+	if (typeNameOffsets->bytes < sizeof(u32)) return MetadataStore{};
+	const u64 typeCount = typeNameOffsets->bytes / sizeof(u32) - 1;
+
+	bool valid = fixed(ColumnId::fileSize, store.fileSizes)
+		&& fixed(ColumnId::fileMtime, store.fileMtimes)
+		&& fixed(ColumnId::duration, store.durations)
+		&& fixed(ColumnId::sampleRate, store.sampleRates)
+		&& fixed(ColumnId::channels, store.channels)
+		&& fixed(ColumnId::bitsPerSample, store.bitsPerSample)
+		&& fixed(ColumnId::readable, store.readable)
+		&& fixed(ColumnId::type, store.types)
+		&& fixed(ColumnId::loudness, store.loudness)
+		&& fixed(ColumnId::truePeak, store.truePeaks)
+		&& strings(ColumnId::pathOffsets, ColumnId::pathChars, rowCount, store.paths)
+		&& strings(ColumnId::titleOffsets, ColumnId::titleChars, rowCount, store.titles)
+		&& strings(ColumnId::artistOffsets, ColumnId::artistChars, rowCount, store.artists)
+		&& strings(ColumnId::albumOffsets, ColumnId::albumChars, rowCount, store.albums)
+		&& strings(ColumnId::genreOffsets, ColumnId::genreChars, rowCount, store.genres)
+		&& strings(ColumnId::typeNameOffsets, ColumnId::typeNameChars, typeCount, store.typeNames);
+	if (!valid || std::any_of(store.types, store.types + rowCount, [typeCount](u8 type) { return type >= typeCount; }))
+		return MetadataStore{};
+
+	store.rowCount = header.rowCount;
+	store.rowsByPath.reserve(store.rowCount);
+	for (u32 row = 0; row < store.rowCount; row++)
+		store.rowsByPath.emplace(store.paths.get(row), row);
+	return store;
+}
+
+auto MetadataStore::size() const -> u32 {
+	return this->rowCount;
+}
+
+auto MetadataStore::find(const Song& song) const -> std::optional<u32> {
+	auto iter = this->rowsByPath.find(song.path);
+	if (iter == this->rowsByPath.end())
+		return std::nullopt;
+	u32 row = iter->second;
+	if (this->fileSizes[row] != song.size || this->fileMtimes[row] != song.mtime)
+		return std::nullopt; // stale, the file was replaced since we read it
+	return row;
+}
+
+auto MetadataStore::getPath(u32 row) const -> std::string_view {
+	return this->paths.get(row);
+}
+
+auto MetadataStore::getFileSize(u32 row) const -> u64 {
+	return this->fileSizes[row];
+}
+
+auto MetadataStore::getFileMtime(u32 row) const -> i64 {
+	return this->fileMtimes[row];
+}
+
+auto MetadataStore::isReadable(u32 row) const -> bool {
+	return this->readable[row] != 0;
+}
+
+auto MetadataStore::getDuration(u32 row) const -> std::chrono::milliseconds {
+	return std::chrono::milliseconds(this->durations[row]);
+}
+
+auto MetadataStore::getSampleRate(u32 row) const -> u32 {
+	return this->sampleRates[row];
+}
+
+auto MetadataStore::getChannels(u32 row) const -> u8 {
+	return this->channels[row];
+}
+
+auto MetadataStore::getBitsPerSample(u32 row) const -> u8 {
+	return this->bitsPerSample[row];
+}
+
+auto MetadataStore::getType(u32 row) const -> std::string_view {
+	return this->typeNames.get(this->types[row]);
+}
+
+auto MetadataStore::getTitle(u32 row) const -> std::string_view {
+	return this->titles.get(row);
+}
+
+auto MetadataStore::getArtist(u32 row) const -> std::string_view {
+	return this->artists.get(row);
+}
+
+auto MetadataStore::getAlbum(u32 row) const -> std::string_view {
+	return this->albums.get(row);
+}
+
+auto MetadataStore::getGenre(u32 row) const -> std::string_view {
+	return this->genres.get(row);
+}
+
+auto MetadataStore::getLoudness(u32 row) const -> std::optional<Audio::LoudnessInfo> {
+	if (std::isnan(this->loudness[row]))
+		return std::nullopt;
+	return Audio::LoudnessInfo{ this->loudness[row], this->truePeaks[row] };
+}
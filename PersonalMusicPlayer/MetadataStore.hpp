@@ -0,0 +1,89 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "Song.hpp"
+
+#include <MappedFile.hpp>
+#include <SoundMetadata.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+	duration, format and tags for every song in the library, so the player can sort, filter and show the
+	whole library without opening audio files. filled in by opening each file with FMOD_OPENONLY (header and
+	tags only, nothing decoded) on a pool of threads, each with its own Audio::MetadataReader.
+	stored one column per field (fixed width arrays, strings as an offset array plus one char blob) and read
+	back by memory mapping the file, so opening the store is a map plus one pass over the path column, and a
+	scan over e.g. durations only touches the pages holding durations.
+	rows are matched to songs by path and only trusted if the file's size and mtime (from the library index)
+	still match, otherwise the file is read again on the next refresh.
+	loudness is optional since it means decoding every song once. rows without it are filled in by the first
+	refresh that asks for it, after that it's as free as the rest.
+*/
+class MetadataStore {
+public:
+	struct RefreshStats {
+		u32 reused;
+		u32 extracted;
+		u32 failed; // fmod couldn't open it. still stored so it isn't retried until the file changes
+		u32 analyzed; // loudness measured this time, whether the rest of the row was reused or not
+	};
+
+	// maps the existing store, reads anything it's missing or that changed, and rewrites it if needed
+	static auto refresh(const std::vector<Song>& songs, const std::filesystem::path& storePath, bool analyzeLoudness, RefreshStats* stats = nullptr) -> MetadataStore;
+	// an empty store if the file is missing, truncated or from an older version
+	static auto open(const std::filesystem::path& storePath) -> MetadataStore;
+
+	auto size() const -> u32;
+	auto find(const Song& song) const -> std::optional<u32>; // the song's row, if its file hasn't changed since
+
+	auto getPath(u32 row) const -> std::string_view;
+	auto getFileSize(u32 row) const -> u64;
+	auto getFileMtime(u32 row) const -> i64;
+	auto isReadable(u32 row) const -> bool;
+	auto getDuration(u32 row) const -> std::chrono::milliseconds;
+	auto getSampleRate(u32 row) const -> u32;
+	auto getChannels(u32 row) const -> u8;
+	auto getBitsPerSample(u32 row) const -> u8;
+	auto getType(u32 row) const -> std::string_view;
+	auto getTitle(u32 row) const -> std::string_view;
+	auto getArtist(u32 row) const -> std::string_view;
+	auto getAlbum(u32 row) const -> std::string_view;
+	auto getGenre(u32 row) const -> std::string_view;
+	auto getLoudness(u32 row) const -> std::optional<Audio::LoudnessInfo>; // nullopt until a refresh has analyzed it
+
+private:
+	struct StringColumn {
+		const u32* offsets = nullptr; // rowCount + 1 entries into chars
+		const char* chars = nullptr;
+		auto get(u32 row) const -> std::string_view {
+			return std::string_view(this->chars + this->offsets[row], this->offsets[row + 1] - this->offsets[row]);
+		}
+	};
+
+	Audio::MappedFile file;
+	u32 rowCount = 0;
+	const u64* fileSizes = nullptr;
+	const i64* fileMtimes = nullptr;
+	const u32* durations = nullptr; // ms
+	const u32* sampleRates = nullptr;
+	const u8* channels = nullptr;
+	const u8* bitsPerSample = nullptr;
+	const u8* readable = nullptr;
+	const u8* types = nullptr; // index into typeNames
+	const f32* loudness = nullptr; // integrated LUFS, nan if never analyzed
+	const f32* truePeaks = nullptr; // dBTP
+	StringColumn paths;
+	StringColumn titles;
+	StringColumn artists;
+	StringColumn albums;
+	StringColumn genres;
+	StringColumn typeNames;
+	std::unordered_map<std::string_view, u32> rowsByPath; // views into the mapping
+};
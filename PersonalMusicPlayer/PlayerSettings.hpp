@@ -0,0 +1,28 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include <AudioEngineConfig.hpp>
+
+#include <array>
+#include <string>
+
+// optional "player" section of config.json. anything missing keeps these defaults
+struct PlayerSettings {
+	u32 prefetchCount = 2; // how many upcoming songs to keep loading ahead of the current one
+	u64 cacheBytes = 256ull * 1024 * 1024; // loaded songs get evicted (least recently used first) past this
+	u64 engineMemoryBytes = 0; // the engine's own cap on loaded sounds, a backstop behind the cache for anything it doesn't track. 0 for none
+	u64 memoryPoolBytes = 0; // reserved up front for fmod and the engine's small allocations. 0 leaves them on the system heap
+	u32 ioThreads = 0; // the engine's own file reading with read-ahead, for libraries on slow or network drives. 0 leaves it to fmod
+	u32 readAheadBytes = 256 * 1024;
+	Audio::LoadPolicy loadPolicy{}; // which songs stream and which get loaded whole, and how big stream buffers are
+	Audio::OutputMode output = Audio::OutputMode::realtime; // the nrt modes render the playlist as fast as the cpu allows
+	std::string wavPath = "output.wav"; // where wavWriterNRT writes to
+	std::array<f32, 3> eqGainsdB{ 0.0f, 0.0f, 0.0f }; // low shelf, mid, high shelf. all 0 means no eq at all
+	bool limiter = false; // keeps loud masters (or a boosted eq) from clipping
+	bool normalizeLoudness = false; // measures every song once (cached with the library metadata) and evens them out. the first run decodes the whole library before playing
+	f32 loudnessTarget = -18.0f; // LUFS, replaygain 2's reference level
+	u32 crossfadeMs = 0; // overlap between consecutive songs. 0 plays them back to back
+	u32 updateTickMs = 10; // longest the player sleeps between engine updates when nothing's happening. ignored by the nrt outputs
+	std::string packFile; // asset pack from AssetPackBuilder. songs in it load from the pack instead of their own files. empty for none
+};
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "PrimitiveTypes.hpp"
+
 #include <string>
 
 struct Song {
 	std::string path;
 	std::string name;
+	u64 size = 0; // size and mtime identify which version of the file this is, for caches keyed on path
+	i64 mtime = 0;
 };
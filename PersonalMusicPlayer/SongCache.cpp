@@ -0,0 +1,135 @@
+
+#include "SongCache.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <format>
+
+SongCache::SongCache(Audio::AudioEngine& engine, u64 byteBudget, u32 prefetchCount, GainSource songGain) :
+	engine{engine},
+	byteBudget{byteBudget},
+	prefetchCount{prefetchCount},
+	cachedBytes{0},
+	songGain{std::move(songGain)},
+	lru{},
+	entries{},
+	pinned{},
+	completed{}
+{}
+
+auto SongCache::play(const Song& song) -> i32 {
+	this->setCurrent(song);
+	this->request(song);
+	this->touch(song.name);
+	auto foundIter = this->entries.find(song.name);
+	if (foundIter == this->entries.end())
+		return 0; // its load couldn't be queued, same as a failed play
+	f32 volumedB = this->songGain ? this->songGain(song) : 0.0f;
+	// passed to the play itself so the first block already has the right gain, no jump from a later setChannelVolume
+	return this->engine.playWhenReady(foundIter->second.handle, Audio::Vec3<f32>{ 0, 0, 0 }, volumedB);
+}
+
+auto SongCache::crossfade(i32 fromChannelId, const Song& song, std::chrono::milliseconds fade) -> i32 {
+	this->pinned.insert(song.name); // the outgoing song is still playing, so it keeps its pin for now
+	this->request(song);
+	this->touch(song.name);
+	auto foundIter = this->entries.find(song.name);
+	if (foundIter == this->entries.end())
+		return 0;
+	f32 volumedB = this->songGain ? this->songGain(song) : 0.0f;
+	return this->engine.crossfade(fromChannelId, foundIter->second.handle, fade, volumedB);
+}
+
+auto SongCache::setCurrent(const Song& song) -> void {
+	this->pinned.clear();
+	this->pinned.insert(song.name);
+}
+
+auto SongCache::prefetch(const std::vector<Song>& queue, i32 currentIndex) -> void {
+	if (queue.empty()) return;
+	auto count = std::min<size_t>(this->prefetchCount, queue.size() - 1);
+	for (size_t i = 1; i <= count; i++) {
+		const Song& upcoming = queue[(currentIndex + i) % queue.size()];
+		this->pinned.insert(upcoming.name);
+		this->request(upcoming);
+	}
+}
+
+auto SongCache::update() -> void {
+	std::vector<std::pair<std::string, bool>> finished;
+	{
+		std::lock_guard<std::mutex> lock(this->completedLock);
+		finished.swap(this->completed);
+	}
+	for (auto& [name, loaded] : finished) {
+		auto foundIter = this->entries.find(name);
+		if (foundIter == this->entries.end() || foundIter->second.loaded)
+			continue; // evicted or cleared while it was loading
+		if (!loaded) {
+			this->lru.erase(foundIter->second.lruPosition);
+			this->entries.erase(foundIter);
+			continue;
+		}
+		foundIter->second.loaded = true;
+		foundIter->second.bytes = this->engine.getSoundMemoryUsage(foundIter->second.handle);
+		this->cachedBytes += foundIter->second.bytes;
+	}
+	if (!finished.empty())
+		this->evict();
+}
+
+auto SongCache::forget(Audio::SoundHandle sound) -> void {
+	auto foundIter = std::ranges::find_if(this->entries, [sound](const auto& entry) { return entry.second.handle == sound; });
+	if (foundIter == this->entries.end()) return;
+	this->cachedBytes -= foundIter->second.bytes;
+	this->lru.erase(foundIter->second.lruPosition);
+	this->entries.erase(foundIter);
+}
+
+auto SongCache::clear() -> void {
+	for (auto& [name, entry] : this->entries)
+		this->engine.unloadSound(entry.handle);
+	this->entries.clear();
+	this->lru.clear();
+	this->pinned.clear();
+	this->cachedBytes = 0;
+}
+
+auto SongCache::getCachedBytes() const -> u64 {
+	return this->cachedBytes;
+}
+
+auto SongCache::request(const Song& song) -> void {
+	if (this->entries.contains(song.name))
+		return;
+	auto handle = this->engine.loadSoundAsync(song.path, song.name, true, false, Audio::LoadMode::automatic, [this, name = song.name](bool loaded) -> void {
+		if (!loaded)
+			std::cerr << std::format("Failed to load song: {}\n", name);
+		std::lock_guard<std::mutex> lock(this->completedLock);
+		this->completed.emplace_back(name, loaded);
+	});
+	if (!handle.isValid())
+		return; // the engine's queue was full and onLoaded won't come, so nothing's kept and the next request tries again
+	this->lru.push_back(song.name); // prefetched but not played yet, so it goes to the back
+	this->entries[song.name] = Entry{ handle, std::prev(this->lru.end()), 0, false };
+}
+
+auto SongCache::touch(const std::string& name) -> void {
+	auto foundIter = this->entries.find(name);
+	if (foundIter == this->entries.end()) return;
+	this->lru.splice(this->lru.begin(), this->lru, foundIter->second.lruPosition);
+}
+
+auto SongCache::evict() -> void {
+	auto iter = this->lru.end();
+	while (this->cachedBytes > this->byteBudget && iter != this->lru.begin()) {
+		iter--;
+		auto entryIter = this->entries.find(*iter);
+		if (this->pinned.contains(*iter) || !entryIter->second.loaded)
+			continue; // still needed, or not taking up anything yet
+		this->cachedBytes -= entryIter->second.bytes;
+		this->engine.unloadSound(entryIter->second.handle);
+		this->entries.erase(entryIter);
+		iter = this->lru.erase(iter);
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "PrimitiveTypes.hpp"
+
+#include "Song.hpp"
+
+#include <AudioEngine.hpp>
+
+#include <list>
+#include <chrono>
+#include <mutex>
+#include <functional>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+/*
+	keeps the current song, the next few in the queue and whatever was played recently loaded in the engine.
+	upcoming songs get loaded in the background so switching tracks doesn't wait on the disk, and once the
+	loaded songs add up past the byte budget the least recently used ones (that aren't current or upcoming) get unloaded.
+	not thread safe on its own, the player calls everything with its mutex held. update() has to run on the engine's update thread.
+*/
+class SongCache {
+public:
+	typedef std::function<f32(const Song&)> GainSource; // dB to play a song at, e.g. its loudness normalization
+
+	SongCache(Audio::AudioEngine& engine, u64 byteBudget, u32 prefetchCount, GainSource songGain = {});
+	SongCache(const SongCache&) = delete;
+	void operator=(const SongCache&) = delete;
+
+	auto play(const Song& song) -> i32; // loads if needed and starts once ready
+	// like play, but fades over from fromChannelId (see AudioEngine::crossfade). both songs stay pinned
+	// until setCurrent says the old one is done
+	auto crossfade(i32 fromChannelId, const Song& song, std::chrono::milliseconds fade) -> i32;
+	auto setCurrent(const Song& song) -> void; // unpins everything else, prefetch() re-pins the upcoming ones
+	auto prefetch(const std::vector<Song>& queue, i32 currentIndex) -> void; // the prefetchCount songs after currentIndex
+	auto update() -> void; // picks up finished loads and evicts down to budget
+	auto forget(Audio::SoundHandle sound) -> void; // the engine evicted it under its own budget, so it loads again next time
+	auto clear() -> void;
+	auto getCachedBytes() const -> u64;
+
+private:
+	struct Entry {
+		Audio::SoundHandle handle;
+		std::list<std::string>::iterator lruPosition;
+		u64 bytes; // 0 until loaded
+		bool loaded;
+	};
+
+	Audio::AudioEngine& engine;
+	u64 byteBudget;
+	u32 prefetchCount;
+	u64 cachedBytes;
+	GainSource songGain;
+	std::list<std::string> lru; // front is most recently used
+	std::unordered_map<std::string, Entry> entries;
+	std::unordered_set<std::string> pinned; // current and upcoming songs, never evicted
+
+	// load callbacks come in from inside engine.update(), so they get their own little lock instead of the player's
+	std::mutex completedLock;
+	std::vector<std::pair<std::string, bool>> completed;
+
+	auto request(const Song& song) -> void;
+	auto touch(const std::string& name) -> void;
+	auto evict() -> void;
+};
@@ -5,8 +5,10 @@
 #include <iostream>
 #include <format>
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#endif
 
 auto eraseLines(i32 count) -> void {
 	if (count > 0) {
@@ -24,6 +26,8 @@ auto moveCursorUpLines(i32 count) -> void {
 	}
 }
 
+#ifdef _WIN32
+// polling version, Input reads keys through KeyReader now
 //https://www.geeksforgeeks.org/how-to-detect-keypress-in-windows-using-cpp/
 auto [[nodiscard]] checkIfKeyPressed(const int keycode) -> bool {
 	if (GetAsyncKeyState(keycode) & 0x8000) {
@@ -34,3 +38,4 @@ auto [[nodiscard]] checkIfKeyPressed(const int keycode) -> bool {
 	}
 	return false;
 }
+#endif
@@ -6,6 +6,7 @@
 #include <filesystem>
 #include <ranges>
 #include <algorithm>
+#include <atomic>
 
 #include "json.hpp"
 
@@ -14,6 +15,7 @@
 #include "API.hpp"
 #include "Song.hpp"
 #include "LoadedSong.hpp"
+#include "SongCache.hpp"
 #include "Input.hpp"
 
 #include "TerminalUtils.hpp"
@@ -23,9 +25,23 @@ auto main() -> int {
 	std::setlocale(LC_ALL, locale);
 	std::locale::global(std::locale(locale)); // need locales for dealing with string conversions (maybe)
 
-	Audio::AudioEngine::init();
+	const auto settings = PersonalMusicPlayer::getPlayerSettingsFromConfigFile();
+	// main thread is the audio thread. input callbacks only queue commands for it
+	Audio::AudioEngine::init(Audio::AudioEngineConfig{
+		.threading = Audio::ThreadingMode::commandQueue,
+		.soundMemoryBudget = settings.engineMemoryBytes,
+		.memoryPoolBytes = settings.memoryPoolBytes,
+		.ioThreads = settings.ioThreads,
+		.readAheadBytes = settings.readAheadBytes,
+		.loadPolicy = settings.loadPolicy,
+		.output = settings.output,
+		.wavWriterPath = settings.wavPath.c_str()
+	});
 	
 	Audio::AudioEngine engine{};
+	if (!settings.packFile.empty() && !engine.mountPack(settings.packFile))
+		std::cerr << std::format("Couldn't open pack {}, loading songs from their files\n", settings.packFile);
+	PersonalMusicPlayer::addOutputEffects(engine, settings);
 
 	auto& input = Input::getInstance();
 	input.registerKeyToAction('N', KeyActions::nextSong);
@@ -33,102 +49,162 @@ auto main() -> int {
 	input.registerKeyToAction('P', KeyActions::togglePaused);
 	input.registerKeyToAction('S', KeyActions::shuffleSongs);
 	input.registerKeyToAction('Q', KeyActions::quitApplication);
+	input.registerKeyToAction('I', KeyActions::toggleStats);
 
 	//auto songs = PersonalMusicPlayer::loadEntireLibrary(engine);
 	// avoid preload
 	auto songs = PersonalMusicPlayer::getSongsFromConfigFile();
+	const auto metadata = PersonalMusicPlayer::getLibraryMetadata(songs, settings.normalizeLoudness);
+	SongCache cache(engine, settings.cacheBytes, settings.prefetchCount, [&metadata, &settings](const Song& song) -> f32 {
+		return PersonalMusicPlayer::normalizationGaindB(metadata, song, settings);
+	});
 	std::cout << "\n\n";
 	LoadedSong playingSong;
+	LoadedSong upcoming{ Song{}, 0 }; // the next song once its crossfade is scheduled, channel 0 until then
+	const auto crossfade = std::chrono::milliseconds(settings.crossfadeMs);
+	// how far ahead of the fade the next song gets scheduled. the mixer times the fade itself, so this only
+	// has to cover how long the loop below can take to come back around
+	constexpr const auto crossfadeLead = std::chrono::seconds(2);
+	// the nrt outputs only mix when update() runs, so sleeping there would just slow the render down
+	const auto updateTick = settings.output == Audio::OutputMode::realtime ? std::chrono::milliseconds(settings.updateTickMs) : std::chrono::milliseconds::zero();
 
 	PersonalMusicPlayer::shuffleSongs(songs);
 
 	i32 currentSongIndex = 0;
-	bool quit = false;
+	i32 crossfadedFrom = 0; // channel the last crossfade went out from, so a failed one isn't retried every tick
+	std::atomic<bool> quit = false;
+	bool showStats = false;
 
-	i32 channelId = engine.loadAndPlaySound(songs[currentSongIndex].path, songs[currentSongIndex].name);
+	i32 channelId = cache.play(songs[currentSongIndex]);
 	playingSong = LoadedSong(songs[currentSongIndex], channelId);
+	cache.prefetch(songs, currentSongIndex);
 
-	std::mutex audioMutex;
+	std::mutex playerMutex; // guards songs, currentSongIndex, playingSong, upcoming, cache and showStats. engine calls are safe without it
 
 	input.subscribeToKeypress(
-		[&engine, &currentSongIndex, &songs, &playingSong, &audioMutex]() -> void {
-			std::lock_guard<std::mutex> lock(audioMutex);
-			if (engine.isPlaying(playingSong.channelId))
-				engine.stopChannel(playingSong.channelId);
-			engine.unloadSound(playingSong.song.name);
+		[&engine, &cache, &currentSongIndex, &songs, &playingSong, &upcoming, &playerMutex]() -> void {
+			std::lock_guard<std::mutex> lock(playerMutex);
+			engine.stopChannel(playingSong.channelId); // no-op if it already ended
+			engine.stopChannel(upcoming.channelId); // a crossfade that hasn't finished yet goes too
+			upcoming.channelId = 0;
 			currentSongIndex++;
 			if (currentSongIndex >= songs.size())
 				currentSongIndex = 0;
-			i32 newChannelId = engine.loadAndPlaySound(songs[currentSongIndex].path, songs[currentSongIndex].name);
+			i32 newChannelId = cache.play(songs[currentSongIndex]);
 			playingSong = LoadedSong(songs[currentSongIndex], newChannelId);
+			cache.prefetch(songs, currentSongIndex);
 		}, KeyActions::nextSong
 	);
 	input.subscribeToKeypress(
-		[&engine, &currentSongIndex, &songs, &playingSong, &audioMutex]() -> void {
-			std::lock_guard<std::mutex> lock(audioMutex);
-			if (engine.isPlaying(playingSong.channelId))
-				engine.stopChannel(playingSong.channelId);
-			engine.unloadSound(playingSong.song.name);
+		[&engine, &cache, &currentSongIndex, &songs, &playingSong, &upcoming, &playerMutex]() -> void {
+			std::lock_guard<std::mutex> lock(playerMutex);
+			engine.stopChannel(playingSong.channelId); // no-op if it already ended
+			engine.stopChannel(upcoming.channelId); // a crossfade that hasn't finished yet goes too
+			upcoming.channelId = 0;
 			currentSongIndex--;
 			if (currentSongIndex < 0)
 				currentSongIndex = songs.size() - 1;
-			i32 newChannelId = engine.loadAndPlaySound(songs[currentSongIndex].path, songs[currentSongIndex].name);
+			i32 newChannelId = cache.play(songs[currentSongIndex]);
 			playingSong = LoadedSong(songs[currentSongIndex], newChannelId);
+			cache.prefetch(songs, currentSongIndex);
 		}, KeyActions::prevSong
 	);
 	input.subscribeToKeypress(
 		[&quit]() -> void {
 			quit = true;
+			Audio::AudioEngine::wake(); // nothing gets queued for this one, so the main loop has to be poked
 		}, KeyActions::quitApplication
 	);
 	input.subscribeToKeypress(
-		[&engine, &currentSongIndex, &songs, &playingSong, &audioMutex]() -> void {
-			std::lock_guard<std::mutex> lock(audioMutex);
+		[&showStats, &playerMutex]() -> void {
+			std::lock_guard<std::mutex> lock(playerMutex);
+			showStats = !showStats;
+		}, KeyActions::toggleStats
+	);
+	input.subscribeToKeypress(
+		[&engine, &cache, &currentSongIndex, &songs, &playingSong, &upcoming, &playerMutex]() -> void {
+			std::lock_guard<std::mutex> lock(playerMutex);
 			PersonalMusicPlayer::shuffleSongs(songs);
-			if (engine.isPlaying(playingSong.channelId))
-				engine.stopChannel(playingSong.channelId);
-			engine.unloadSound(playingSong.song.name);
-			i32 newChannelid = engine.loadAndPlaySound(songs[currentSongIndex].path, songs[currentSongIndex].name);
+			engine.stopChannel(playingSong.channelId);
+			engine.stopChannel(upcoming.channelId);
+			upcoming.channelId = 0;
+			i32 newChannelid = cache.play(songs[currentSongIndex]);
 			playingSong = LoadedSong(songs[currentSongIndex], newChannelid);
+			cache.prefetch(songs, currentSongIndex);
 		}, KeyActions::shuffleSongs
 	);
 
 	i32 linesUsed = PersonalMusicPlayer::printLibraryPositionInfo(songs, currentSongIndex);
-	linesUsed += PersonalMusicPlayer::printPlayingSongInfo(engine, channelId);
+	linesUsed += PersonalMusicPlayer::printPlayingSongInfo(engine, metadata, songs[currentSongIndex], channelId);
 	auto lastTimePoint = std::chrono::steady_clock::now();
 	auto currTimePoint = lastTimePoint;
 	
 	while (!quit) {
-		// print music menu for song selection
-		while (engine.isPlaying(playingSong.channelId)) {
-			engine.update();
-
-			currTimePoint = std::chrono::steady_clock::now();
-			if (std::chrono::duration_cast<std::chrono::seconds>(currTimePoint - lastTimePoint).count() >= 1) {
-				eraseLines(linesUsed);
-				{
-					std::lock_guard<std::mutex> lock(audioMutex);
-					linesUsed = PersonalMusicPlayer::printLibraryPositionInfo(songs, currentSongIndex);
-					linesUsed += PersonalMusicPlayer::printPlayingSongInfo(engine, playingSong.channelId);
-				}
-				lastTimePoint = currTimePoint;
+		// sleeps up to a tick. the commands input callbacks queue cut it short, so keypresses don't wait on it
+		Audio::AudioEngine::waitForWork(updateTick);
+		engine.update();
+
+		currTimePoint = std::chrono::steady_clock::now();
+		if (std::chrono::duration_cast<std::chrono::seconds>(currTimePoint - lastTimePoint).count() >= 1) {
+			eraseLines(linesUsed);
+			{
+				std::lock_guard<std::mutex> lock(playerMutex);
+				linesUsed = PersonalMusicPlayer::printLibraryPositionInfo(songs, currentSongIndex);
+				linesUsed += PersonalMusicPlayer::printPlayingSongInfo(engine, metadata, playingSong.song, playingSong.channelId);
+				if (showStats)
+					linesUsed += PersonalMusicPlayer::printEngineStats(engine);
+			}
+			lastTimePoint = currTimePoint;
+		}
+		{
+			std::lock_guard<std::mutex> lock(playerMutex);
+			cache.update();
+			if (quit) {
+				engine.stopAllChannels();
+				cache.clear();
+				engine.update(); // flush the stop and unloads
+				break;
+			}
+			// events only ever name channels that are over for good, so a song a callback just queued can't look finished.
+			// ends of channels that were swapped out already don't match anything anymore
+			bool songEnded = false;
+			Audio::PlaybackEvent event;
+			while (engine.pollEvent(event)) {
+				if (event.type == Audio::PlaybackEventType::soundEvicted)
+					cache.forget(event.sound);
+				if (event.type != Audio::PlaybackEventType::channelEnded && event.type != Audio::PlaybackEventType::playFailed)
+					continue;
+				if (event.channelId == playingSong.channelId)
+					songEnded = true;
+				else if (event.channelId == upcoming.channelId)
+					upcoming.channelId = 0; // crossfade didn't work out, fall back to starting it at the end
 			}
-			{ // before trying cases, wait mutex (allows full nextSong/prevSong behavior before checking engine.isPlaying)
-				std::lock_guard<std::mutex> lock(audioMutex);
-				if (!quit && !engine.isPlaying(playingSong.channelId)) { // song ended naturally
-					if (engine.isPlaying(playingSong.channelId))
-						engine.stopChannel(playingSong.channelId);
-					engine.unloadSound(playingSong.song.name);
-					currentSongIndex++;
-					if (currentSongIndex >= songs.size())
-						currentSongIndex = 0;
-					i32 newChannelid = engine.loadAndPlaySound(songs[currentSongIndex].path, songs[currentSongIndex].name);
+			if (songEnded || playingSong.channelId == 0) { // 0 means its play couldn't even be queued
+				currentSongIndex++;
+				if (currentSongIndex >= songs.size())
+					currentSongIndex = 0;
+				if (upcoming.channelId != 0) { // already faded in, the mixer switched over on the exact sample
+					playingSong = upcoming;
+					upcoming.channelId = 0;
+					cache.setCurrent(playingSong.song);
+					cache.prefetch(songs, currentSongIndex);
+				}
+				else {
+					i32 newChannelid = cache.play(songs[currentSongIndex]); // already loaded if prefetch kept up
 					playingSong = LoadedSong(songs[currentSongIndex], newChannelid);
+					cache.prefetch(songs, currentSongIndex);
+					engine.update(); // start it now instead of a tick later
 				}
-				if (quit) {
-					engine.stopAllChannels();
-					engine.unloadSound(playingSong.song.name);
-					break;
+			}
+			else if (crossfade.count() > 0 && upcoming.channelId == 0 && crossfadedFrom != playingSong.channelId) {
+				auto playback = engine.getPlaybackPosition(playingSong.channelId);
+				if (playback && playback->duration.count() > 0 && playback->duration - playback->position <= crossfade + crossfadeLead) {
+					i32 nextIndex = (currentSongIndex + 1) % static_cast<i32>(songs.size());
+					i32 newChannelId = cache.crossfade(playingSong.channelId, songs[nextIndex], crossfade);
+					if (newChannelId != 0) { // couldn't be queued, try again next time around
+						upcoming = LoadedSong(songs[nextIndex], newChannelId);
+						crossfadedFrom = playingSong.channelId;
+					}
 				}
 			}
 		}
@@ -168,6 +244,7 @@ auto main() -> int {
 	*/
 
 	Input::getInstance().shutdownInput();
+	Audio::AudioEngine::shutdown(); // the wav writers only fix up their header sizes on the way out
 
 	std::cout << " sound over" << std::endl;
 